@@ -0,0 +1,90 @@
+// throughput of hash_string against the FNV-1a hash it replaced, over keys of increasing length
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../src/util.h"
+
+#define DATA_SIZE (1 << 16)
+#define MAX_ITERATIONS (1 << 22)
+#define BYTES_PER_ROUND (1 << 28)
+#define ROUNDS 5
+
+static const int lengths[] = {1, 2, 4, 8, 16, 32, 64, 256, 4096};
+
+static uint8_t data[DATA_SIZE];
+
+static uint64_t state = 0x9e3779b97f4a7c15u;
+
+static uint64_t nextRandom(void) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static uint32_t hashFnv(char* key, int length) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash ^= key[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+// the hashes are summed so that no call can be optimized away
+static uint32_t checksum;
+
+// keys start at a different offset on every iteration, so that the hash of one key cannot be reused
+static void hashAll(uint32_t (*hash)(char*, int), int length, int iterations) {
+    int span = DATA_SIZE - length;
+    int offset = 0;
+    for (int i = 0; i < iterations; i++) {
+        checksum += hash((char*) data + offset, length);
+        offset += 61;
+        if (offset >= span)
+            offset -= span;
+    }
+}
+
+// best of a few rounds, in nanoseconds per hash
+static double measure(uint32_t (*hash)(char*, int), int length) {
+    int iterations = BYTES_PER_ROUND / length < MAX_ITERATIONS ? BYTES_PER_ROUND / length : MAX_ITERATIONS;
+    double best = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        double start = now();
+        hashAll(hash, length, iterations);
+        double elapsed = now() - start;
+        if (round == 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best / iterations;
+}
+
+static uint32_t hashNew(char* key, int length) {
+    return hash_string(key, length);
+}
+
+int main(void) {
+    initHashSeed();
+    for (int i = 0; i < DATA_SIZE; i++) {
+        data[i] = (uint8_t) nextRandom();
+    }
+    printf("length   FNV-1a ns/hash   hash_string ns/hash\n");
+    for (int i = 0; i < (int) (sizeof(lengths) / sizeof(int)); i++) {
+        double fnv = measure(hashFnv, lengths[i]);
+        double current = measure(hashNew, lengths[i]);
+        printf("%6d   %14.1f   %19.1f\n", lengths[i], fnv, current);
+    }
+    printf("(checksum %u)\n", checksum);
+    return 0;
+}
@@ -0,0 +1,80 @@
+// throughput of formatNumber against snprintf with "%g" (6 digits, not round-trip) and
+// "%.17g" (round-trip, not shortest) on the same random doubles
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../src/number_format.h"
+
+#define SAMPLES 1000000
+#define ROUNDS 5
+
+static uint64_t state = 0x9e3779b97f4a7c15u;
+
+static uint64_t nextRandom(void) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// any finite double, every exponent equally likely
+static double randomDouble(void) {
+    for (;;) {
+        uint64_t bits = nextRandom();
+        double value;
+        memcpy(&value, &bits, sizeof(double));
+        if (value == value && value - value == 0)
+            return value;
+    }
+}
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+// the written lengths are summed so that no call can be optimized away
+static size_t checksum;
+
+static void formatAll(double* values, char* format) {
+    char buffer[40];
+    for (int i = 0; i < SAMPLES; i++) {
+        if (format == NULL)
+            checksum += formatNumber(values[i], buffer);
+        else
+            checksum += snprintf(buffer, sizeof(buffer), format, values[i]);
+    }
+}
+
+// best of a few rounds, in nanoseconds per number
+static double measure(double* values, char* format) {
+    double best = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        double start = now();
+        formatAll(values, format);
+        double elapsed = now() - start;
+        if (round == 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best / SAMPLES;
+}
+
+int main(void) {
+    double* values = malloc(sizeof(double) * SAMPLES);
+    for (int i = 0; i < SAMPLES; i++) {
+        values[i] = randomDouble();
+    }
+    printf("formatNumber    %6.1f ns/number\n", measure(values, NULL));
+    printf("snprintf %%g     %6.1f ns/number\n", measure(values, "%g"));
+    printf("snprintf %%.17g  %6.1f ns/number\n", measure(values, "%.17g"));
+    printf("(checksum %zu)\n", checksum);
+    free(values);
+    return 0;
+}
@@ -8,5 +8,6 @@ typedef struct sCollector Collector;
 typedef struct sBytecode Bytecode;
 typedef struct sHashMap HashMap;
 typedef struct sVM VM;
+typedef struct sShape Shape;
 
 #endif
@@ -0,0 +1,121 @@
+#include <string.h>
+
+#include "ast.h"
+#include "../memory.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+#define align_size(size) (((size) + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1))
+
+void initArena(Arena* arena) {
+    arena->blocks = NULL;
+}
+
+void* arenaAllocate(Arena* arena, size_t size) {
+    size = align_size(size);
+    ArenaBlock* block = arena->blocks;
+    if (block == NULL || block->used + size > block->size) {
+        size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = allocate_pointer(NULL, ArenaBlock, sizeof(ArenaBlock) + blockSize);
+        block->next = arena->blocks;
+        block->used = 0;
+        block->size = blockSize;
+        arena->blocks = block;
+    }
+    void* result = block->data + block->used;
+    block->used += size;
+    return result;
+}
+
+void freeArena(Arena* arena) {
+    ArenaBlock* block = arena->blocks;
+    while (block != NULL) {
+        ArenaBlock* next = block->next;
+        free_pointer(NULL, block, sizeof(ArenaBlock) + block->size);
+        block = next;
+    }
+    initArena(arena);
+}
+
+void initAst(Ast* ast) {
+    initArena(&ast->arena);
+    ast->main = NULL;
+}
+
+void freeAst(Ast* ast) {
+    freeArena(&ast->arena);
+    ast->main = NULL;
+}
+
+Node* newNode(Arena* arena, NodeType type, int line) {
+    Node* node = arenaAllocate(arena, sizeof(Node));
+    memset(node, 0, sizeof(Node));
+    node->type = type;
+    node->line = line;
+    return node;
+}
+
+Node* newConstantNode(Arena* arena, Value constant, int line) {
+    Node* node = newNode(arena, NODE_CONSTANT, line);
+    node->as.constant = constant;
+    return node;
+}
+
+void initNodeList(NodeList* list) {
+    list->nodes = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+// grown lists leave their old storage inside the arena
+void nodeListAdd(Arena* arena, NodeList* list, Node* node) {
+    if (list->count + 1 > list->capacity) {
+        int newcap = compute_capacity(list->capacity);
+        Node** nodes = arenaAllocate(arena, sizeof(Node*) * newcap);
+        if (list->count > 0)
+            memcpy(nodes, list->nodes, sizeof(Node*) * list->count);
+        list->nodes = nodes;
+        list->capacity = newcap;
+    }
+    list->nodes[list->count++] = node;
+}
+
+Variable* newVariable(Arena* arena, Token name, FunctionNode* function) {
+    Variable* variable = arenaAllocate(arena, sizeof(Variable));
+    variable->name = name;
+    variable->function = function;
+    variable->isParameter = 0;
+    variable->isCaptured = 0;
+    variable->reads = 0;
+    variable->writes = 0;
+    variable->slot = -1;
+    variable->value = NULL;
+    variable->index = -1;
+    return variable;
+}
+
+FunctionNode* newFunctionNode(Arena* arena, ObjString* name, FunctionNode* enclosing, int line) {
+    FunctionNode* function = arenaAllocate(arena, sizeof(FunctionNode));
+    function->name = name;
+    function->enclosing = enclosing;
+    function->parameters = NULL;
+    function->arity = 0;
+    function->parametersCapacity = 0;
+    initNodeList(&function->body);
+    function->line = line;
+    function->isGenerator = 0;
+    return function;
+}
+
+void addParameter(Arena* arena, FunctionNode* function, Variable* parameter) {
+    if (function->arity + 1 > function->parametersCapacity) {
+        int newcap = compute_capacity(function->parametersCapacity);
+        Variable** parameters = arenaAllocate(arena, sizeof(Variable*) * newcap);
+        if (function->arity > 0)
+            memcpy(parameters, function->parameters, sizeof(Variable*) * function->arity);
+        function->parameters = parameters;
+        function->parametersCapacity = newcap;
+    }
+    parameter->isParameter = 1;
+    function->parameters[function->arity++] = parameter;
+}
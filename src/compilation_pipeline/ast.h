@@ -0,0 +1,173 @@
+#ifndef ast_h
+#define ast_h
+
+#include <stddef.h>
+
+#include "../commontypes.h"
+#include "../datastructs/value.h"
+#include "lexer.h"
+
+// tree built by the parser, rewritten by the optimizer and lowered to bytecode by the compiler;
+// every node, list and variable lives inside an arena freed at once after compilation
+
+typedef struct sArenaBlock {
+    struct sArenaBlock* next;
+    size_t used;
+    size_t size;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* blocks;
+} Arena;
+
+typedef struct sNode Node;
+typedef struct sVariable Variable;
+typedef struct sFunctionNode FunctionNode;
+
+typedef enum {
+    // expressions
+    NODE_CONSTANT,
+    NODE_GLOBAL_GET,
+    NODE_GLOBAL_SET,
+    NODE_VARIABLE_GET, // local or upvalue, depending on the function reading it
+    NODE_VARIABLE_SET,
+    NODE_INDEXING_GET,
+    NODE_INDEXING_SET,
+    NODE_CALL,
+    NODE_UNARY,
+    NODE_BINARY,
+    NODE_AND,
+    NODE_OR,
+    NODE_TERNARY,
+    NODE_COMMA,
+    NODE_ARRAY,
+    NODE_DICT,
+    NODE_FUNCTION,
+    // statements
+    NODE_EXPRESSION_STAT,
+    NODE_PRINT,
+    NODE_LET, // declares a local when variable is set, a global otherwise
+    NODE_UNPACK, // declares a variable for each value returned by a call
+    NODE_BLOCK,
+    NODE_IF,
+    NODE_WHILE,
+    NODE_FOR_RANGE,
+    NODE_FOR_EACH,
+    NODE_MATCH,
+    NODE_CASE,
+    NODE_RET,
+    NODE_YIELD,
+    NODE_BREAK,
+    NODE_CONTINUE,
+} NodeType;
+
+typedef struct {
+    Node** nodes;
+    int count;
+    int capacity;
+} NodeList;
+
+struct sNode {
+    NodeType type;
+    int line;
+    union {
+        Value constant;
+        struct {
+            ObjString* name; // globals only
+            Variable* variable; // locals and upvalues only
+            Node* value; // assigned value (or initializer, NULL if missing)
+        } variable;
+        struct {
+            TokenType operator;
+            Node* left;
+            Node* right; // NULL for unary operations
+            int numeric; // operands proven to be numbers by type inference
+        } operation;
+        struct {
+            Node* object;
+            Node* key;
+            Node* value; // NULL when reading
+        } indexing;
+        struct {
+            Node* callee;
+            NodeList arguments;
+            int unpacked; // values taken back by a destructuring let, 0 when the call is a single value
+        } call;
+        struct {
+            Node* condition;
+            Node* then;
+            Node* otherwise; // NULL if missing, elifs are nested ifs
+        } branch; // ternaries, ifs and whiles (whose body is then)
+        struct {
+            Variable* variable; // the value of each element in for each loops
+            Variable* key; // for each loops only, NULL if missing
+            Node* start; // the container in for each loops
+            Node* end; // excluded, NULL in for each loops
+            Node* step; // NULL if missing
+            Node* body;
+        } loop; // for loops, whose header is evaluated once before the first iteration
+        struct {
+            NodeList targets; // lets without initializer, in the order of the values
+            Node* call;
+        } unpack;
+        struct {
+            Node* subject;
+            NodeList arms; // cases
+            Node* otherwise; // NULL if missing
+        } match;
+        struct {
+            NodeList values; // constants compared with the subject, never evaluated
+            Node* body;
+        } arm;
+        NodeList list; // and, or, comma, array, block, dict (keys and values alternated) and ret (empty if bare)
+        FunctionNode* function;
+        Node* expression; // expression, print and yield statements
+    } as;
+};
+
+struct sVariable {
+    Token name;
+    FunctionNode* function; // function declaring it
+    int isParameter;
+    int isCaptured; // used by an inner function
+    int reads;
+    int writes; // initialization excluded
+    int slot; // stack slot, assigned while generating code
+    Node* value; // constant or variable its reads can be replaced with, set by the optimizer
+    int index; // position in the states of type inference, -1 when not tracked
+};
+
+struct sFunctionNode {
+    ObjString* name; // NULL for the main code
+    FunctionNode* enclosing;
+    Variable** parameters;
+    int arity;
+    int parametersCapacity;
+    NodeList body;
+    int line;
+    int isGenerator; // yields somewhere in its body
+};
+
+typedef struct {
+    Arena arena;
+    FunctionNode* main;
+} Ast;
+
+void initArena(Arena* arena);
+void* arenaAllocate(Arena* arena, size_t size);
+void freeArena(Arena* arena);
+
+void initAst(Ast* ast);
+void freeAst(Ast* ast);
+Node* newNode(Arena* arena, NodeType type, int line);
+Node* newConstantNode(Arena* arena, Value constant, int line);
+void initNodeList(NodeList* list);
+void nodeListAdd(Arena* arena, NodeList* list, Node* node);
+Variable* newVariable(Arena* arena, Token name, FunctionNode* function);
+FunctionNode* newFunctionNode(Arena* arena, ObjString* name, FunctionNode* enclosing, int line);
+void addParameter(Arena* arena, FunctionNode* function, Variable* parameter);
+
+#define node_is_constant(node) ((node)->type == NODE_CONSTANT)
+
+#endif
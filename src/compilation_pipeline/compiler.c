@@ -5,124 +5,63 @@
 #include "compiler.h"
 #include "../datastructs/bytecode.h"
 #include "../datastructs/value.h"
+#include "../datastructs/value_operations.h"
+#include "../datastructs/dict.h"
 #include "../util.h"
 #include "../debug/debug_switches.h"
 
 #define MAX_BRANCHES 200
+#define MAX_MATCH_ARMS 1024
+#define MAX_JUMP_TABLE 256
 
-#define standard_binary_expression(name, next, condition) \
-    static void name(Compiler* compiler, int canAssign) { \
-        TokenType operator; \
-        next(compiler, canAssign); \
-        while (condition) { \
-            operator = currentTokenType(compiler); \
-            advance(compiler); \
-            next(compiler, 0); \
-            emitBinary(compiler, operator); \
-        } \
-    }       
-
-static void expression(Compiler* compiler);
-static void nonCommaExpression(Compiler* compiler);
-static void statement(Compiler* compiler);
+static void expression(Compiler* compiler, Node* node);
+static void statement(Compiler* compiler, Node* node);
 
 static inline Bytecode* compilingBytecode(Compiler* compiler) {
     return compiler->scope->function->bytecode;
 }
 
-static void error(Compiler* compiler, Token tok, char* message) {
-    if (compiler->panic)
+static void error(Compiler* compiler, char* message) {
+    if (compiler->hadError)
         return;
-    fprintf(stderr, "error ");
-    if (tok.type == TOK_EOF) {
-        fprintf(stderr, "[at end]: ");
-    } else {
-        fprintf(stderr, "[at %d]: ", tok.line);
-    }
-    if (tok.type != TOK_ERROR) {
-        fprintf(stderr, "at '%.*s', ", tok.length, tok.start);
-        fprintf(stderr, "%s\n", message);
-    } else {
-        fprintf(stderr, "%.*s\n", tok.length, tok.start);
-    }
+    fprintf(stderr, "error [at %d]: %s\n", compiler->line, message);
     compiler->hadError = 1;
-    compiler->panic = 1;
-}
-
-static void errorAtCurrent(Compiler* compiler, char* message) {
-    error(compiler, compiler->current, message);
-}
-
-static void errorAtPrevious(Compiler* compiler, char* message) {
-    error(compiler, compiler->previous, message);
-}
-
-static TokenType previousTokenType(Compiler* compiler) {
-    return compiler->previous.type;
-}
-
-static TokenType currentTokenType(Compiler* compiler) {
-    return compiler->current.type;
-}
-
-static void advance(Compiler* compiler) {
-    compiler->previous = compiler->current;
-    for (;;) {
-        compiler->current = nextToken(&compiler->lexer);
-#ifdef TRACE_TOKENS
-        printf("\n...\n");
-        printToken(compiler->current);
-        printf("...\n");
-#endif
-        if (compiler->current.type != TOK_ERROR)
-            break;
-        errorAtCurrent(compiler, "");
-    } 
-}
-
-static int check(Compiler* compiler, TokenType type) {
-    return compiler->current.type == type;
-}   
-
-static int eat(Compiler* compiler, TokenType type) {
-    if (check(compiler, type)) {
-        advance(compiler);
-        return 1;
-    }
-    return 0;
-}
-
-static void eatError(Compiler* compiler, TokenType type, char* msg) {
-    if (!eat(compiler, type)) {
-        errorAtCurrent(compiler, msg);
-        advance(compiler);
-    }
 }
 
 void initCompiler(Compiler* compiler) {
     compiler->hadError = 0;
-    compiler->panic = 0;
+    compiler->line = 0;
     compiler->collector = NULL;
+    compiler->scope = NULL;
 }
 
 static void emitByte(Compiler* compiler, uint8_t byte) {
-    writeBytecode(compiler->collector, compilingBytecode(compiler), byte, compiler->current.line);
+    writeBytecode(compiler->collector, compilingBytecode(compiler), byte, compiler->line);
 }
 
-static inline void emit_addressable_at_current(Compiler* compiler, OpCode longCode, OpCode shortCode, Value value) {
-    writeAddressableInstruction(compiler->collector, compilingBytecode(compiler), longCode, shortCode, value, compiler->current.line);
+static inline void emit_addressable(Compiler* compiler, OpCode longCode, OpCode shortCode, Value value) {
+    writeAddressableInstruction(compiler->collector, compilingBytecode(compiler), &compiler->scope->constants, longCode, shortCode, value, compiler->line);
 }
 
-static inline void emit_addressable_at_previous(Compiler* compiler, OpCode longCode, OpCode shortCode, Value value) {
-    writeAddressableInstruction(compiler->collector, compilingBytecode(compiler), longCode, shortCode, value, compiler->previous.line);
+static inline void emit_variable_size(Compiler* compiler, OpCode longCode, OpCode shortCode, int argument) {
+    writeVariableSizeOp(compiler->collector, compilingBytecode(compiler), longCode, shortCode, (uint16_t) argument, compiler->line);
 }
 
 static void emitConstant(Compiler* compiler, Value val) {
-    emit_addressable_at_current(compiler, OP_CONST_LONG, OP_CONST, val);
+    emit_addressable(compiler, OP_CONST_LONG, OP_CONST, val);
+}
+
+static void emitValue(Compiler* compiler, Value value) {
+    if (is_nihl(value))
+        emitByte(compiler, OP_CONST_NIHL);
+    else if (is_bool(value))
+        emitByte(compiler, as_cbool(value) ? OP_CONST_TRUE : OP_CONST_FALSE);
+    else
+        emitConstant(compiler, value);
 }
 
 static void emitClosure(Compiler* compiler, Scope* scope, ObjFunction* function) {
-    emit_addressable_at_current(compiler, OP_CLOSURE_LONG, OP_CLOSURE, to_vobj(function));
+    emit_addressable(compiler, OP_CLOSURE_LONG, OP_CLOSURE, to_vobj(function));
     for (int i = 0; i < function->upvalueCount; i++) {
         Upvalue* upvalue = &scope->upvalues[i];
         emitByte(compiler, upvalue->ownedAbove);
@@ -130,100 +69,90 @@ static void emitClosure(Compiler* compiler, Scope* scope, ObjFunction* function)
     }
 }
 
-static void emitGlobalDecl(Compiler* compiler, Token identifier) {
-    ObjString* strname = copyString(compiler->collector, identifier.start, identifier.length);
-    Value name = to_vobj(strname);
-    emit_addressable_at_current(compiler, OP_GLOBAL_DECL_LONG, OP_GLOBAL_DECL, name);
-}
-
-static void emitGlobalGet(Compiler* compiler, Value name, int index) {
-    emit_addressable_at_previous(compiler, OP_GLOBAL_GET_LONG, OP_GLOBAL_GET, name);
-}
-
-static void emitGlobalSet(Compiler* compiler, Value name, int index) {
-    emit_addressable_at_previous(compiler, OP_GLOBAL_SET_LONG, OP_GLOBAL_SET, name);
-}
-
-static int identifiersEqual(Token id1, Token id2) {
-    return id1.length == id2.length &&
-        memcmp(id1.start, id2.start, id1.length) == 0;
-}
-
-static int indexLocal(Scope* scope, Token identifier) {
-    for (int i = scope->localsCount - 1; i >= 0; i--) {   
-        Local* local = &scope->locals[i];                  
-        if (identifiersEqual(identifier, local->name)) {
-            return i;                                           
-        }                                                     
-    }
-    return -1; 
-}
-
 static int addUpvalue(Compiler* compiler, Scope* scope, int index, int ownedAbove) {
     int upvalueCount = scope->function->upvalueCount;
-    if (upvalueCount >= MAX_UPVALUES) {
-        errorAtCurrent(compiler, "too many upvalues inside function");
-        return -1;
-    }
     for (int i = 0; i < upvalueCount; i++) {
         Upvalue* upvalue = &scope->upvalues[i];
         if (upvalue->index == index && upvalue->ownedAbove == ownedAbove)
             return i;
     }
+    if (upvalueCount >= MAX_UPVALUES) {
+        error(compiler, "too many upvalues inside function");
+        return 0;
+    }
     scope->upvalues[upvalueCount].index = index;
     scope->upvalues[upvalueCount].ownedAbove = ownedAbove;
     scope->function->upvalueCount++;
     return upvalueCount;
 }
 
-static int indexUpvalue(Compiler* compiler, Scope* scope, Token identifier) {
-    if (scope->enclosing == NULL)
-        return -1;
-    int index = indexLocal(scope->enclosing, identifier);
-    if (index >= 0) {
-        scope->enclosing->locals[index].isCaptured = 1;
-        return addUpvalue(compiler, scope, index, 0);
-    } else {
-        index = indexUpvalue(compiler, scope->enclosing, identifier);
-        if (index >= 0) {
-            return addUpvalue(compiler, scope, index, 1);
-        }
-    }
-    return -1;
-}
-
-static void emitUpvalueGet(Compiler* compiler, Value name, int index) {
-    writeVariableSizeOp(compiler->collector, compilingBytecode(compiler), OP_UPVALUE_GET_LONG, OP_UPVALUE_GET, (uint16_t) index, compiler->previous.line);
+// upvalue of scope through which variable, declared by an enclosing function, is reached
+static int indexUpvalue(Compiler* compiler, Scope* scope, Variable* variable) {
+    if (scope->enclosing->node == variable->function)
+        return addUpvalue(compiler, scope, variable->slot, 0);
+    return addUpvalue(compiler, scope, indexUpvalue(compiler, scope->enclosing, variable), 1);
 }
 
-static void emitUpvalueSet(Compiler* compiler, Value name, int index) {
-    writeVariableSizeOp(compiler->collector, compilingBytecode(compiler), OP_UPVALUE_SET_LONG, OP_UPVALUE_SET, (uint16_t) index, compiler->previous.line);
-}
-
-static void emitLocalGet(Compiler* compiler, Value name, int index) {
-    if (compiler->scope->locals[index].depth < 0) { 
-        errorAtCurrent(compiler, "cannot read local variable in its own initializer");
-    }
-    writeVariableSizeOp(compiler->collector, compilingBytecode(compiler), OP_LOCAL_GET_LONG, OP_LOCAL_GET, (uint16_t) index, compiler->previous.line);
+static void emitVariableGet(Compiler* compiler, Variable* variable) {
+    if (variable->function == compiler->scope->node)
+        emit_variable_size(compiler, OP_LOCAL_GET_LONG, OP_LOCAL_GET, variable->slot);
+    else
+        emit_variable_size(compiler, OP_UPVALUE_GET_LONG, OP_UPVALUE_GET, indexUpvalue(compiler, compiler->scope, variable));
 }
 
-static void emitLocalSet(Compiler* compiler, Value name, int index) {
-    writeVariableSizeOp(compiler->collector, compilingBytecode(compiler), OP_LOCAL_SET_LONG, OP_LOCAL_SET, (uint16_t) index, compiler->previous.line);
+static void emitVariableSet(Compiler* compiler, Variable* variable) {
+    if (variable->function == compiler->scope->node)
+        emit_variable_size(compiler, OP_LOCAL_SET_LONG, OP_LOCAL_SET, variable->slot);
+    else
+        emit_variable_size(compiler, OP_UPVALUE_SET_LONG, OP_UPVALUE_SET, indexUpvalue(compiler, compiler->scope, variable));
 }
 
 static void emitRet(Compiler* compiler) {
     emitByte(compiler, OP_CONST_NIHL);
     emitByte(compiler, OP_RET);
+    emitByte(compiler, 1);
 }
 
 static void emitUnary(Compiler* compiler, TokenType operator) {
     switch (operator) {
-        case TOK_PLUS: break; // NO_OP
         case TOK_MINUS: emitByte(compiler, OP_NEGATE); break;
         case TOK_EXCLAMATION_MARK: emitByte(compiler, OP_NOT); break;
     }
 }
 
+static void emitBinary(Compiler* compiler, TokenType operator) {
+    switch (operator) {
+        case TOK_PLUS: emitByte(compiler, OP_ADD); break;
+        case TOK_MINUS: emitByte(compiler, OP_SUB); break;
+        case TOK_STAR: emitByte(compiler, OP_MUL); break;
+        case TOK_SLASH: emitByte(compiler, OP_DIV); break;
+        case TOK_PERCENTAGE: emitByte(compiler, OP_MOD); break;
+        case TOK_CIRCUMFLEX: emitByte(compiler, OP_POW); break;
+        case TOK_EQUAL_EQUAL: emitByte(compiler, OP_EQUAL); break;
+        case TOK_NOT_EQUAL: emitByte(compiler, OP_NOT_EQUAL); break;
+        case TOK_LESS: emitByte(compiler, OP_LESS); break;
+        case TOK_LESS_EQUAL: emitByte(compiler, OP_LESS_EQUAL); break;
+        case TOK_GREATER: emitByte(compiler, OP_GREATER); break;
+        case TOK_GREATER_EQUAL: emitByte(compiler, OP_GREATER_EQUAL); break;
+        case TOK_PLUS_PLUS: emitByte(compiler, OP_CONCAT); break;
+        case TOK_XOR: emitByte(compiler, OP_XOR); break;
+    }
+}
+
+// operations whose operands are proven to be numbers skip the type checks, when such an opcode exists
+static void emitNumericBinary(Compiler* compiler, TokenType operator) {
+    switch (operator) {
+        case TOK_PLUS: emitByte(compiler, OP_ADD_NUM); break;
+        case TOK_MINUS: emitByte(compiler, OP_SUB_NUM); break;
+        case TOK_STAR: emitByte(compiler, OP_MUL_NUM); break;
+        case TOK_LESS: emitByte(compiler, OP_LESS_NUM); break;
+        case TOK_LESS_EQUAL: emitByte(compiler, OP_LESS_EQUAL_NUM); break;
+        case TOK_GREATER: emitByte(compiler, OP_GREATER_NUM); break;
+        case TOK_GREATER_EQUAL: emitByte(compiler, OP_GREATER_EQUAL_NUM); break;
+        default: emitBinary(compiler, operator); break;
+    }
+}
+
 static int emitJump(Compiler* compiler, OpCode opcode) {
     emitByte(compiler, opcode);
     emitByte(compiler, 0x00);
@@ -231,20 +160,24 @@ static int emitJump(Compiler* compiler, OpCode opcode) {
     return compilingBytecode(compiler)->count - 3;
 }
 
-static int patchJump(Compiler* compiler, int address) {
+static void patchOffset(Compiler* compiler, int position, int offset) {
+    SplittedLong sl = split_long((uint16_t) offset);
+    compilingBytecode(compiler)->code[position] = sl.b0;
+    compilingBytecode(compiler)->code[position + 1] = sl.b1;
+}
+
+static void patchJump(Compiler* compiler, int address) {
     int newarg = compilingBytecode(compiler)->count - address;
-    if (newarg > UINT16_MAX) {                                    
-        errorAtCurrent(compiler, "branch too big");                     
-    } 
-    SplittedLong sl = split_long((uint16_t) newarg);
-    compilingBytecode(compiler)->code[address + 1] = sl.b0;
-    compilingBytecode(compiler)->code[address + 2] = sl.b1;  
+    if (newarg > UINT16_MAX) {
+        error(compiler, "branch too big");
+    }
+    patchOffset(compiler, address + 1, newarg);
 }
 
 static void emitJumpBack(Compiler* compiler, int address) {
     int offset = compilingBytecode(compiler)->count - address;
     if (offset > UINT16_MAX) {
-        errorAtCurrent(compiler, "loop body too big");
+        error(compiler, "loop body too big");
     }
     SplittedLong sl = split_long((uint16_t) offset);
     emitByte(compiler, OP_JUMP_BACK);
@@ -252,44 +185,39 @@ static void emitJumpBack(Compiler* compiler, int address) {
     emitByte(compiler, sl.b1);
 }
 
-static void emitArrayLiteral(Compiler* compiler, int count) {
-    writeVariableSizeOp(compiler->collector, compilingBytecode(compiler), OP_ARRAY_LONG, OP_ARRAY, (uint16_t) count, compiler->previous.line);
-}
-
-static void emitDictionaryLiteral(Compiler* compiler, int count) {
-    writeVariableSizeOp(compiler->collector, compilingBytecode(compiler), OP_DICT_LONG, OP_DICT, (uint16_t) count, compiler->previous.line);
-}
-
-static void emitBinary(Compiler* compiler, TokenType operator) {
-    switch (operator) {
-        case TOK_PLUS: emitByte(compiler, OP_ADD); break;
-        case TOK_MINUS: emitByte(compiler, OP_SUB); break;
-        case TOK_STAR: emitByte(compiler, OP_MUL); break;
-        case TOK_SLASH: emitByte(compiler, OP_DIV); break;
-        case TOK_PERCENTAGE: emitByte(compiler, OP_MOD); break;
-        case TOK_CIRCUMFLEX: emitByte(compiler, OP_POW); break;
-        case TOK_EQUAL_EQUAL: emitByte(compiler, OP_EQUAL); break;
-        case TOK_NOT_EQUAL: emitByte(compiler, OP_NOT_EQUAL); break;
-        case TOK_LESS: emitByte(compiler, OP_LESS); break;
-        case TOK_LESS_EQUAL: emitByte(compiler, OP_LESS_EQUAL); break;
-        case TOK_GREATER: emitByte(compiler, OP_GREATER); break;
-        case TOK_GREATER_EQUAL: emitByte(compiler, OP_GREATER_EQUAL); break;
-        case TOK_PLUS_PLUS: emitByte(compiler, OP_CONCAT); break;
-        case TOK_XOR: emitByte(compiler, OP_XOR); break;
+static void emitCachedIndexing(Compiler* compiler, OpCode opcode, Value key) {
+    Bytecode* bytecode = compilingBytecode(compiler);
+    if (bytecode->cacheCount >= UINT16_MAX) {
+        error(compiler, "too many indexing expressions inside function");
+        return;
     }
+    uint16_t keyAddress = (uint16_t) addConstant(compiler->collector, bytecode, &compiler->scope->constants, key);
+    int cache = addInlineCache(compiler->collector, bytecode);
+    SplittedLong address = split_long(keyAddress);
+    SplittedLong index = split_long((uint16_t) cache);
+    emitByte(compiler, opcode);
+    emitByte(compiler, address.b0);
+    emitByte(compiler, address.b1);
+    emitByte(compiler, index.b0);
+    emitByte(compiler, index.b1);
 }
 
-static void initScope(Compiler* compiler, Scope* scope, ObjString* name) {
+static void initScope(Compiler* compiler, Scope* scope, FunctionNode* node) {
+    scope->node = node;
     scope->depth = 0;
     scope->localsCount = 0;
     scope->loopDepth = 0;
     scope->loopSkipCount = 0;
+    scope->loopLocalsCount = 0;
+    initMap(&scope->constants);
     scope->function = newFunction(compiler->collector);
-    scope->function->name = name;
+    scope->function->name = node->name;
+    scope->function->arity = node->arity;
+    scope->function->isGenerator = node->isGenerator;
 }
 
-static void pushScope(Compiler* compiler, Scope* scope, ObjString* name) {
-    initScope(compiler, scope, name);
+static void pushScope(Compiler* compiler, Scope* scope, FunctionNode* node) {
+    initScope(compiler, scope, node);
     scope->enclosing = compiler->scope;
     compiler->scope = scope;
 }
@@ -297,6 +225,7 @@ static void pushScope(Compiler* compiler, Scope* scope, ObjString* name) {
 static ObjFunction* popScope(Compiler* compiler) {
     emitRet(compiler);
     ObjFunction* function = compiler->scope->function;
+    freeMap(compiler->collector, &compiler->scope->constants);
     compiler->scope = compiler->scope->enclosing;
 #ifdef PRINT_CODE
     printf("FUNCTION CODE:\n");
@@ -306,490 +235,413 @@ static ObjFunction* popScope(Compiler* compiler) {
     return function;
 }
 
-static int alreadyDeclaredLocal(Scope* scope, Token identifier) {
-    for (int i = scope->localsCount - 1; i >= 0; i--) {
-        if (scope->locals[i].depth < scope->depth)
-            return 0;
-        if (identifiersEqual(scope->locals[i].name, identifier))
-            return 1;
-    }
-    return 0; // unreachable
-}
-
-static void declareLocal(Compiler* compiler, Token identifier) {
+// variable is NULL for the hidden locals holding the state of a loop
+static void declareLocal(Compiler* compiler, Variable* variable) {
     Scope* scope = compiler->scope;
-    if (alreadyDeclaredLocal(scope, identifier)) {
-        errorAtCurrent(compiler, "variable with this name already declared in this scope");
-        return;
-    }
     if (scope->localsCount >= MAX_LOCALS) {
-        errorAtCurrent(compiler, "too many locals declared in scope");
+        error(compiler, "too many locals declared in scope");
+        return;
     }
     Local* local = &scope->locals[scope->localsCount];
-    local->name = identifier;
-    local->isCaptured = 0;
-    local->depth = -1;
+    local->variable = variable;
+    local->depth = scope->depth;
+    if (variable != NULL)
+        variable->slot = scope->localsCount;
     scope->localsCount++;
 }
 
-static void defineLocal(Compiler* compiler, Token identifier) {
-    int index = indexLocal(compiler->scope, identifier);
-    // todo: check if index >= 0 ?
-    compiler->scope->locals[index].depth = compiler->scope->depth;
-}
-
-static void numberExpression(Compiler* compiler) {
-    double val = strtod(compiler->current.start, NULL);
-    emitConstant(compiler, to_vnumber(val));
-    advance(compiler);
-}
-
-static void stringExpression(Compiler* compiler) {
-    ObjString* string = copyString(compiler->collector, compiler->current.start + 1, compiler->current.length - 2);
-    emitConstant(compiler, to_vobj(string));
-    advance(compiler);
+static void startScope(Compiler* compiler) {
+    compiler->scope->depth++;
 }
 
-static void identifierExpression(Compiler* compiler, int canAssign) {
-    Token identifier = compiler->current;
-    ObjString* strname = copyString(compiler->collector, identifier.start, identifier.length);
-    Value name = to_vobj(strname);
-    advance(compiler);
-    void (*emitGet)(Compiler*, Value, int) = NULL;
-    void (*emitSet)(Compiler*, Value, int) = NULL;
-    int index = -1;
-    if (compiler->scope->depth > 0 && (index = indexLocal(compiler->scope, identifier)) >= 0) { // locals realm
-        emitGet = &emitLocalGet;
-        emitSet = &emitLocalSet;
-    } else if ((index = indexUpvalue(compiler, compiler->scope, identifier)) >= 0) {
-        emitGet = &emitUpvalueGet;
-        emitSet = &emitUpvalueSet;
-    } else {
-        emitGet = &emitGlobalGet;
-        emitSet = &emitGlobalSet;
-    }
-
-    if (canAssign && eat(compiler, TOK_EQUAL)) {
-        expression(compiler);
-        (*emitSet)(compiler, name, index);
-    } else {
-        (*emitGet)(compiler, name, index);
-    }
+static void emitLocalPop(Compiler* compiler, Local* local) {
+    if (local->variable != NULL && local->variable->isCaptured)
+        emitByte(compiler, OP_CLOSE_UPVALUE);
+    else
+        emitByte(compiler, OP_POP);
 }
 
-static void basicExpression(Compiler* compiler, int canAssign) {
-    switch (currentTokenType(compiler)) {
-        case TOK_STRING:
-            stringExpression(compiler);
-            break;
-        case TOK_NUMBER:
-            numberExpression(compiler);
-            break;
-        case TOK_TRUE:
-            emitByte(compiler, OP_CONST_TRUE);
-            advance(compiler);
-            break;
-        case TOK_FALSE:
-            emitByte(compiler, OP_CONST_FALSE);
-            advance(compiler);
-            break;
-        case TOK_NIHL:
-            emitByte(compiler, OP_CONST_NIHL);
-            advance(compiler);
-            break;
-        case TOK_IDENTIFIER:
-            identifierExpression(compiler, canAssign);
-            break;
-        default:
-            errorAtCurrent(compiler, "unexpected token");
+static void endScope(Compiler* compiler) {
+    Scope* scope = compiler->scope;
+    while (scope->localsCount > 0 && scope->locals[scope->localsCount - 1].depth == scope->depth) {
+        emitLocalPop(compiler, &scope->locals[scope->localsCount - 1]);
+        scope->localsCount--;
     }
+    compiler->scope->depth--;
 }
 
-static void groupingExpression(Compiler* compiler) {
-    advance(compiler); // skip (
-    expression(compiler);
-    eatError(compiler, TOK_RIGHT_ROUND_BRACKET, "missing ')' after grouping expression");
+static void constantExpression(Compiler* compiler, Node* node) {
+    compiler->line = node->line;
+    emitValue(compiler, node->as.constant);
 }
 
-static void arrayExpression(Compiler* compiler) {
-    advance(compiler);
-    int count = 0;
-    if (eat(compiler, TOK_RIGHT_SQUARE_BRACKET)) {
-        emitArrayLiteral(compiler, 0);
-        return;
+static void functionExpression(Compiler* compiler, Node* node) {
+    FunctionNode* functionNode = node->as.function;
+    Scope scope;
+    pushScope(compiler, &scope, functionNode);
+    startScope(compiler);
+    for (int i = 0; i < functionNode->arity; i++) {
+        declareLocal(compiler, functionNode->parameters[i]);
     }
-    do {
-        nonCommaExpression(compiler);
-        count++;
-    } while (eat(compiler, TOK_COMMA));
-    eatError(compiler, TOK_RIGHT_SQUARE_BRACKET, "expected \"]\" after array literal");
-    emitArrayLiteral(compiler, count);
-}
-
-static void dictionaryExpression(Compiler* compiler) {
-    advance(compiler);
-    int count = 0;
-    if (eat(compiler, TOK_RIGHT_CURLY_BRACKET)) {
-        emitDictionaryLiteral(compiler, count);
-        return;
+    for (int i = 0; i < functionNode->body.count; i++) {
+        statement(compiler, functionNode->body.nodes[i]);
     }
-    do {
-        nonCommaExpression(compiler);
-        eatError(compiler, TOK_ARROW, "expected \"=>\" after dictionary key");
-        nonCommaExpression(compiler);
-        count++;
-    } while (eat(compiler, TOK_COMMA));
-    eatError(compiler, TOK_RIGHT_CURLY_BRACKET, "expected \"}\" after dictionary literal");
-    emitDictionaryLiteral(compiler, count);
+    ObjFunction* function = popScope(compiler);
+    compiler->line = node->line;
+    emitClosure(compiler, &scope, function);
 }
 
-static void primaryExpression(Compiler* compiler, int canAssign) {
-    switch (currentTokenType(compiler)) {
-        case TOK_LEFT_ROUND_BRACKET:
-            groupingExpression(compiler);
+// local = local + number and local = local - number, the local proven to hold a number, update it in place
+static int incrementExpression(Compiler* compiler, Node* node) {
+    Variable* variable = node->as.variable.variable;
+    Node* value = node->as.variable.value;
+    if (variable->function != compiler->scope->node || variable->slot > UINT8_MAX)
+        return 0;
+    if (value->type != NODE_BINARY || !value->as.operation.numeric)
+        return 0;
+    TokenType operator = value->as.operation.operator;
+    Node* left = value->as.operation.left;
+    Node* right = value->as.operation.right;
+    if (operator == TOK_PLUS && node_is_constant(left)) {
+        left = right;
+        right = value->as.operation.left;
+    }
+    if ((operator != TOK_PLUS && operator != TOK_MINUS) || !node_is_constant(right))
+        return 0;
+    if (left->type != NODE_VARIABLE_GET || left->as.variable.variable != variable)
+        return 0;
+    double increment = as_cnumber(right->as.constant);
+    if (operator == TOK_MINUS)
+        increment = -increment;
+    int address = addConstant(compiler->collector, compilingBytecode(compiler), &compiler->scope->constants, to_vnumber(increment));
+    if (address > UINT8_MAX)
+        return 0;
+    compiler->line = node->line;
+    emitByte(compiler, OP_LOCAL_INCREMENT);
+    emitByte(compiler, variable->slot);
+    emitByte(compiler, address);
+    return 1;
+}
+
+static void variableExpression(Compiler* compiler, Node* node) {
+    switch (node->type) {
+        case NODE_GLOBAL_GET:
+            compiler->line = node->line;
+            emit_addressable(compiler, OP_GLOBAL_GET_LONG, OP_GLOBAL_GET, to_vobj(node->as.variable.name));
             break;
-        case TOK_LEFT_SQUARE_BRACKET:
-            arrayExpression(compiler);
+        case NODE_GLOBAL_SET:
+            expression(compiler, node->as.variable.value);
+            compiler->line = node->line;
+            emit_addressable(compiler, OP_GLOBAL_SET_LONG, OP_GLOBAL_SET, to_vobj(node->as.variable.name));
             break;
-        case TOK_LEFT_CURLY_BRACKET:
-            dictionaryExpression(compiler);
+        case NODE_VARIABLE_GET:
+            compiler->line = node->line;
+            emitVariableGet(compiler, node->as.variable.variable);
             break;
-        default:
-            basicExpression(compiler, canAssign);
+        case NODE_VARIABLE_SET:
+            if (incrementExpression(compiler, node))
+                break;
+            expression(compiler, node->as.variable.value);
+            compiler->line = node->line;
+            emitVariableSet(compiler, node->as.variable.variable);
             break;
     }
 }
 
-static uint8_t argList(Compiler* compiler) {
-    uint8_t argCount = 0;
-    if (!check(compiler, TOK_RIGHT_ROUND_BRACKET)) {
-        do {
-            argCount++;
-            nonCommaExpression(compiler);
-        } while (eat(compiler, TOK_COMMA));
-    }
-    eatError(compiler, TOK_RIGHT_ROUND_BRACKET, "expect \")\" after function arguments");
-    if (argCount >= UINT8_MAX) {                          
-        errorAtCurrent(compiler, "function arguments limit exceeded");
-    }  
-    return argCount;
-}
-
-static void callExpression(Compiler* compiler, int canAssign) {
-    primaryExpression(compiler, canAssign);    
-    while (check(compiler, TOK_LEFT_ROUND_BRACKET) || check(compiler, TOK_LEFT_SQUARE_BRACKET)) {
-        advance(compiler);
-        switch (previousTokenType(compiler)) {
-            case TOK_LEFT_ROUND_BRACKET:
-                {
-                    uint8_t argCount = argList(compiler);
-                    emitByte(compiler, OP_CALL);
-                    emitByte(compiler, argCount);
-                    break;
-                }
-            case TOK_LEFT_SQUARE_BRACKET:
-                {
-                    expression(compiler);
-                    eatError(compiler, TOK_RIGHT_SQUARE_BRACKET, "expected \"]\" after indexing expression");
-                    if (canAssign && eat(compiler, TOK_EQUAL)) {
-                        expression(compiler);
-                        emitByte(compiler, OP_INDEXING_SET);
-                    } else {
-                        emitByte(compiler, OP_INDEXING_GET);
-                    }
-                    break;
-                }
-        }
-    }        
-}
-
-static void unaryExpression(Compiler* compiler, int canAssign) {
-    TokenType operator;
-    if (check(compiler, TOK_MINUS) || check(compiler, TOK_PLUS) || check(compiler, TOK_EXCLAMATION_MARK)) {
-        operator = currentTokenType(compiler);
-        advance(compiler);
-        unaryExpression(compiler, canAssign);
-        emitUnary(compiler, operator);
+// constant string keys get an inline cached instruction instead of OP_CONST + indexing
+static void indexingExpression(Compiler* compiler, Node* node) {
+    Node* key = node->as.indexing.key;
+    int cached = node_is_constant(key) && is_string(key->as.constant);
+    expression(compiler, node->as.indexing.object);
+    if (!cached)
+        expression(compiler, key);
+    if (node->type == NODE_INDEXING_SET)
+        expression(compiler, node->as.indexing.value);
+    compiler->line = node->line;
+    if (node->type == NODE_INDEXING_SET) {
+        if (cached)
+            emitCachedIndexing(compiler, OP_INDEXING_SET_STR, key->as.constant);
+        else
+            emitByte(compiler, OP_INDEXING_SET);
     } else {
-        callExpression(compiler, canAssign);
+        if (cached)
+            emitCachedIndexing(compiler, OP_INDEXING_GET_STR, key->as.constant);
+        else
+            emitByte(compiler, OP_INDEXING_GET);
     }
 }
 
-static void powExpression(Compiler* compiler, int canAssign) {
-    TokenType operator;
-    unaryExpression(compiler, canAssign);
-    if (check(compiler, TOK_CIRCUMFLEX)) {
-        operator = currentTokenType(compiler);
-        advance(compiler);
-        powExpression(compiler, 0);
-        emitBinary(compiler, operator);
+static void callExpression(Compiler* compiler, Node* node) {
+    expression(compiler, node->as.call.callee);
+    for (int i = 0; i < node->as.call.arguments.count; i++) {
+        expression(compiler, node->as.call.arguments.nodes[i]);
     }
+    compiler->line = node->line;
+    emitByte(compiler, OP_CALL);
+    emitByte(compiler, node->as.call.arguments.count);
+    emitByte(compiler, node->as.call.unpacked > 0 ? node->as.call.unpacked : 1);
 }
 
-standard_binary_expression(multExpression, powExpression,
-        check(compiler, TOK_STAR) || check(compiler, TOK_SLASH) || check(compiler, TOK_PERCENTAGE))
-
-standard_binary_expression(addExpression, multExpression,
-        check(compiler, TOK_PLUS) || check(compiler, TOK_MINUS) || check(compiler, TOK_PLUS_PLUS))
-
-standard_binary_expression(comparisonExpression, addExpression,
-        check(compiler, TOK_LESS) || check(compiler, TOK_LESS_EQUAL)
-        || check (compiler, TOK_GREATER) || check(compiler, TOK_GREATER_EQUAL))
-
-standard_binary_expression(equalExpression, comparisonExpression, 
-        check(compiler, TOK_EQUAL_EQUAL) || check(compiler, TOK_NOT_EQUAL))
-
-    static int checkBranchesBoundary(Compiler* compiler, int jumpAddressesPointer, char* message) {
-        if (jumpAddressesPointer >= MAX_BRANCHES) {
-            errorAtCurrent(compiler, message);
-            return 0;
-        }
-        return 1;
-    }
-
-static void andExpression(Compiler* compiler, int canAssign) {
-    int jumpAddresses[MAX_BRANCHES];
-    int jumpAddressesPointer = 0;
-
-    equalExpression(compiler, canAssign);
-    while (eat(compiler, TOK_AND)) {
-        if (!checkBranchesBoundary(compiler, jumpAddressesPointer, "short circuit expression too long"))
-            return;
-        jumpAddresses[jumpAddressesPointer++] = emitJump(compiler, OP_JUMP_IF_FALSE);
-        emitByte(compiler, OP_POP);
-        equalExpression(compiler, 0);
-    }
-
-    for (int i = 0; i < jumpAddressesPointer; i++)
-        patchJump(compiler, jumpAddresses[i]);
+static void operationExpression(Compiler* compiler, Node* node) {
+    expression(compiler, node->as.operation.left);
+    if (node->type == NODE_BINARY)
+        expression(compiler, node->as.operation.right);
+    compiler->line = node->line;
+    if (node->type == NODE_BINARY && node->as.operation.numeric)
+        emitNumericBinary(compiler, node->as.operation.operator);
+    else if (node->type == NODE_BINARY)
+        emitBinary(compiler, node->as.operation.operator);
+    else
+        emitUnary(compiler, node->as.operation.operator);
 }
 
-static void orExpression(Compiler* compiler, int canAssign) {
+// and/or: every operand but the last one skips to the end when it decides the result
+static void shortCircuitExpression(Compiler* compiler, Node* node) {
     int jumpAddresses[MAX_BRANCHES];
     int jumpAddressesPointer = 0;
-    while (eat(compiler, TOK_OR)) {
-        if (!checkBranchesBoundary(compiler, jumpAddressesPointer, "short circuit expression too long"))
+    OpCode jump = node->type == NODE_AND ? OP_JUMP_IF_FALSE : OP_JUMP_IF_TRUE;
+    NodeList* operands = &node->as.list;
+    for (int i = 0; i < operands->count; i++) {
+        expression(compiler, operands->nodes[i]);
+        if (i == operands->count - 1)
+            break;
+        if (jumpAddressesPointer >= MAX_BRANCHES) {
+            error(compiler, "short circuit expression too long");
             return;
-        jumpAddresses[jumpAddressesPointer++] = emitJump(compiler, OP_JUMP_IF_TRUE);
+        }
+        compiler->line = node->line;
+        jumpAddresses[jumpAddressesPointer++] = emitJump(compiler, jump);
         emitByte(compiler, OP_POP);
-        andExpression(compiler, 0);
     }
-
     for (int i = 0; i < jumpAddressesPointer; i++)
         patchJump(compiler, jumpAddresses[i]);
 }
 
-static void logicalSumExpression(Compiler* compiler, int canAssign) {
-    TokenType operator;
-    andExpression(compiler, canAssign);
-    while (check(compiler, TOK_OR) || check(compiler, TOK_XOR)) {
-        operator = currentTokenType(compiler);
-        if (operator == TOK_XOR) {
-            advance(compiler);
-            andExpression(compiler, 0);
-            emitBinary(compiler, TOK_XOR);
-        } else {
-            orExpression(compiler, 0);
-        }
-    }
-}
-
-static void ternaryExpression(Compiler* compiler, int canAssign) {
-    logicalSumExpression(compiler, canAssign);
-    if (eat(compiler, TOK_QUESTION_MARK)) {
-        int skipfirst = emitJump(compiler, OP_JUMP_IF_FALSE);
-        emitByte(compiler, OP_POP);
-        expression(compiler);
-        int skipsecond = emitJump(compiler, OP_JUMP);
-        patchJump(compiler, skipfirst);
-        emitByte(compiler, OP_POP);
-        eatError(compiler, TOK_COLON, "expected \":\" inside ternary expression");
-        expression(compiler);
-        patchJump(compiler, skipsecond);
-    }
-}
-
-static void nonCommaExpression(Compiler* compiler) {
-    ternaryExpression(compiler, 1);
-}
-
-static void commaExpression(Compiler* compiler) {
-    nonCommaExpression(compiler);
-    while (eat(compiler, TOK_COMMA)) {
-        emitByte(compiler, OP_POP);
-        nonCommaExpression(compiler);
-    }
-}
-
-static void expression(Compiler* compiler) {
-    return commaExpression(compiler); 
-}
-
-static void block(Compiler* compiler) {
-    while (currentTokenType(compiler) != TOK_EOF && currentTokenType(compiler) != TOK_DEDENT) {
-        statement(compiler);
-    }
-    eatError(compiler, TOK_DEDENT, "missing dedent to close block");
-}
-
-static void startScope(Compiler* compiler) {
-    compiler->scope->depth++;
+static void ternaryExpression(Compiler* compiler, Node* node) {
+    expression(compiler, node->as.branch.condition);
+    compiler->line = node->line;
+    int skipfirst = emitJump(compiler, OP_JUMP_IF_FALSE);
+    emitByte(compiler, OP_POP);
+    expression(compiler, node->as.branch.then);
+    int skipsecond = emitJump(compiler, OP_JUMP);
+    patchJump(compiler, skipfirst);
+    emitByte(compiler, OP_POP);
+    expression(compiler, node->as.branch.otherwise);
+    patchJump(compiler, skipsecond);
 }
 
-static void endScope(Compiler* compiler) {
-    Scope* scope = compiler->scope;
-    while (scope->localsCount > 0 && scope->locals[scope->localsCount - 1].depth == scope->depth) {
-        if (scope->locals[scope->localsCount - 1].isCaptured)
-            emitByte(compiler, OP_CLOSE_UPVALUE);
-        else 
+static void commaExpression(Compiler* compiler, Node* node) {
+    for (int i = 0; i < node->as.list.count; i++) {
+        if (i > 0)
             emitByte(compiler, OP_POP);
-        scope->localsCount--;
+        expression(compiler, node->as.list.nodes[i]);
     }
-    compiler->scope->depth--;
 }
 
-static void blockStat(Compiler* compiler) {
-    advance(compiler);
+static void literalExpression(Compiler* compiler, Node* node) {
+    for (int i = 0; i < node->as.list.count; i++) {
+        expression(compiler, node->as.list.nodes[i]);
+    }
+    compiler->line = node->line;
+    if (node->type == NODE_ARRAY)
+        emit_variable_size(compiler, OP_ARRAY_LONG, OP_ARRAY, node->as.list.count);
+    else
+        emit_variable_size(compiler, OP_DICT_LONG, OP_DICT, node->as.list.count / 2);
+}
+
+static void expression(Compiler* compiler, Node* node) {
+    switch (node->type) {
+        case NODE_CONSTANT: constantExpression(compiler, node); break;
+        case NODE_GLOBAL_GET:
+        case NODE_GLOBAL_SET:
+        case NODE_VARIABLE_GET:
+        case NODE_VARIABLE_SET: variableExpression(compiler, node); break;
+        case NODE_INDEXING_GET:
+        case NODE_INDEXING_SET: indexingExpression(compiler, node); break;
+        case NODE_CALL: callExpression(compiler, node); break;
+        case NODE_UNARY:
+        case NODE_BINARY: operationExpression(compiler, node); break;
+        case NODE_AND:
+        case NODE_OR: shortCircuitExpression(compiler, node); break;
+        case NODE_TERNARY: ternaryExpression(compiler, node); break;
+        case NODE_COMMA: commaExpression(compiler, node); break;
+        case NODE_ARRAY:
+        case NODE_DICT: literalExpression(compiler, node); break;
+        case NODE_FUNCTION: functionExpression(compiler, node); break;
+        default: error(compiler, "statement used as expression"); break;
+    }
+}
+
+static void blockStat(Compiler* compiler, Node* node) {
     startScope(compiler);
-    block(compiler);
+    for (int i = 0; i < node->as.list.count; i++) {
+        statement(compiler, node->as.list.nodes[i]);
+    }
+    compiler->line = node->line;
     endScope(compiler);
 }
 
-static void expressionStat(Compiler* compiler) {
-    expression(compiler);
-    emitByte(compiler, OP_POP);
-    eatError(compiler, TOK_NEW_LINE, "expected new line at end of statement");
-}
-
-static void printStat(Compiler* compiler) {
-    advance(compiler); // skip 'print'
-    expression(compiler);
-    emitByte(compiler, OP_PRINT);
-    eatError(compiler, TOK_NEW_LINE, "expected new line at end of statement");
-}
-
-static void letStat(Compiler* compiler) {
-    advance(compiler); // skip 'let'
-    eatError(compiler, TOK_IDENTIFIER, "expected identifier after \"let\"");
-    Token identifier = compiler->previous;
-    if (compiler->scope->depth > 0) {
-        declareLocal(compiler, identifier);
-    }
-    if (eat(compiler, TOK_EQUAL)) {
-        expression(compiler);
+static void letStat(Compiler* compiler, Node* node) {
+    Variable* variable = node->as.variable.variable;
+    if (variable != NULL)
+        declareLocal(compiler, variable);
+    if (node->as.variable.value != NULL) {
+        expression(compiler, node->as.variable.value);
     } else {
+        compiler->line = node->line;
         emitByte(compiler, OP_CONST_NIHL);
     }
-    if (compiler->scope->depth == 0) {
-        emitGlobalDecl(compiler, identifier);
-    } else {
-        defineLocal(compiler, identifier);
+    if (variable == NULL) {
+        compiler->line = node->line;
+        emit_addressable(compiler, OP_GLOBAL_DECL_LONG, OP_GLOBAL_DECL, to_vobj(node->as.variable.name));
     }
-    eatError(compiler, TOK_NEW_LINE, "expected new line at end of statement");
 }
 
-static void parseFunctionDeclaration(Compiler* compiler, Token name) {
-    Scope scope;
-    pushScope(compiler, &scope, copyString(compiler->collector, name.start, name.length));
-    startScope(compiler);
-    eatError(compiler, TOK_LEFT_ROUND_BRACKET, "expected \"(\" before function parameters");
-    if (!check(compiler, TOK_RIGHT_ROUND_BRACKET)) {
-        do {
-            compiler->scope->function->arity++;
-            if (compiler->scope->function->arity >= UINT8_MAX)
-                errorAtCurrent(compiler, "maximum number of function parameters exceeded");
-            eatError(compiler, TOK_IDENTIFIER, "expected identifier inside function's \"()\"");
-            Token identifier = compiler->previous;
-            declareLocal(compiler, identifier);
-            defineLocal(compiler, identifier);
-        } while (eat(compiler, TOK_COMMA));
-    }
-    eatError(compiler, TOK_RIGHT_ROUND_BRACKET, "expected \")\" after function parameters");
-    eatError(compiler, TOK_NEW_LINE, "expected new line after function parameters");
-    if (!check(compiler, TOK_INDENT))
-        errorAtCurrent(compiler, "expected indent after function parameters");
-    advance(compiler);
-    block(compiler);
-    ObjFunction* function = popScope(compiler);
-    emitClosure(compiler, &scope, function);
-}
-
-static void funcStat(Compiler* compiler) {
-    advance(compiler); // skip 'func'
-    eatError(compiler, TOK_IDENTIFIER, "expected function name after \"func\"");
-    Token identifier = compiler->previous;
-
-    if (compiler->scope->depth > 0) {
-        declareLocal(compiler, identifier);
-        defineLocal(compiler, identifier);
+// the values returned by the call are left on the stack: locals declared in order right below them take
+// them as they are, globals are declared from the last one
+static void unpackStat(Compiler* compiler, Node* node) {
+    NodeList* targets = &node->as.unpack.targets;
+    for (int i = 0; i < targets->count; i++) {
+        Variable* variable = targets->nodes[i]->as.variable.variable;
+        if (variable != NULL)
+            declareLocal(compiler, variable);
+    }
+    expression(compiler, node->as.unpack.call);
+    for (int i = targets->count - 1; i >= 0; i--) {
+        Node* target = targets->nodes[i];
+        if (target->as.variable.variable == NULL) {
+            compiler->line = target->line;
+            emit_addressable(compiler, OP_GLOBAL_DECL_LONG, OP_GLOBAL_DECL, to_vobj(target->as.variable.name));
+        }
     }
-    parseFunctionDeclaration(compiler, identifier);
-    if (compiler->scope->depth == 0) {
-        emitGlobalDecl(compiler, identifier);
-    } 
 }
 
-static void ifStat(Compiler* compiler) {
-    int jumpAddresses[MAX_BRANCHES];
-    int jumpAddressesPointer = 0;
-
-    advance(compiler); // skip if
-    expression(compiler);
-    eatError(compiler, TOK_NEW_LINE, "expected new line after if condition");
+static void ifStat(Compiler* compiler, Node* node) {
+    expression(compiler, node->as.branch.condition);
+    compiler->line = node->line;
     int jumpif = emitJump(compiler, OP_JUMP_IF_FALSE);
     emitByte(compiler, OP_POP);
-    if (!check(compiler, TOK_INDENT))
-        errorAtCurrent(compiler, "expect indent after if");
-    blockStat(compiler);
-    jumpAddresses[jumpAddressesPointer++] = emitJump(compiler, OP_JUMP);
-    patchJump(compiler, jumpif); 
+    statement(compiler, node->as.branch.then);
+    int jumpEnd = emitJump(compiler, OP_JUMP);
+    patchJump(compiler, jumpif);
     emitByte(compiler, OP_POP);
-
-    while (eat(compiler, TOK_ELIF)) {
-        if (!checkBranchesBoundary(compiler, jumpAddressesPointer, "too many elifs"))
-            return;
-        expression(compiler);
-        eatError(compiler, TOK_NEW_LINE, "expected new line after elif condition");
-        int jumpelif = emitJump(compiler, OP_JUMP_IF_FALSE);
-        emitByte(compiler, OP_POP);
-        if (!check(compiler, TOK_INDENT))
-            errorAtCurrent(compiler, "expect indent after elif");
-        blockStat(compiler);
-        jumpAddresses[jumpAddressesPointer++] = emitJump(compiler, OP_JUMP);
-        patchJump(compiler, jumpelif); 
-        emitByte(compiler, OP_POP);
-    }
-
-    if (eat(compiler, TOK_ELSE)) {
-        eatError(compiler, TOK_NEW_LINE, "expected new line after else");
-        if (!check(compiler, TOK_INDENT))
-            errorAtCurrent(compiler, "expect indent after else");
-        blockStat(compiler);
+    if (node->as.branch.otherwise != NULL)
+        statement(compiler, node->as.branch.otherwise);
+    patchJump(compiler, jumpEnd);
+}
+
+// dense integer cases index a table of offsets, any other case is looked up in a hashed dict
+static int denseCases(Node* node, double* min, int* size) {
+    int values = 0;
+    double max = 0;
+    for (int i = 0; i < node->as.match.arms.count; i++) {
+        NodeList* list = &node->as.match.arms.nodes[i]->as.arm.values;
+        for (int j = 0; j < list->count; j++) {
+            Value value = list->nodes[j]->as.constant;
+            if (!is_number(value))
+                return 0;
+            double n = as_cnumber(value);
+            if (!(n >= -MAX_MATCH_ARMS * MAX_JUMP_TABLE && n <= MAX_MATCH_ARMS * MAX_JUMP_TABLE) || n != (double) (int) n)
+                return 0;
+            if (values == 0 || n < *min)
+                *min = n;
+            if (values == 0 || n > max)
+                max = n;
+            values++;
+        }
     }
+    *size = (int) (max - *min) + 1;
+    return *size <= MAX_JUMP_TABLE && *size <= 2 * values;
+}
 
-    for (int i = 0; i < jumpAddressesPointer; i++)
-        patchJump(compiler, jumpAddresses[i]);
+static void emitShort(Compiler* compiler, int arg) {
+    SplittedLong sl = split_long((uint16_t) arg);
+    emitByte(compiler, sl.b0);
+    emitByte(compiler, sl.b1);
 }
 
-static void enterLoop(Compiler* compiler) {
-    compiler->scope->loopDepth++;
+// offsets are relative to the dispatching instruction, which pops the subject
+static void matchStat(Compiler* compiler, Node* node) {
+    NodeList* arms = &node->as.match.arms;
+    Bytecode* bytecode = compilingBytecode(compiler);
+    double min = 0;
+    int size = 0;
+    int dense = denseCases(node, &min, &size);
+    ObjDict* table = NULL;
+    expression(compiler, node->as.match.subject);
+    compiler->line = node->line;
+    int address = bytecode->count;
+    int defaultPosition;
+    if (dense) {
+        emitByte(compiler, OP_JUMP_TABLE);
+        emitShort(compiler, addConstant(compiler->collector, bytecode, &compiler->scope->constants, to_vnumber(min)));
+        emitShort(compiler, size);
+        defaultPosition = bytecode->count;
+        for (int i = 0; i <= size; i++)
+            emitShort(compiler, 0);
+    } else {
+        table = newHashedDict(compiler->collector);
+        pushSafeObj(compiler->collector, table);
+        emitByte(compiler, OP_JUMP_HASH);
+        emitShort(compiler, addConstant(compiler->collector, bytecode, NULL, to_vobj(table)));
+        popSafe(compiler->collector);
+        defaultPosition = bytecode->count;
+        emitShort(compiler, 0);
+    }
+    int exits[MAX_MATCH_ARMS];
+    int exitsCount = 0;
+    for (int i = 0; i < arms->count; i++) {
+        int offset = bytecode->count - address;
+        if (offset > UINT16_MAX) {
+            error(compiler, "match too big");
+            return;
+        }
+        NodeList* values = &arms->nodes[i]->as.arm.values;
+        for (int j = 0; j < values->count; j++) {
+            Value value = values->nodes[j]->as.constant;
+            if (dense)
+                patchOffset(compiler, defaultPosition + 2 + 2 * ((int) as_cnumber(value) - (int) min), offset);
+            else
+                dictPut(compiler->collector, table, value, to_vnumber(offset));
+        }
+        statement(compiler, arms->nodes[i]->as.arm.body);
+        if (i < arms->count - 1 || node->as.match.otherwise != NULL) {
+            compiler->line = node->line;
+            exits[exitsCount++] = emitJump(compiler, OP_JUMP);
+        }
+    }
+    int otherwise = bytecode->count - address;
+    if (otherwise > UINT16_MAX) {
+        error(compiler, "match too big");
+        return;
+    }
+    patchOffset(compiler, defaultPosition, otherwise);
+    if (dense) {
+        // the holes between cases go to the default too
+        for (int i = 0; i < size; i++) {
+            int position = defaultPosition + 2 + 2 * i;
+            if (bytecode->code[position] == 0 && bytecode->code[position + 1] == 0)
+                patchOffset(compiler, position, otherwise);
+        }
+    }
+    if (node->as.match.otherwise != NULL)
+        statement(compiler, node->as.match.otherwise);
+    for (int i = 0; i < exitsCount; i++)
+        patchJump(compiler, exits[i]);
 }
 
 static void exitLoop(Compiler* compiler) {
     Scope* scope = compiler->scope;
-    // memory safe ?
-    LoopSkip* skip = &scope->loopSkips[scope->loopSkipCount - 1];
-    while (scope->loopSkipCount - 1 >= 0 && skip->loopDepth == scope->loopDepth) {
+    while (scope->loopSkipCount > 0 && scope->loopSkips[scope->loopSkipCount - 1].loopDepth == scope->loopDepth) {
         scope->loopSkipCount--;
-        skip = &scope->loopSkips[scope->loopSkipCount - 1];
     }
-    compiler->scope->loopDepth--;
+    scope->loopDepth--;
 }
 
 static void pushSkip(Compiler* compiler, int address, SkipType type) {
     Scope* scope = compiler->scope;
     if (scope->loopSkipCount >= MAX_LOOP_SKIPS) {
-        errorAtCurrent(compiler, "too many breaks and continues in a function");
+        error(compiler, "too many breaks and continues in a function");
         return;
     }
     LoopSkip* skip = &scope->loopSkips[scope->loopSkipCount];
@@ -801,149 +653,241 @@ static void pushSkip(Compiler* compiler, int address, SkipType type) {
 
 static void patchSkip(Compiler* compiler, SkipType type) {
     Scope* scope = compiler->scope;
-    int skipCount = scope->loopSkipCount;
-    LoopSkip* skip = &scope->loopSkips[skipCount - 1];
-    while (skipCount - 1 >= 0 && skip->loopDepth == scope->loopDepth) {
-        if (skip->type == type)
-            patchJump(compiler, skip->address);
-        skipCount--;
-        skip = &scope->loopSkips[skipCount - 1];
+    for (int i = scope->loopSkipCount - 1; i >= 0 && scope->loopSkips[i].loopDepth == scope->loopDepth; i--) {
+        if (scope->loopSkips[i].type == type)
+            patchJump(compiler, scope->loopSkips[i].address);
     }
 }
 
-static void pushBreak(Compiler* compiler, int breakAddress) {
-    pushSkip(compiler, breakAddress, SKIP_BREAK);
-}
-
-static void patchBreak(Compiler* compiler) {
-    patchSkip(compiler, SKIP_BREAK);
-}
-
-static void emitBreak(Compiler* compiler) {
-    int breakAddress = emitJump(compiler, OP_JUMP);
-    pushBreak(compiler, breakAddress);
-}
-
-static void breakStat(Compiler* compiler) {
-    if (compiler->scope->loopDepth <= 0) {
-        errorAtCurrent(compiler, "cannot use \"break\" outside of a loop");
-        return;
+// breaks and continues leave the loop body: the locals it declared so far are discarded first
+static void loopSkipStat(Compiler* compiler, Node* node) {
+    Scope* scope = compiler->scope;
+    compiler->line = node->line;
+    for (int i = scope->localsCount - 1; i >= scope->loopLocalsCount; i--) {
+        emitLocalPop(compiler, &scope->locals[i]);
     }
-    advance(compiler); // skip break
-    eatError(compiler, TOK_NEW_LINE, "expected new line after \"break\"");
-    emitBreak(compiler); 
-}
-
-static void pushContinue(Compiler* compiler, int continueAddress) {
-    pushSkip(compiler, continueAddress, SKIP_CONTINUE);
+    int address = emitJump(compiler, OP_JUMP);
+    pushSkip(compiler, address, node->type == NODE_BREAK ? SKIP_BREAK : SKIP_CONTINUE);
 }
 
-static void patchContinue(Compiler* compiler) {
+static void whileStat(Compiler* compiler, Node* node) {
+    Scope* scope = compiler->scope;
+    Node* condition = node->as.branch.condition;
+    // a constant true condition is never tested: the loop only ends with a break
+    int forever = node_is_constant(condition) && isTruthy(condition->as.constant);
+    int enclosingLoopLocalsCount = scope->loopLocalsCount;
+    int jumpwhile = -1;
+    scope->loopDepth++;
+    scope->loopLocalsCount = scope->localsCount;
+    int jumpBackAddress = compilingBytecode(compiler)->count;
+    if (!forever) {
+        expression(compiler, condition);
+        compiler->line = node->line;
+        jumpwhile = emitJump(compiler, OP_JUMP_IF_FALSE);
+        emitByte(compiler, OP_POP);
+    }
+    statement(compiler, node->as.branch.then);
     patchSkip(compiler, SKIP_CONTINUE);
+    compiler->line = node->line;
+    emitJumpBack(compiler, jumpBackAddress);
+    if (jumpwhile >= 0) {
+        patchJump(compiler, jumpwhile);
+        emitByte(compiler, OP_POP);
+    }
+    patchSkip(compiler, SKIP_BREAK);
+    exitLoop(compiler);
+    scope->loopLocalsCount = enclosingLoopLocalsCount;
 }
 
-static void emitContinue(Compiler* compiler) {
-    int continueAddress = emitJump(compiler, OP_JUMP);
-    pushContinue(compiler, continueAddress);
-}
-
-static void continueStat(Compiler* compiler) {
-    if (compiler->scope->loopDepth <= 0) {
-        errorAtCurrent(compiler, "cannot use \"continue\" outside of a loop");
+// every value is left on the stack, OP_RET moves them where the caller expects them
+static void retStat(Compiler* compiler, Node* node) {
+    NodeList* values = &node->as.list;
+    if (values->count == 0) {
+        compiler->line = node->line;
+        emitRet(compiler);
         return;
     }
-    advance(compiler); // skip continue
-    eatError(compiler, TOK_NEW_LINE, "expected new line after \"continue\"");
-    emitContinue(compiler); 
+    if (compiler->scope->node->isGenerator) {
+        compiler->line = node->line;
+        error(compiler, "cannot return a value from a generator");
+    }
+    for (int i = 0; i < values->count; i++) {
+        expression(compiler, values->nodes[i]);
+    }
+    compiler->line = node->line;
+    emitByte(compiler, OP_RET);
+    emitByte(compiler, values->count);
 }
 
-static void whileStat(Compiler* compiler) {
-    enterLoop(compiler);
-    advance(compiler); // skip while
-    int jumpBackAddress = compilingBytecode(compiler)->count; 
-    expression(compiler);
-    eatError(compiler, TOK_NEW_LINE, "expected new line after while condition");
-    int jumpwhile = emitJump(compiler, OP_JUMP_IF_FALSE);
-    emitByte(compiler, OP_POP);
-    if (!check(compiler, TOK_INDENT))
-        errorAtCurrent(compiler, "expect indent after while");
-    blockStat(compiler);
-    patchContinue(compiler);
-    emitJumpBack(compiler, jumpBackAddress);
-    patchJump(compiler, jumpwhile); 
-    emitByte(compiler, OP_POP);
-    patchBreak(compiler);
+// counter, bound and step live in hidden locals right below the loop variable. OP_FOR_PREP checks them and
+// skips empty ranges, OP_FOR_RANGE closes the end of each iteration: it increments the counter, compares it
+// with the bound and jumps back to the body, storing it into the loop variable, in a single dispatch
+static void forRangeStat(Compiler* compiler, Node* node) {
+    Scope* scope = compiler->scope;
+    int enclosingLoopLocalsCount = scope->loopLocalsCount;
+    Variable* variable = node->as.loop.variable;
+    startScope(compiler);
+    int state = scope->localsCount;
+    expression(compiler, node->as.loop.start);
+    expression(compiler, node->as.loop.end);
+    if (node->as.loop.step != NULL) {
+        expression(compiler, node->as.loop.step);
+    } else {
+        compiler->line = node->line;
+        emitConstant(compiler, to_vnumber(1));
+    }
+    for (int i = 0; i < 3; i++) {
+        declareLocal(compiler, NULL);
+    }
+    declareLocal(compiler, variable);
+    compiler->line = node->line;
+    SplittedLong slot = split_long((uint16_t) state);
+    int jumpExit = emitJump(compiler, OP_FOR_PREP);
+    emitByte(compiler, slot.b0);
+    emitByte(compiler, slot.b1);
+
+    scope->loopDepth++;
+    scope->loopLocalsCount = scope->localsCount;
+    int bodyAddress = compilingBytecode(compiler)->count;
+    statement(compiler, node->as.loop.body);
+    patchSkip(compiler, SKIP_CONTINUE);
+    compiler->line = node->line;
+    int offset = compilingBytecode(compiler)->count - bodyAddress;
+    if (offset > UINT16_MAX)
+        error(compiler, "loop body too big");
+    SplittedLong back = split_long((uint16_t) offset);
+    emitByte(compiler, OP_FOR_RANGE);
+    emitByte(compiler, back.b0);
+    emitByte(compiler, back.b1);
+    emitByte(compiler, slot.b0);
+    emitByte(compiler, slot.b1);
+    emitByte(compiler, variable->isCaptured); // each iteration gets a variable of its own
+    patchJump(compiler, jumpExit);
+    patchSkip(compiler, SKIP_BREAK);
     exitLoop(compiler);
+    scope->loopLocalsCount = enclosingLoopLocalsCount;
+    endScope(compiler);
 }
 
-static void retStat(Compiler* compiler) {
-    advance(compiler);
-    if (check(compiler, TOK_NEW_LINE) || check(compiler, TOK_EOF)) {
-        emitRet(compiler);
-    } else {
-        expression(compiler);
-        emitByte(compiler, OP_RET);
-    }
-    if (!check(compiler, TOK_NEW_LINE) && !check(compiler, TOK_EOF))
-        errorAtCurrent(compiler, "unexpected token after ret statement");
-    else
-        advance(compiler);
+// the container, a cursor and its size at the start, used to detect changes, live in hidden locals
+static void forEachStat(Compiler* compiler, Node* node) {
+    Scope* scope = compiler->scope;
+    int enclosingLoopLocalsCount = scope->loopLocalsCount;
+    Variable* key = node->as.loop.key;
+    Variable* variable = node->as.loop.variable;
+    startScope(compiler);
+    int state = scope->localsCount;
+    expression(compiler, node->as.loop.start);
+    for (int i = 0; i < 3; i++) {
+        declareLocal(compiler, NULL);
+    }
+    declareLocal(compiler, key);
+    declareLocal(compiler, variable);
+    compiler->line = node->line;
+    SplittedLong slot = split_long((uint16_t) state);
+    int jumpNext = emitJump(compiler, OP_ITER_PREP);
+    emitByte(compiler, slot.b0);
+    emitByte(compiler, slot.b1);
+
+    scope->loopDepth++;
+    scope->loopLocalsCount = scope->localsCount;
+    int bodyAddress = compilingBytecode(compiler)->count;
+    statement(compiler, node->as.loop.body);
+    patchSkip(compiler, SKIP_CONTINUE);
+    patchJump(compiler, jumpNext);
+    compiler->line = node->line;
+    int offset = compilingBytecode(compiler)->count - bodyAddress;
+    if (offset > UINT16_MAX)
+        error(compiler, "loop body too big");
+    SplittedLong back = split_long((uint16_t) offset);
+    emitByte(compiler, OP_ITER_NEXT);
+    emitByte(compiler, back.b0);
+    emitByte(compiler, back.b1);
+    emitByte(compiler, slot.b0);
+    emitByte(compiler, slot.b1);
+    // each iteration gets variables of its own
+    emitByte(compiler, variable->isCaptured | (key != NULL && key->isCaptured) << 1);
+    patchSkip(compiler, SKIP_BREAK);
+    exitLoop(compiler);
+    scope->loopLocalsCount = enclosingLoopLocalsCount;
+    endScope(compiler);
 }
 
-static void statement(Compiler* compiler) {
-    switch (currentTokenType(compiler)) {
-        case TOK_LET:
-            letStat(compiler);
+static void statement(Compiler* compiler, Node* node) {
+    switch (node->type) {
+        case NODE_EXPRESSION_STAT:
+            expression(compiler, node->as.expression);
+            compiler->line = node->line;
+            emitByte(compiler, OP_POP);
+            break;
+        case NODE_PRINT:
+            expression(compiler, node->as.expression);
+            compiler->line = node->line;
+            emitByte(compiler, OP_PRINT);
+            break;
+        case NODE_YIELD:
+            expression(compiler, node->as.expression);
+            compiler->line = node->line;
+            emitByte(compiler, OP_YIELD);
+            break;
+        case NODE_LET:
+            letStat(compiler, node);
             break;
-        case TOK_PRINT:
-            printStat(compiler);
+        case NODE_UNPACK:
+            unpackStat(compiler, node);
             break;
-        case TOK_INDENT:
-            blockStat(compiler);
+        case NODE_BLOCK:
+            blockStat(compiler, node);
             break;
-        case TOK_IF:
-            ifStat(compiler);
+        case NODE_IF:
+            ifStat(compiler, node);
             break;
-        case TOK_WHILE:
-            whileStat(compiler);
+        case NODE_WHILE:
+            whileStat(compiler, node);
             break;
-        case TOK_FUNC:
-            funcStat(compiler);
+        case NODE_MATCH:
+            matchStat(compiler, node);
             break;
-        case TOK_RET:
-            retStat(compiler);
+        case NODE_FOR_RANGE:
+            forRangeStat(compiler, node);
             break;
-        case TOK_BREAK:
-            breakStat(compiler);
+        case NODE_FOR_EACH:
+            forEachStat(compiler, node);
             break;
-        case TOK_CONTINUE:
-            continueStat(compiler);
+        case NODE_RET:
+            retStat(compiler, node);
+            break;
+        case NODE_BREAK:
+        case NODE_CONTINUE:
+            loopSkipStat(compiler, node);
             break;
         default:
-            expressionStat(compiler);
+            error(compiler, "expression used as statement");
             break;
     }
 }
 
-static void statementList(Compiler* compiler) {
-    while (!check(compiler, TOK_EOF)) {
-        statement(compiler);
-    }
-}
-
-ObjFunction* compile(Compiler* compiler, Collector* collector, char* source) {
+ObjFunction* compile(Compiler* compiler, Collector* collector, char* source, int optimizationLevel) {
     initCompiler(compiler);
-    initLexer(&compiler->lexer, source);
     compiler->collector = collector;
+    Ast ast;
+    initAst(&ast);
+    if (!parse(&compiler->parser, collector, source, &ast)) {
+        freeAst(&ast);
+        return NULL;
+    }
+    optimizeAst(&ast, collector, optimizationLevel);
+
     Scope startingScope;
     startingScope.enclosing = NULL;
-    initScope(compiler, &startingScope, NULL);
+    initScope(compiler, &startingScope, ast.main);
     compiler->scope = &startingScope;
-
-    advance(compiler);
-    statementList(compiler);
-    freeLexer(&compiler->lexer);
-    return !compiler->hadError ? popScope(compiler) : NULL;
+    for (int i = 0; i < ast.main->body.count; i++) {
+        statement(compiler, ast.main->body.nodes[i]);
+    }
+    ObjFunction* function = popScope(compiler);
+    freeAst(&ast);
+    return !compiler->hadError ? function : NULL;
 }
 
 void freeCompiler(Compiler* compiler) {
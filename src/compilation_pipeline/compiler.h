@@ -4,16 +4,17 @@
 #include "../datastructs/bytecode.h"
 #include "../memory.h"
 #include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "optimizer.h"
 #include "../datastructs/hash_map.h"
 
-#define MAX_LOCALS 700
 #define MAX_UPVALUES 700
 #define MAX_LOOP_SKIPS 700
 
 struct sLocal {
-    Token name;
+    Variable* variable;
     int depth;
-    int isCaptured;
 };
 
 struct sUpvalue {
@@ -37,6 +38,7 @@ typedef struct {
 
 struct sScope {
     struct sScope* enclosing;
+    FunctionNode* node;
     int depth;
     Local locals[MAX_LOCALS];
     int localsCount;
@@ -45,22 +47,22 @@ struct sScope {
     LoopSkip loopSkips[MAX_LOOP_SKIPS]; // loop skips are breaks and continues
     int loopSkipCount;
     int loopDepth;
+    int loopLocalsCount; // locals living outside of the innermost loop
+    HashMap constants; // constant => its address in the pool, so that equal constants share it
 };
 
 typedef struct sScope Scope;
 
 typedef struct {
-    Lexer lexer;
-    Token current;
-    Token previous;
+    Parser parser;
     Collector* collector;
     int hadError;
-    int panic;
+    int line; // line of the node being compiled
     Scope *scope;
 } Compiler;
 
 void initCompiler(Compiler* compiler);
-ObjFunction* compile(Compiler* compiler, Collector* collector, char* source);
+ObjFunction* compile(Compiler* compiler, Collector* collector, char* source, int optimizationLevel);
 void freeCompiler(Compiler* compiler);
 
 #endif
@@ -26,6 +26,10 @@ static Keyword keywords[] = {
     {"nihl", 4, TOK_NIHL},
     {"break", 5, TOK_BREAK},
     {"continue", 8, TOK_CONTINUE},
+    {"const", 5, TOK_CONST},
+    {"for", 3, TOK_FOR},
+    {"yield", 5, TOK_YIELD},
+    {"match", 5, TOK_MATCH},
     {NULL, 0, TOK_ERROR}
 };
 
@@ -311,6 +315,10 @@ Token nextToken(Lexer* lexer) {
         case '?':
             tok = makeToken(lexer, TOK_QUESTION_MARK);
             break;
+        case '.':
+            if (eat(lexer, '.'))
+                tok = makeToken(lexer, TOK_DOT_DOT);
+            break;
 
         case '!': 
             tok = makeToken(lexer, eat(lexer, '=') ? TOK_NOT_EQUAL : TOK_EXCLAMATION_MARK); 
@@ -30,6 +30,7 @@ typedef enum {
     TOK_GREATER_EQUAL,
     TOK_LESS,
     TOK_LESS_EQUAL,
+    TOK_DOT_DOT,
 
     // Literals
     TOK_IDENTIFIER,
@@ -53,6 +54,10 @@ typedef enum {
     TOK_NIHL,
     TOK_BREAK,
     TOK_CONTINUE,
+    TOK_CONST,
+    TOK_FOR,
+    TOK_YIELD,
+    TOK_MATCH,
 
     // special
     TOK_INDENT,
@@ -0,0 +1,2460 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "optimizer.h"
+#include "../datastructs/value.h"
+#include "../datastructs/value_operations.h"
+
+#define MAX_ROUNDS 8
+#define MAX_CSE_OCCURRENCES 256
+
+typedef struct {
+    Arena* arena;
+    Collector* collector;
+    int changed; // set by every rewrite, the basic passes run again until nothing changes
+} Optimizer;
+
+static Node* optimizeExpression(Optimizer* optimizer, Node* node);
+static Node* optimizeStatement(Optimizer* optimizer, Node* node);
+static void optimizeList(Optimizer* optimizer, NodeList* list);
+
+// counting
+
+static void countExpression(Node* node, FunctionNode* function);
+static void countList(NodeList* list, FunctionNode* function);
+static void countExpressions(NodeList* list, FunctionNode* function);
+
+static void resetVariable(Variable* variable) {
+    variable->reads = 0;
+    variable->writes = 0;
+    variable->isCaptured = 0;
+    variable->value = NULL;
+}
+
+static void countUse(Variable* variable, FunctionNode* function) {
+    if (variable->function != function)
+        variable->isCaptured = 1;
+}
+
+// reads, writes and captures of every local, recomputed after each rewrite of the tree
+static void countStatement(Node* node, FunctionNode* function) {
+    switch (node->type) {
+        case NODE_LET:
+            if (node->as.variable.variable != NULL)
+                resetVariable(node->as.variable.variable);
+            if (node->as.variable.value != NULL)
+                countExpression(node->as.variable.value, function);
+            break;
+        case NODE_BLOCK:
+            countList(&node->as.list, function);
+            break;
+        case NODE_IF:
+        case NODE_WHILE:
+            countExpression(node->as.branch.condition, function);
+            countStatement(node->as.branch.then, function);
+            if (node->as.branch.otherwise != NULL)
+                countStatement(node->as.branch.otherwise, function);
+            break;
+        case NODE_FOR_RANGE:
+        case NODE_FOR_EACH:
+            countExpression(node->as.loop.start, function);
+            if (node->as.loop.end != NULL)
+                countExpression(node->as.loop.end, function);
+            if (node->as.loop.step != NULL)
+                countExpression(node->as.loop.step, function);
+            resetVariable(node->as.loop.variable);
+            if (node->as.loop.key != NULL)
+                resetVariable(node->as.loop.key);
+            countStatement(node->as.loop.body, function);
+            break;
+        case NODE_MATCH:
+            countExpression(node->as.match.subject, function);
+            for (int i = 0; i < node->as.match.arms.count; i++) {
+                countStatement(node->as.match.arms.nodes[i]->as.arm.body, function);
+            }
+            if (node->as.match.otherwise != NULL)
+                countStatement(node->as.match.otherwise, function);
+            break;
+        case NODE_UNPACK:
+            countList(&node->as.unpack.targets, function);
+            countExpression(node->as.unpack.call, function);
+            break;
+        case NODE_EXPRESSION_STAT:
+        case NODE_PRINT:
+        case NODE_YIELD:
+            countExpression(node->as.expression, function);
+            break;
+        case NODE_RET:
+            countExpressions(&node->as.list, function);
+            break;
+        default:
+            break;
+    }
+}
+
+static void countList(NodeList* list, FunctionNode* function) {
+    for (int i = 0; i < list->count; i++) {
+        countStatement(list->nodes[i], function);
+    }
+}
+
+static void countExpressions(NodeList* list, FunctionNode* function) {
+    for (int i = 0; i < list->count; i++) {
+        countExpression(list->nodes[i], function);
+    }
+}
+
+static void countExpression(Node* node, FunctionNode* function) {
+    switch (node->type) {
+        case NODE_GLOBAL_SET:
+            countExpression(node->as.variable.value, function);
+            break;
+        case NODE_VARIABLE_GET:
+            node->as.variable.variable->reads++;
+            countUse(node->as.variable.variable, function);
+            break;
+        case NODE_VARIABLE_SET:
+            node->as.variable.variable->writes++;
+            countUse(node->as.variable.variable, function);
+            countExpression(node->as.variable.value, function);
+            break;
+        case NODE_INDEXING_GET:
+        case NODE_INDEXING_SET:
+            countExpression(node->as.indexing.object, function);
+            countExpression(node->as.indexing.key, function);
+            if (node->as.indexing.value != NULL)
+                countExpression(node->as.indexing.value, function);
+            break;
+        case NODE_CALL:
+            countExpression(node->as.call.callee, function);
+            countExpressions(&node->as.call.arguments, function);
+            break;
+        case NODE_UNARY:
+        case NODE_BINARY:
+            countExpression(node->as.operation.left, function);
+            if (node->as.operation.right != NULL)
+                countExpression(node->as.operation.right, function);
+            break;
+        case NODE_TERNARY:
+            countExpression(node->as.branch.condition, function);
+            countExpression(node->as.branch.then, function);
+            countExpression(node->as.branch.otherwise, function);
+            break;
+        case NODE_AND:
+        case NODE_OR:
+        case NODE_COMMA:
+        case NODE_ARRAY:
+        case NODE_DICT:
+            countExpressions(&node->as.list, function);
+            break;
+        case NODE_FUNCTION:
+            for (int i = 0; i < node->as.function->arity; i++) {
+                resetVariable(node->as.function->parameters[i]);
+            }
+            countList(&node->as.function->body, node->as.function);
+            break;
+        default:
+            break;
+    }
+}
+
+// expressions whose evaluation can neither fail nor be observed, so they can be dropped when unused
+static int isPure(Node* node) {
+    switch (node->type) {
+        case NODE_CONSTANT:
+        case NODE_VARIABLE_GET:
+        case NODE_FUNCTION:
+            return 1;
+        case NODE_UNARY:
+            return node->as.operation.operator == TOK_EXCLAMATION_MARK && isPure(node->as.operation.left);
+        case NODE_BINARY:
+            switch (node->as.operation.operator) {
+                case TOK_EQUAL_EQUAL:
+                case TOK_NOT_EQUAL:
+                case TOK_XOR:
+                    return isPure(node->as.operation.left) && isPure(node->as.operation.right);
+                default:
+                    return 0;
+            }
+        case NODE_TERNARY:
+            return isPure(node->as.branch.condition) && isPure(node->as.branch.then) && isPure(node->as.branch.otherwise);
+        case NODE_AND:
+        case NODE_OR:
+        case NODE_COMMA:
+        case NODE_ARRAY:
+        case NODE_DICT:
+            for (int i = 0; i < node->as.list.count; i++) {
+                if (!isPure(node->as.list.nodes[i]))
+                    return 0;
+            }
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int endsFlow(Node* node) {
+    return node->type == NODE_RET || node->type == NODE_BREAK || node->type == NODE_CONTINUE;
+}
+
+// unnamed local introduced by a pass
+static Variable* newTemporary(Optimizer* optimizer, FunctionNode* function, int line) {
+    Token name = {"", 0, TOK_IDENTIFIER, line};
+    return newVariable(optimizer->arena, name, function);
+}
+
+static Node* newVariableNode(Optimizer* optimizer, NodeType type, Variable* variable, Node* value, int line) {
+    Node* node = newNode(optimizer->arena, type, line);
+    node->as.variable.variable = variable;
+    node->as.variable.value = value;
+    return node;
+}
+
+// constant folding, with the same rules as the virtual machine: failing operations are left to it
+
+static int foldBinary(Optimizer* optimizer, TokenType operator, Value a, Value b, Value* result) {
+    switch (operator) {
+        case TOK_EQUAL_EQUAL: *result = to_vbool(valuesEqual(a, b)); return 1;
+        case TOK_NOT_EQUAL: *result = to_vbool(!valuesEqual(a, b)); return 1;
+        case TOK_XOR: *result = to_vbool(isTruthy(a) != isTruthy(b)); return 1;
+        case TOK_PLUS_PLUS:
+            if (!valuesConcatenable(a, b))
+                return 0;
+            ObjString* string = concatenateStringsSafe(optimizer->collector, as_string(a), as_string(b));
+            *result = to_vobj(internString(optimizer->collector, string));
+            return 1;
+    }
+    if (!valuesNumbers(a, b))
+        return 0;
+    double x = as_cnumber(a);
+    double y = as_cnumber(b);
+    switch (operator) {
+        case TOK_PLUS: *result = to_vnumber(x + y); return 1;
+        case TOK_MINUS: *result = to_vnumber(x - y); return 1;
+        case TOK_STAR: *result = to_vnumber(x * y); return 1;
+        case TOK_SLASH:
+            if (y == 0)
+                return 0;
+            *result = to_vnumber(x / y);
+            return 1;
+        case TOK_PERCENTAGE:
+            if (y == 0 || !valuesIntegers(a, b))
+                return 0;
+            *result = to_vnumber(((long) x) % ((long) y));
+            return 1;
+        case TOK_CIRCUMFLEX: *result = to_vnumber(pow(x, y)); return 1;
+        case TOK_LESS: *result = to_vbool(x < y); return 1;
+        case TOK_LESS_EQUAL: *result = to_vbool(x <= y); return 1;
+        case TOK_GREATER: *result = to_vbool(x > y); return 1;
+        case TOK_GREATER_EQUAL: *result = to_vbool(x >= y); return 1;
+    }
+    return 0;
+}
+
+static Node* foldBinaryNode(Optimizer* optimizer, Node* node) {
+    Node* left = node->as.operation.left;
+    Node* right = node->as.operation.right;
+    Value result;
+    if (node_is_constant(left) && node_is_constant(right)
+            && foldBinary(optimizer, node->as.operation.operator, left->as.constant, right->as.constant, &result)) {
+        optimizer->changed = 1;
+        return newConstantNode(optimizer->arena, result, node->line);
+    }
+    // [a, b] ++ [c] becomes the single literal [a, b, c]: elements are still evaluated once per execution
+    if (node->as.operation.operator == TOK_PLUS_PLUS && left->type == NODE_ARRAY && right->type == NODE_ARRAY
+            && left->as.list.count + right->as.list.count <= UINT16_MAX) {
+        for (int i = 0; i < right->as.list.count; i++) {
+            nodeListAdd(optimizer->arena, &left->as.list, right->as.list.nodes[i]);
+        }
+        optimizer->changed = 1;
+        return left;
+    }
+    return node;
+}
+
+static Node* foldUnaryNode(Optimizer* optimizer, Node* node) {
+    Node* operand = node->as.operation.left;
+    if (!node_is_constant(operand))
+        return node;
+    Value value = operand->as.constant;
+    if (node->as.operation.operator == TOK_EXCLAMATION_MARK) {
+        optimizer->changed = 1;
+        return newConstantNode(optimizer->arena, to_vbool(!isTruthy(value)), node->line);
+    }
+    if (node->as.operation.operator == TOK_MINUS && is_number(value)) {
+        optimizer->changed = 1;
+        return newConstantNode(optimizer->arena, to_vnumber(-as_cnumber(value)), node->line);
+    }
+    return node;
+}
+
+// value of an expression only made of constants, 0 when it is not one or evaluating it would fail
+int foldConstant(Collector* collector, Node* node, Value* result) {
+    Optimizer optimizer;
+    optimizer.arena = NULL;
+    optimizer.collector = collector;
+    Value a, b;
+    switch (node->type) {
+        case NODE_CONSTANT:
+            *result = node->as.constant;
+            return 1;
+        case NODE_UNARY:
+            if (!foldConstant(collector, node->as.operation.left, &a))
+                return 0;
+            if (node->as.operation.operator == TOK_EXCLAMATION_MARK) {
+                *result = to_vbool(!isTruthy(a));
+                return 1;
+            }
+            if (!is_number(a))
+                return 0;
+            *result = to_vnumber(-as_cnumber(a));
+            return 1;
+        case NODE_BINARY:
+            return foldConstant(collector, node->as.operation.left, &a)
+                && foldConstant(collector, node->as.operation.right, &b)
+                && foldBinary(&optimizer, node->as.operation.operator, a, b, result);
+        case NODE_TERNARY:
+            if (!foldConstant(collector, node->as.branch.condition, &a))
+                return 0;
+            return foldConstant(collector, isTruthy(a) ? node->as.branch.then : node->as.branch.otherwise, result);
+        case NODE_AND:
+        case NODE_OR:
+            // the first operand deciding the result is its value
+            for (int i = 0; i < node->as.list.count; i++) {
+                if (!foldConstant(collector, node->as.list.nodes[i], result))
+                    return 0;
+                if (isTruthy(*result) == (node->type == NODE_OR))
+                    return 1;
+            }
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// constant operands deciding an and/or cut the following ones, the other constant operands are skipped
+static Node* foldShortCircuit(Optimizer* optimizer, Node* node) {
+    int stopWhenTruthy = node->type == NODE_OR;
+    NodeList* operands = &node->as.list;
+    int count = 0;
+    for (int i = 0; i < operands->count; i++) {
+        Node* operand = optimizeExpression(optimizer, operands->nodes[i]);
+        int last = i == operands->count - 1;
+        if (node_is_constant(operand) && isTruthy(operand->as.constant) == stopWhenTruthy) {
+            operands->nodes[count++] = operand;
+            if (!last)
+                optimizer->changed = 1;
+            break;
+        }
+        if (node_is_constant(operand) && !last) {
+            optimizer->changed = 1;
+            continue;
+        }
+        operands->nodes[count++] = operand;
+    }
+    operands->count = count;
+    if (count == 1)
+        return operands->nodes[0];
+    return node;
+}
+
+// copy propagation and unused locals
+
+static Node* copyValue(Optimizer* optimizer, Node* value, int line) {
+    if (node_is_constant(value))
+        return newConstantNode(optimizer->arena, value->as.constant, line);
+    Node* copy = newNode(optimizer->arena, NODE_VARIABLE_GET, line);
+    copy->as.variable.variable = value->as.variable.variable;
+    return copy;
+}
+
+static int isLocal(Variable* variable) {
+    return variable != NULL && !variable->isParameter;
+}
+
+static int isUnusedLocal(Variable* variable) {
+    return isLocal(variable) && variable->reads == 0;
+}
+
+// a local never reassigned after its initialization always holds it: constants and other such locals are copied
+static void recordValue(Optimizer* optimizer, Node* let) {
+    Variable* variable = let->as.variable.variable;
+    Node* value = let->as.variable.value;
+    if (!isLocal(variable) || variable->writes > 0)
+        return;
+    if (value == NULL)
+        variable->value = newConstantNode(optimizer->arena, to_vnihl(), let->line);
+    else if (node_is_constant(value))
+        variable->value = value;
+    else if (value->type == NODE_VARIABLE_GET && value->as.variable.variable->writes == 0)
+        variable->value = value;
+}
+
+static void optimizeExpressions(Optimizer* optimizer, NodeList* list) {
+    for (int i = 0; i < list->count; i++) {
+        list->nodes[i] = optimizeExpression(optimizer, list->nodes[i]);
+    }
+}
+
+static Node* optimizeExpression(Optimizer* optimizer, Node* node) {
+    switch (node->type) {
+        case NODE_GLOBAL_SET:
+            node->as.variable.value = optimizeExpression(optimizer, node->as.variable.value);
+            return node;
+        case NODE_VARIABLE_GET:
+            if (node->as.variable.variable->value != NULL) {
+                optimizer->changed = 1;
+                return copyValue(optimizer, node->as.variable.variable->value, node->line);
+            }
+            return node;
+        case NODE_VARIABLE_SET:
+            node->as.variable.value = optimizeExpression(optimizer, node->as.variable.value);
+            if (isUnusedLocal(node->as.variable.variable)) {
+                optimizer->changed = 1;
+                return node->as.variable.value;
+            }
+            return node;
+        case NODE_INDEXING_GET:
+        case NODE_INDEXING_SET:
+            node->as.indexing.object = optimizeExpression(optimizer, node->as.indexing.object);
+            node->as.indexing.key = optimizeExpression(optimizer, node->as.indexing.key);
+            if (node->as.indexing.value != NULL)
+                node->as.indexing.value = optimizeExpression(optimizer, node->as.indexing.value);
+            return node;
+        case NODE_CALL:
+            node->as.call.callee = optimizeExpression(optimizer, node->as.call.callee);
+            optimizeExpressions(optimizer, &node->as.call.arguments);
+            return node;
+        case NODE_UNARY:
+            node->as.operation.left = optimizeExpression(optimizer, node->as.operation.left);
+            return foldUnaryNode(optimizer, node);
+        case NODE_BINARY:
+            node->as.operation.left = optimizeExpression(optimizer, node->as.operation.left);
+            node->as.operation.right = optimizeExpression(optimizer, node->as.operation.right);
+            return foldBinaryNode(optimizer, node);
+        case NODE_AND:
+        case NODE_OR:
+            return foldShortCircuit(optimizer, node);
+        case NODE_TERNARY:
+            node->as.branch.condition = optimizeExpression(optimizer, node->as.branch.condition);
+            node->as.branch.then = optimizeExpression(optimizer, node->as.branch.then);
+            node->as.branch.otherwise = optimizeExpression(optimizer, node->as.branch.otherwise);
+            if (node_is_constant(node->as.branch.condition)) {
+                optimizer->changed = 1;
+                return isTruthy(node->as.branch.condition->as.constant) ? node->as.branch.then : node->as.branch.otherwise;
+            }
+            return node;
+        case NODE_COMMA:
+            {
+                NodeList* list = &node->as.list;
+                int count = 0;
+                for (int i = 0; i < list->count; i++) {
+                    Node* element = optimizeExpression(optimizer, list->nodes[i]);
+                    if (i < list->count - 1 && isPure(element)) {
+                        optimizer->changed = 1;
+                        continue;
+                    }
+                    list->nodes[count++] = element;
+                }
+                list->count = count;
+                return count == 1 ? list->nodes[0] : node;
+            }
+        case NODE_ARRAY:
+        case NODE_DICT:
+            optimizeExpressions(optimizer, &node->as.list);
+            return node;
+        case NODE_FUNCTION:
+            optimizeList(optimizer, &node->as.function->body);
+            return node;
+        default:
+            return node;
+    }
+}
+
+// the body of the arm of a match running for subject, NULL if none does
+static Node* matchingArm(Node* node, Value subject) {
+    for (int i = 0; i < node->as.match.arms.count; i++) {
+        Node* arm = node->as.match.arms.nodes[i];
+        for (int j = 0; j < arm->as.arm.values.count; j++) {
+            if (valuesEqual(arm->as.arm.values.nodes[j]->as.constant, subject))
+                return arm->as.arm.body;
+        }
+    }
+    return node->as.match.otherwise;
+}
+
+// branches of ifs and whiles cannot be removed: an empty block takes their place
+static Node* optimizeBranch(Optimizer* optimizer, Node* node) {
+    Node* result = optimizeStatement(optimizer, node);
+    if (result == NULL)
+        return newNode(optimizer->arena, NODE_BLOCK, node->line);
+    return result;
+}
+
+// returns the statement replacing node, NULL when it can be removed
+static Node* optimizeStatement(Optimizer* optimizer, Node* node) {
+    switch (node->type) {
+        case NODE_EXPRESSION_STAT:
+            node->as.expression = optimizeExpression(optimizer, node->as.expression);
+            if (isPure(node->as.expression)) {
+                optimizer->changed = 1;
+                return NULL;
+            }
+            return node;
+        case NODE_PRINT:
+        case NODE_YIELD:
+            node->as.expression = optimizeExpression(optimizer, node->as.expression);
+            return node;
+        case NODE_LET:
+            if (node->as.variable.value != NULL)
+                node->as.variable.value = optimizeExpression(optimizer, node->as.variable.value);
+            if (!isUnusedLocal(node->as.variable.variable)) {
+                recordValue(optimizer, node);
+                return node;
+            }
+            optimizer->changed = 1;
+            if (node->as.variable.value == NULL || isPure(node->as.variable.value))
+                return NULL;
+            node->type = NODE_EXPRESSION_STAT;
+            node->as.expression = node->as.variable.value;
+            return node;
+        case NODE_BLOCK:
+            optimizeList(optimizer, &node->as.list);
+            if (node->as.list.count == 0)
+                return NULL;
+            return node;
+        case NODE_IF:
+            node->as.branch.condition = optimizeExpression(optimizer, node->as.branch.condition);
+            node->as.branch.then = optimizeBranch(optimizer, node->as.branch.then);
+            if (node->as.branch.otherwise != NULL)
+                node->as.branch.otherwise = optimizeStatement(optimizer, node->as.branch.otherwise);
+            if (node_is_constant(node->as.branch.condition)) {
+                optimizer->changed = 1;
+                return isTruthy(node->as.branch.condition->as.constant) ? node->as.branch.then : node->as.branch.otherwise;
+            }
+            if (node->as.branch.then->as.list.count == 0 && node->as.branch.otherwise == NULL) {
+                optimizer->changed = 1;
+                node->type = NODE_EXPRESSION_STAT;
+                node->as.expression = node->as.branch.condition;
+            }
+            return node;
+        case NODE_WHILE:
+            node->as.branch.condition = optimizeExpression(optimizer, node->as.branch.condition);
+            if (node_is_constant(node->as.branch.condition) && !isTruthy(node->as.branch.condition->as.constant)) {
+                optimizer->changed = 1;
+                return NULL;
+            }
+            node->as.branch.then = optimizeBranch(optimizer, node->as.branch.then);
+            return node;
+        case NODE_FOR_RANGE:
+        case NODE_FOR_EACH:
+            // the header is checked even when the body does nothing
+            node->as.loop.start = optimizeExpression(optimizer, node->as.loop.start);
+            if (node->as.loop.end != NULL)
+                node->as.loop.end = optimizeExpression(optimizer, node->as.loop.end);
+            if (node->as.loop.step != NULL)
+                node->as.loop.step = optimizeExpression(optimizer, node->as.loop.step);
+            node->as.loop.body = optimizeBranch(optimizer, node->as.loop.body);
+            return node;
+        case NODE_MATCH:
+            node->as.match.subject = optimizeExpression(optimizer, node->as.match.subject);
+            for (int i = 0; i < node->as.match.arms.count; i++) {
+                Node* arm = node->as.match.arms.nodes[i];
+                arm->as.arm.body = optimizeBranch(optimizer, arm->as.arm.body);
+            }
+            if (node->as.match.otherwise != NULL)
+                node->as.match.otherwise = optimizeStatement(optimizer, node->as.match.otherwise);
+            if (node_is_constant(node->as.match.subject)) {
+                optimizer->changed = 1;
+                return matchingArm(node, node->as.match.subject->as.constant);
+            }
+            return node;
+        case NODE_UNPACK:
+            // every variable takes a value, used or not
+            node->as.unpack.call = optimizeExpression(optimizer, node->as.unpack.call);
+            return node;
+        case NODE_RET:
+            optimizeExpressions(optimizer, &node->as.list);
+            return node;
+        default:
+            return node;
+    }
+}
+
+// statements following a ret, break or continue are never reached
+static void optimizeList(Optimizer* optimizer, NodeList* list) {
+    int count = 0;
+    for (int i = 0; i < list->count; i++) {
+        Node* statement = optimizeStatement(optimizer, list->nodes[i]);
+        if (statement == NULL)
+            continue;
+        list->nodes[count++] = statement;
+        if (endsFlow(statement)) {
+            if (i < list->count - 1)
+                optimizer->changed = 1;
+            break;
+        }
+    }
+    list->count = count;
+}
+
+// common subexpression elimination: inside a list of statements, an arithmetic expression over constants and
+// never reassigned locals repeated where it is always evaluated is computed once into a local, assigned by its
+// first occurrence so that failing operations still fail there
+
+typedef struct {
+    Node** slot;
+    int statement; // index of the statement evaluating it inside the list
+    int first; // index of the first equal occurrence
+    int parent; // index of the occurrence containing it, -1 if none
+    int eliminated; // replaced by a read of the local
+} Occurrence;
+
+typedef struct {
+    Occurrence occurrences[MAX_CSE_OCCURRENCES];
+    int count;
+} Occurrences;
+
+static void eliminateList(Optimizer* optimizer, NodeList* list, FunctionNode* function);
+
+static int isCseOperand(Node* node);
+
+static int isCseOperation(Node* node) {
+    if (node->type == NODE_UNARY)
+        return node->as.operation.operator == TOK_MINUS && isCseOperand(node->as.operation.left);
+    if (node->type != NODE_BINARY || node->as.operation.operator == TOK_PLUS_PLUS)
+        return 0;
+    return isCseOperand(node->as.operation.left) && isCseOperand(node->as.operation.right);
+}
+
+static int isCseOperand(Node* node) {
+    switch (node->type) {
+        case NODE_CONSTANT: return !is_obj(node->as.constant);
+        case NODE_VARIABLE_GET: return node->as.variable.variable->writes == 0;
+        default: return isCseOperation(node);
+    }
+}
+
+static int nodesEqual(Node* a, Node* b) {
+    if (a->type != b->type)
+        return 0;
+    switch (a->type) {
+        case NODE_CONSTANT:
+            return memcmp(&a->as.constant, &b->as.constant, sizeof(Value)) == 0;
+        case NODE_VARIABLE_GET:
+            return a->as.variable.variable == b->as.variable.variable;
+        case NODE_UNARY:
+            return a->as.operation.operator == b->as.operation.operator
+                && nodesEqual(a->as.operation.left, b->as.operation.left);
+        case NODE_BINARY:
+            return a->as.operation.operator == b->as.operation.operator
+                && nodesEqual(a->as.operation.left, b->as.operation.left)
+                && nodesEqual(a->as.operation.right, b->as.operation.right);
+        default:
+            return 0;
+    }
+}
+
+static void collectOccurrences(Occurrences* occurrences, Node** slot, int statement);
+
+static void collectList(Occurrences* occurrences, NodeList* list, int statement) {
+    for (int i = 0; i < list->count; i++) {
+        collectOccurrences(occurrences, &list->nodes[i], statement);
+    }
+}
+
+// occurrences are recorded outermost first, nested operations included
+static void addOccurrence(Occurrences* occurrences, Node** slot, int statement, int parent) {
+    if (occurrences->count >= MAX_CSE_OCCURRENCES)
+        return;
+    Node* node = *slot;
+    int index = occurrences->count++;
+    Occurrence* occurrence = &occurrences->occurrences[index];
+    occurrence->slot = slot;
+    occurrence->statement = statement;
+    occurrence->first = index;
+    occurrence->parent = parent;
+    occurrence->eliminated = 0;
+    for (int i = 0; i < index; i++) {
+        if (nodesEqual(*occurrences->occurrences[i].slot, node)) {
+            occurrence->first = occurrences->occurrences[i].first;
+            break;
+        }
+    }
+    if (isCseOperation(node->as.operation.left))
+        addOccurrence(occurrences, &node->as.operation.left, statement, index);
+    if (node->as.operation.right != NULL && isCseOperation(node->as.operation.right))
+        addOccurrence(occurrences, &node->as.operation.right, statement, index);
+}
+
+// only subexpressions evaluated each time their statement runs are collected
+static void collectOccurrences(Occurrences* occurrences, Node** slot, int statement) {
+    Node* node = *slot;
+    if (isCseOperation(node)) {
+        addOccurrence(occurrences, slot, statement, -1);
+        return;
+    }
+    switch (node->type) {
+        case NODE_GLOBAL_SET:
+        case NODE_VARIABLE_SET:
+            collectOccurrences(occurrences, &node->as.variable.value, statement);
+            break;
+        case NODE_INDEXING_GET:
+        case NODE_INDEXING_SET:
+            collectOccurrences(occurrences, &node->as.indexing.object, statement);
+            collectOccurrences(occurrences, &node->as.indexing.key, statement);
+            if (node->as.indexing.value != NULL)
+                collectOccurrences(occurrences, &node->as.indexing.value, statement);
+            break;
+        case NODE_CALL:
+            collectOccurrences(occurrences, &node->as.call.callee, statement);
+            collectList(occurrences, &node->as.call.arguments, statement);
+            break;
+        case NODE_UNARY:
+        case NODE_BINARY:
+            collectOccurrences(occurrences, &node->as.operation.left, statement);
+            if (node->as.operation.right != NULL)
+                collectOccurrences(occurrences, &node->as.operation.right, statement);
+            break;
+        case NODE_AND:
+        case NODE_OR:
+            collectOccurrences(occurrences, &node->as.list.nodes[0], statement);
+            break;
+        case NODE_TERNARY:
+            collectOccurrences(occurrences, &node->as.branch.condition, statement);
+            break;
+        case NODE_COMMA:
+        case NODE_ARRAY:
+        case NODE_DICT:
+            collectList(occurrences, &node->as.list, statement);
+            break;
+        default:
+            break;
+    }
+}
+
+// branches are not always evaluated: each block is a list on its own, elif conditions are left alone
+static void eliminateBranch(Optimizer* optimizer, Node* node, FunctionNode* function) {
+    if (node->type == NODE_BLOCK) {
+        eliminateList(optimizer, &node->as.list, function);
+    } else if (node->type == NODE_IF) {
+        eliminateBranch(optimizer, node->as.branch.then, function);
+        if (node->as.branch.otherwise != NULL)
+            eliminateBranch(optimizer, node->as.branch.otherwise, function);
+    }
+}
+
+static void eliminateStatement(Optimizer* optimizer, Occurrences* occurrences, Node* node, int index, FunctionNode* function) {
+    switch (node->type) {
+        case NODE_EXPRESSION_STAT:
+        case NODE_PRINT:
+        case NODE_YIELD:
+            collectOccurrences(occurrences, &node->as.expression, index);
+            break;
+        case NODE_RET:
+            collectList(occurrences, &node->as.list, index);
+            break;
+        case NODE_UNPACK:
+            collectOccurrences(occurrences, &node->as.unpack.call, index);
+            break;
+        case NODE_LET:
+            if (node->as.variable.value != NULL)
+                collectOccurrences(occurrences, &node->as.variable.value, index);
+            break;
+        case NODE_BLOCK:
+            eliminateList(optimizer, &node->as.list, function);
+            break;
+        case NODE_IF:
+        case NODE_WHILE:
+            collectOccurrences(occurrences, &node->as.branch.condition, index);
+            eliminateBranch(optimizer, node->as.branch.then, function);
+            if (node->as.branch.otherwise != NULL)
+                eliminateBranch(optimizer, node->as.branch.otherwise, function);
+            break;
+        case NODE_FOR_RANGE:
+        case NODE_FOR_EACH:
+            collectOccurrences(occurrences, &node->as.loop.start, index);
+            if (node->as.loop.end != NULL)
+                collectOccurrences(occurrences, &node->as.loop.end, index);
+            if (node->as.loop.step != NULL)
+                collectOccurrences(occurrences, &node->as.loop.step, index);
+            eliminateBranch(optimizer, node->as.loop.body, function);
+            break;
+        case NODE_MATCH:
+            collectOccurrences(occurrences, &node->as.match.subject, index);
+            for (int i = 0; i < node->as.match.arms.count; i++) {
+                eliminateBranch(optimizer, node->as.match.arms.nodes[i]->as.arm.body, function);
+            }
+            if (node->as.match.otherwise != NULL)
+                eliminateBranch(optimizer, node->as.match.otherwise, function);
+            break;
+        default:
+            break;
+    }
+}
+
+static int insideEliminated(Occurrences* occurrences, int index) {
+    for (int i = occurrences->occurrences[index].parent; i >= 0; i = occurrences->occurrences[i].parent) {
+        if (occurrences->occurrences[i].eliminated)
+            return 1;
+    }
+    return 0;
+}
+
+// a never reassigned local initialized with the whole expression already holds it
+static Variable* initializedLocal(NodeList* list, Occurrence* occurrence) {
+    Node* statement = list->nodes[occurrence->statement];
+    if (statement->type != NODE_LET || &statement->as.variable.value != occurrence->slot)
+        return NULL;
+    Variable* variable = statement->as.variable.variable;
+    if (!isLocal(variable) || variable->writes > 0)
+        return NULL;
+    return variable;
+}
+
+static void eliminateList(Optimizer* optimizer, NodeList* list, FunctionNode* function) {
+    Occurrences occurrences;
+    occurrences.count = 0;
+    for (int i = 0; i < list->count; i++) {
+        eliminateStatement(optimizer, &occurrences, list->nodes[i], i, function);
+    }
+
+    // outer expressions come first: the occurrences nested inside the ones replaced by a read disappear with them
+    Node* temporaries[MAX_CSE_OCCURRENCES];
+    int temporariesStatements[MAX_CSE_OCCURRENCES];
+    int temporariesCount = 0;
+    for (int i = 0; i < occurrences.count; i++) {
+        if (occurrences.occurrences[i].first != i)
+            continue;
+        Occurrence* first = NULL;
+        Variable* local = NULL;
+        for (int j = i; j < occurrences.count; j++) {
+            Occurrence* repeated = &occurrences.occurrences[j];
+            if (repeated->first != i || insideEliminated(&occurrences, j))
+                continue;
+            if (first == NULL) {
+                first = repeated;
+                continue;
+            }
+            if (local == NULL) {
+                local = initializedLocal(list, first);
+                if (local == NULL) {
+                    int line = (*first->slot)->line;
+                    local = newTemporary(optimizer, function, line);
+                    local->writes = 1;
+                    *first->slot = newVariableNode(optimizer, NODE_VARIABLE_SET, local, *first->slot, line);
+                    temporaries[temporariesCount] = newVariableNode(optimizer, NODE_LET, local, NULL, line);
+                    temporariesStatements[temporariesCount] = first->statement;
+                    temporariesCount++;
+                }
+            }
+            *repeated->slot = newVariableNode(optimizer, NODE_VARIABLE_GET, local, NULL, (*repeated->slot)->line);
+            repeated->eliminated = 1;
+        }
+    }
+    if (temporariesCount == 0)
+        return;
+    for (int i = 1; i < temporariesCount; i++) {
+        for (int j = i; j > 0 && temporariesStatements[j - 1] > temporariesStatements[j]; j--) {
+            int statement = temporariesStatements[j];
+            Node* temporary = temporaries[j];
+            temporariesStatements[j] = temporariesStatements[j - 1];
+            temporaries[j] = temporaries[j - 1];
+            temporariesStatements[j - 1] = statement;
+            temporaries[j - 1] = temporary;
+        }
+    }
+
+    NodeList statements;
+    initNodeList(&statements);
+    int next = 0;
+    for (int i = 0; i < list->count; i++) {
+        while (next < temporariesCount && temporariesStatements[next] == i) {
+            nodeListAdd(optimizer->arena, &statements, temporaries[next++]);
+        }
+        nodeListAdd(optimizer->arena, &statements, list->nodes[i]);
+    }
+    *list = statements;
+}
+
+// functions are only reached through expressions: every function body is a list on its own
+static void eliminateFunctions(Optimizer* optimizer, Node* node);
+
+static void eliminateFunctionsIn(Optimizer* optimizer, NodeList* list) {
+    for (int i = 0; i < list->count; i++) {
+        eliminateFunctions(optimizer, list->nodes[i]);
+    }
+}
+
+static void eliminateFunctions(Optimizer* optimizer, Node* node) {
+    switch (node->type) {
+        case NODE_FUNCTION:
+            eliminateList(optimizer, &node->as.function->body, node->as.function);
+            eliminateFunctionsIn(optimizer, &node->as.function->body);
+            break;
+        case NODE_GLOBAL_SET:
+        case NODE_VARIABLE_SET:
+        case NODE_LET:
+            if (node->as.variable.value != NULL)
+                eliminateFunctions(optimizer, node->as.variable.value);
+            break;
+        case NODE_INDEXING_GET:
+        case NODE_INDEXING_SET:
+            eliminateFunctions(optimizer, node->as.indexing.object);
+            eliminateFunctions(optimizer, node->as.indexing.key);
+            if (node->as.indexing.value != NULL)
+                eliminateFunctions(optimizer, node->as.indexing.value);
+            break;
+        case NODE_CALL:
+            eliminateFunctions(optimizer, node->as.call.callee);
+            eliminateFunctionsIn(optimizer, &node->as.call.arguments);
+            break;
+        case NODE_UNARY:
+        case NODE_BINARY:
+            eliminateFunctions(optimizer, node->as.operation.left);
+            if (node->as.operation.right != NULL)
+                eliminateFunctions(optimizer, node->as.operation.right);
+            break;
+        case NODE_TERNARY:
+        case NODE_IF:
+        case NODE_WHILE:
+            eliminateFunctions(optimizer, node->as.branch.condition);
+            eliminateFunctions(optimizer, node->as.branch.then);
+            if (node->as.branch.otherwise != NULL)
+                eliminateFunctions(optimizer, node->as.branch.otherwise);
+            break;
+        case NODE_FOR_RANGE:
+        case NODE_FOR_EACH:
+            eliminateFunctions(optimizer, node->as.loop.start);
+            if (node->as.loop.end != NULL)
+                eliminateFunctions(optimizer, node->as.loop.end);
+            if (node->as.loop.step != NULL)
+                eliminateFunctions(optimizer, node->as.loop.step);
+            eliminateFunctions(optimizer, node->as.loop.body);
+            break;
+        case NODE_MATCH:
+            eliminateFunctions(optimizer, node->as.match.subject);
+            for (int i = 0; i < node->as.match.arms.count; i++) {
+                eliminateFunctions(optimizer, node->as.match.arms.nodes[i]->as.arm.body);
+            }
+            if (node->as.match.otherwise != NULL)
+                eliminateFunctions(optimizer, node->as.match.otherwise);
+            break;
+        case NODE_AND:
+        case NODE_OR:
+        case NODE_COMMA:
+        case NODE_ARRAY:
+        case NODE_DICT:
+        case NODE_BLOCK:
+        case NODE_RET:
+            eliminateFunctionsIn(optimizer, &node->as.list);
+            break;
+        case NODE_UNPACK:
+            eliminateFunctions(optimizer, node->as.unpack.call);
+            break;
+        case NODE_EXPRESSION_STAT:
+        case NODE_PRINT:
+        case NODE_YIELD:
+            eliminateFunctions(optimizer, node->as.expression);
+            break;
+        default:
+            break;
+    }
+}
+
+// generic traversal
+
+typedef void (*NodeVisitor)(Node** slot, void* data);
+
+static void visitList(NodeList* list, NodeVisitor visit, void* data) {
+    for (int i = 0; i < list->count; i++) {
+        visit(&list->nodes[i], data);
+    }
+}
+
+// calls visit on the slot of every direct child of node, statements of function bodies included
+static void visitChildren(Node* node, NodeVisitor visit, void* data) {
+    switch (node->type) {
+        case NODE_GLOBAL_SET:
+        case NODE_VARIABLE_SET:
+        case NODE_LET:
+            if (node->as.variable.value != NULL)
+                visit(&node->as.variable.value, data);
+            break;
+        case NODE_INDEXING_GET:
+        case NODE_INDEXING_SET:
+            visit(&node->as.indexing.object, data);
+            visit(&node->as.indexing.key, data);
+            if (node->as.indexing.value != NULL)
+                visit(&node->as.indexing.value, data);
+            break;
+        case NODE_CALL:
+            visit(&node->as.call.callee, data);
+            visitList(&node->as.call.arguments, visit, data);
+            break;
+        case NODE_UNARY:
+        case NODE_BINARY:
+            visit(&node->as.operation.left, data);
+            if (node->as.operation.right != NULL)
+                visit(&node->as.operation.right, data);
+            break;
+        case NODE_TERNARY:
+        case NODE_IF:
+        case NODE_WHILE:
+            visit(&node->as.branch.condition, data);
+            visit(&node->as.branch.then, data);
+            if (node->as.branch.otherwise != NULL)
+                visit(&node->as.branch.otherwise, data);
+            break;
+        case NODE_FOR_RANGE:
+        case NODE_FOR_EACH:
+            visit(&node->as.loop.start, data);
+            if (node->as.loop.end != NULL)
+                visit(&node->as.loop.end, data);
+            if (node->as.loop.step != NULL)
+                visit(&node->as.loop.step, data);
+            visit(&node->as.loop.body, data);
+            break;
+        case NODE_MATCH:
+            // case values are constants, only the bodies of the arms are visited
+            visit(&node->as.match.subject, data);
+            for (int i = 0; i < node->as.match.arms.count; i++) {
+                visit(&node->as.match.arms.nodes[i]->as.arm.body, data);
+            }
+            if (node->as.match.otherwise != NULL)
+                visit(&node->as.match.otherwise, data);
+            break;
+        case NODE_AND:
+        case NODE_OR:
+        case NODE_COMMA:
+        case NODE_ARRAY:
+        case NODE_DICT:
+        case NODE_BLOCK:
+        case NODE_RET:
+            visitList(&node->as.list, visit, data);
+            break;
+        case NODE_FUNCTION:
+            visitList(&node->as.function->body, visit, data);
+            break;
+        case NODE_UNPACK:
+            visitList(&node->as.unpack.targets, visit, data);
+            visit(&node->as.unpack.call, data);
+            break;
+        case NODE_EXPRESSION_STAT:
+        case NODE_PRINT:
+        case NODE_YIELD:
+            visit(&node->as.expression, data);
+            break;
+        default:
+            break;
+    }
+}
+
+// locals of a copied expression can be replaced: by another local, or by a value when never assigned
+typedef struct {
+    Variable* from;
+    Variable* to;
+    Node* value;
+} Binding;
+
+typedef struct {
+    Binding* bindings;
+    int count;
+} Bindings;
+
+static Binding* findBinding(Bindings* bindings, Variable* variable) {
+    if (bindings == NULL)
+        return NULL;
+    for (int i = 0; i < bindings->count; i++) {
+        if (bindings->bindings[i].from == variable)
+            return &bindings->bindings[i];
+    }
+    return NULL;
+}
+
+static Node* copyExpression(Arena* arena, Node* node, Bindings* bindings);
+
+static void copyExpressions(Arena* arena, NodeList* to, NodeList* from, Bindings* bindings) {
+    initNodeList(to);
+    for (int i = 0; i < from->count; i++) {
+        nodeListAdd(arena, to, copyExpression(arena, from->nodes[i], bindings));
+    }
+}
+
+// deep copy of an expression, function literals excluded
+static Node* copyExpression(Arena* arena, Node* node, Bindings* bindings) {
+    Node* copy = newNode(arena, node->type, node->line);
+    copy->as = node->as;
+    switch (node->type) {
+        case NODE_VARIABLE_GET:
+        case NODE_VARIABLE_SET:
+            {
+                Binding* binding = findBinding(bindings, node->as.variable.variable);
+                if (binding != NULL && binding->value != NULL)
+                    return copyExpression(arena, binding->value, NULL);
+                if (binding != NULL)
+                    copy->as.variable.variable = binding->to;
+                if (node->type == NODE_VARIABLE_SET)
+                    copy->as.variable.value = copyExpression(arena, node->as.variable.value, bindings);
+                break;
+            }
+        case NODE_GLOBAL_SET:
+            copy->as.variable.value = copyExpression(arena, node->as.variable.value, bindings);
+            break;
+        case NODE_INDEXING_GET:
+        case NODE_INDEXING_SET:
+            copy->as.indexing.object = copyExpression(arena, node->as.indexing.object, bindings);
+            copy->as.indexing.key = copyExpression(arena, node->as.indexing.key, bindings);
+            if (node->as.indexing.value != NULL)
+                copy->as.indexing.value = copyExpression(arena, node->as.indexing.value, bindings);
+            break;
+        case NODE_UNARY:
+        case NODE_BINARY:
+            copy->as.operation.left = copyExpression(arena, node->as.operation.left, bindings);
+            if (node->as.operation.right != NULL)
+                copy->as.operation.right = copyExpression(arena, node->as.operation.right, bindings);
+            break;
+        case NODE_CALL:
+            copy->as.call.callee = copyExpression(arena, node->as.call.callee, bindings);
+            copyExpressions(arena, &copy->as.call.arguments, &node->as.call.arguments, bindings);
+            break;
+        case NODE_TERNARY:
+            copy->as.branch.condition = copyExpression(arena, node->as.branch.condition, bindings);
+            copy->as.branch.then = copyExpression(arena, node->as.branch.then, bindings);
+            copy->as.branch.otherwise = copyExpression(arena, node->as.branch.otherwise, bindings);
+            break;
+        case NODE_AND:
+        case NODE_OR:
+        case NODE_COMMA:
+        case NODE_ARRAY:
+        case NODE_DICT:
+            copyExpressions(arena, &copy->as.list, &node->as.list, bindings);
+            break;
+        default:
+            break;
+    }
+    return copy;
+}
+
+// loop invariant code motion: expressions of a while loop over values it never changes are computed once
+// before it. Only the ones evaluated before anything which could fail or be observed in the first iteration
+// are moved, so runtime errors and output keep their order
+
+#define MAX_LOOP_WRITES 256
+
+// natives whose result only depends on their argument, called directly while their global is never reassigned
+typedef struct {
+    char* name;
+    int readsContent; // the result changes when calls modify the argument
+} Intrinsic;
+
+static Intrinsic intrinsics[] = {
+    {"len", 0}, // arrays and strings never change length in place
+    {"typeof", 0},
+    {"typeofobj", 0},
+    {"buflen", 1},
+};
+
+#define INTRINSICS_COUNT ((int) (sizeof(intrinsics) / sizeof(Intrinsic)))
+
+typedef struct {
+    Optimizer* optimizer;
+    FunctionNode* function;
+    int reassigned[INTRINSICS_COUNT];
+    // effects of the loop being optimized
+    Variable* variables[MAX_LOOP_WRITES]; // locals assigned or declared inside it
+    int variablesCount;
+    ObjString* globals[MAX_LOOP_WRITES]; // globals assigned inside it
+    int globalsCount;
+    int overflow;
+    int calls; // calls to anything but intrinsics
+    NodeList* hoisted; // declarations of the locals holding the hoisted expressions
+    int clean; // nothing which could fail or be observed has been evaluated yet
+    ObjString* declared[MAX_LOOP_WRITES]; // globals declared by the main code before the current statement
+    int declaredCount;
+} Licm;
+
+static int intrinsicIndex(ObjString* name) {
+    for (int i = 0; i < INTRINSICS_COUNT; i++) {
+        int length = (int) strlen(intrinsics[i].name);
+        if (name->length == length && memcmp(name->chars, intrinsics[i].name, length) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static void findReassignedIntrinsics(Node** slot, void* data) {
+    Licm* licm = (Licm*) data;
+    Node* node = *slot;
+    if (node->type == NODE_GLOBAL_SET || (node->type == NODE_LET && node->as.variable.variable == NULL)) {
+        int index = intrinsicIndex(node->as.variable.name);
+        if (index >= 0)
+            licm->reassigned[index] = 1;
+    }
+    visitChildren(node, findReassignedIntrinsics, data);
+}
+
+static Intrinsic* calledIntrinsic(Licm* licm, Node* call) {
+    Node* callee = call->as.call.callee;
+    if (callee->type != NODE_GLOBAL_GET || call->as.call.arguments.count != 1)
+        return NULL;
+    int index = intrinsicIndex(callee->as.variable.name);
+    if (index < 0 || licm->reassigned[index])
+        return NULL;
+    return &intrinsics[index];
+}
+
+static void collectLoopEffects(Node** slot, void* data) {
+    Licm* licm = (Licm*) data;
+    Node* node = *slot;
+    switch (node->type) {
+        case NODE_LET:
+        case NODE_VARIABLE_SET:
+        case NODE_GLOBAL_SET:
+            if (node->as.variable.variable != NULL && licm->variablesCount < MAX_LOOP_WRITES)
+                licm->variables[licm->variablesCount++] = node->as.variable.variable;
+            else if (node->as.variable.variable == NULL && licm->globalsCount < MAX_LOOP_WRITES)
+                licm->globals[licm->globalsCount++] = node->as.variable.name;
+            else
+                licm->overflow = 1;
+            break;
+        case NODE_FOR_RANGE:
+        case NODE_FOR_EACH:
+            if (licm->variablesCount + 1 < MAX_LOOP_WRITES) {
+                licm->variables[licm->variablesCount++] = node->as.loop.variable;
+                if (node->as.loop.key != NULL)
+                    licm->variables[licm->variablesCount++] = node->as.loop.key;
+            } else {
+                licm->overflow = 1;
+            }
+            break;
+        case NODE_CALL:
+            if (calledIntrinsic(licm, node) == NULL)
+                licm->calls = 1;
+            break;
+        case NODE_YIELD:
+            // anything can run while the generator is suspended
+            licm->calls = 1;
+            break;
+        default:
+            break;
+    }
+    visitChildren(node, collectLoopEffects, data);
+}
+
+static int writtenInLoop(Licm* licm, Variable* variable) {
+    for (int i = 0; i < licm->variablesCount; i++) {
+        if (licm->variables[i] == variable)
+            return 1;
+    }
+    // captured locals assigned somewhere may be assigned by any call
+    return licm->calls && variable->isCaptured && variable->writes > 0;
+}
+
+static int globalWrittenInLoop(Licm* licm, ObjString* name) {
+    for (int i = 0; i < licm->globalsCount; i++) {
+        if (licm->globals[i] == name)
+            return 1;
+    }
+    return licm->calls;
+}
+
+static int isInvariant(Licm* licm, Node* node) {
+    switch (node->type) {
+        case NODE_CONSTANT:
+            return 1;
+        case NODE_VARIABLE_GET:
+            return !writtenInLoop(licm, node->as.variable.variable);
+        case NODE_GLOBAL_GET:
+            return !globalWrittenInLoop(licm, node->as.variable.name);
+        case NODE_UNARY:
+            return isInvariant(licm, node->as.operation.left);
+        case NODE_BINARY:
+            return node->as.operation.operator != TOK_PLUS_PLUS // a new object each time
+                && isInvariant(licm, node->as.operation.left) && isInvariant(licm, node->as.operation.right);
+        case NODE_CALL:
+            {
+                Intrinsic* intrinsic = calledIntrinsic(licm, node);
+                return intrinsic != NULL && !(intrinsic->readsContent && licm->calls)
+                    && isInvariant(licm, node->as.call.arguments.nodes[0]);
+            }
+        default:
+            return 0;
+    }
+}
+
+// globals are never undeclared: reading one declared before cannot fail
+static int cannotFail(Licm* licm, Node* node) {
+    if (node->type == NODE_GLOBAL_GET) {
+        for (int i = 0; i < licm->declaredCount; i++) {
+            if (licm->declared[i] == node->as.variable.name)
+                return 1;
+        }
+        return 0;
+    }
+    return isPure(node);
+}
+
+static int isHoistable(Licm* licm, Node* node) {
+    if (node->type != NODE_UNARY && node->type != NODE_BINARY && node->type != NODE_CALL)
+        return 0;
+    return isInvariant(licm, node);
+}
+
+// expressions evaluated twice by the guard of a loop: they may fail but never have effects
+static int isEffectFree(Licm* licm, Node* node) {
+    switch (node->type) {
+        case NODE_CONSTANT:
+        case NODE_VARIABLE_GET:
+        case NODE_GLOBAL_GET:
+            return 1;
+        case NODE_INDEXING_GET:
+            return isEffectFree(licm, node->as.indexing.object) && isEffectFree(licm, node->as.indexing.key);
+        case NODE_UNARY:
+        case NODE_BINARY:
+            return isEffectFree(licm, node->as.operation.left)
+                && (node->as.operation.right == NULL || isEffectFree(licm, node->as.operation.right));
+        case NODE_CALL:
+            return calledIntrinsic(licm, node) != NULL && isEffectFree(licm, node->as.call.arguments.nodes[0]);
+        case NODE_TERNARY:
+            return isEffectFree(licm, node->as.branch.condition) && isEffectFree(licm, node->as.branch.then)
+                && isEffectFree(licm, node->as.branch.otherwise);
+        case NODE_AND:
+        case NODE_OR:
+        case NODE_COMMA:
+        case NODE_ARRAY:
+        case NODE_DICT:
+            for (int i = 0; i < node->as.list.count; i++) {
+                if (!isEffectFree(licm, node->as.list.nodes[i]))
+                    return 0;
+            }
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void hoist(Licm* licm, Node** slot) {
+    Optimizer* optimizer = licm->optimizer;
+    Node* node = *slot;
+    Variable* variable = newTemporary(optimizer, licm->function, node->line);
+    nodeListAdd(optimizer->arena, licm->hoisted, newVariableNode(optimizer, NODE_LET, variable, node, node->line));
+    *slot = newVariableNode(optimizer, NODE_VARIABLE_GET, variable, NULL, node->line);
+}
+
+// walks the expression in evaluation order as long as nothing could have failed or been observed
+static void hoistExpression(Licm* licm, Node** slot) {
+    Node* node = *slot;
+    if (!licm->clean)
+        return;
+    if (isHoistable(licm, node)) {
+        hoist(licm, slot);
+        return;
+    }
+    switch (node->type) {
+        case NODE_GLOBAL_SET:
+        case NODE_VARIABLE_SET:
+            hoistExpression(licm, &node->as.variable.value);
+            break;
+        case NODE_INDEXING_GET:
+        case NODE_INDEXING_SET:
+            hoistExpression(licm, &node->as.indexing.object);
+            hoistExpression(licm, &node->as.indexing.key);
+            if (node->as.indexing.value != NULL)
+                hoistExpression(licm, &node->as.indexing.value);
+            break;
+        case NODE_CALL:
+            hoistExpression(licm, &node->as.call.callee);
+            for (int i = 0; i < node->as.call.arguments.count; i++) {
+                hoistExpression(licm, &node->as.call.arguments.nodes[i]);
+            }
+            break;
+        case NODE_UNARY:
+        case NODE_BINARY:
+            hoistExpression(licm, &node->as.operation.left);
+            if (node->as.operation.right != NULL)
+                hoistExpression(licm, &node->as.operation.right);
+            break;
+        case NODE_AND:
+        case NODE_OR:
+            hoistExpression(licm, &node->as.list.nodes[0]);
+            break;
+        case NODE_TERNARY:
+            hoistExpression(licm, &node->as.branch.condition);
+            break;
+        case NODE_COMMA:
+        case NODE_ARRAY:
+        case NODE_DICT:
+            for (int i = 0; i < node->as.list.count; i++) {
+                hoistExpression(licm, &node->as.list.nodes[i]);
+            }
+            break;
+        default:
+            break;
+    }
+    // assigning a local cannot be observed once the program fails
+    if (node->type != NODE_VARIABLE_SET && !cannotFail(licm, node))
+        licm->clean = 0;
+}
+
+static void hoistStatement(Licm* licm, Node* node) {
+    if (!licm->clean)
+        return;
+    switch (node->type) {
+        case NODE_EXPRESSION_STAT:
+            hoistExpression(licm, &node->as.expression);
+            break;
+        case NODE_PRINT:
+        case NODE_YIELD:
+            hoistExpression(licm, &node->as.expression);
+            licm->clean = 0;
+            break;
+        case NODE_LET:
+            if (node->as.variable.value != NULL)
+                hoistExpression(licm, &node->as.variable.value);
+            if (node->as.variable.variable == NULL)
+                licm->clean = 0;
+            break;
+        case NODE_BLOCK:
+            for (int i = 0; i < node->as.list.count; i++) {
+                hoistStatement(licm, node->as.list.nodes[i]);
+            }
+            break;
+        case NODE_IF:
+        case NODE_WHILE:
+            hoistExpression(licm, &node->as.branch.condition);
+            licm->clean = 0;
+            break;
+        case NODE_MATCH:
+            hoistExpression(licm, &node->as.match.subject);
+            licm->clean = 0;
+            break;
+        default:
+            licm->clean = 0;
+            break;
+    }
+}
+
+static Node* wrapInBlock(Arena* arena, NodeList* statements, Node* last, int line) {
+    Node* block = newNode(arena, NODE_BLOCK, line);
+    block->as.list = *statements;
+    nodeListAdd(arena, &block->as.list, last);
+    return block;
+}
+
+// expressions of the condition are hoisted right before the loop. The ones of the body need its first
+// iteration: unless the loop never tests its condition, they are guarded by a copy of it
+static Node* hoistInvariants(Licm* licm, Node* loop) {
+    Arena* arena = licm->optimizer->arena;
+    licm->variablesCount = 0;
+    licm->globalsCount = 0;
+    licm->overflow = 0;
+    licm->calls = 0;
+    collectLoopEffects(&loop, licm);
+    if (licm->overflow)
+        return loop;
+
+    NodeList beforeLoop;
+    NodeList guarded;
+    initNodeList(&beforeLoop);
+    initNodeList(&guarded);
+    Node* condition = loop->as.branch.condition;
+    int forever = node_is_constant(condition) && isTruthy(condition->as.constant);
+    licm->hoisted = &beforeLoop;
+    licm->clean = 1;
+    hoistExpression(licm, &loop->as.branch.condition);
+    if (forever || isEffectFree(licm, loop->as.branch.condition)) {
+        licm->hoisted = forever ? &beforeLoop : &guarded;
+        licm->clean = 1;
+        hoistStatement(licm, loop->as.branch.then);
+    }
+
+    Node* result = loop;
+    if (guarded.count > 0) {
+        Node* guard = newNode(arena, NODE_IF, loop->line);
+        guard->as.branch.condition = copyExpression(arena, loop->as.branch.condition, NULL);
+        guard->as.branch.then = wrapInBlock(arena, &guarded, loop, loop->line);
+        result = guard;
+    }
+    if (beforeLoop.count > 0)
+        result = wrapInBlock(arena, &beforeLoop, result, loop->line);
+    return result;
+}
+
+// inner loops come first, what they hoist may then leave the outer ones
+static void hoistLoops(Node** slot, void* data) {
+    Licm* licm = (Licm*) data;
+    Node* node = *slot;
+    if (node->type == NODE_FUNCTION) {
+        FunctionNode* enclosing = licm->function;
+        licm->function = node->as.function;
+        visitChildren(node, hoistLoops, data);
+        licm->function = enclosing;
+        return;
+    }
+    visitChildren(node, hoistLoops, data);
+    if (node->type == NODE_WHILE)
+        *slot = hoistInvariants(licm, node);
+}
+
+static void hoistAst(Optimizer* optimizer, Ast* ast) {
+    Licm licm;
+    licm.optimizer = optimizer;
+    licm.function = ast->main;
+    for (int i = 0; i < INTRINSICS_COUNT; i++) {
+        licm.reassigned[i] = 0;
+    }
+    visitList(&ast->main->body, findReassignedIntrinsics, &licm);
+    // functions run after their declaration: the globals declared before it are declared for them too
+    licm.declaredCount = 0;
+    for (int i = 0; i < ast->main->body.count; i++) {
+        hoistLoops(&ast->main->body.nodes[i], &licm);
+        Node* statement = ast->main->body.nodes[i];
+        if (statement->type == NODE_LET && statement->as.variable.variable == NULL && licm.declaredCount < MAX_LOOP_WRITES)
+            licm.declared[licm.declaredCount++] = statement->as.variable.name;
+    }
+}
+
+// inlining: calls to small functions bound by a declaration never reassigned are replaced by their body, when
+// it only declares locals and evaluates expressions before returning, without capturing anything. Arguments
+// are assigned to locals of the caller, declared before the statement of the call
+
+#define INLINE_BUDGET 40 // nodes of an inlined body
+#define MAX_INLINE_CANDIDATES 256
+#define MAX_INLINE_LOCALS 128 // locals added to a single function
+
+typedef struct {
+    Variable* variable; // NULL for global functions
+    ObjString* name;
+    FunctionNode* function;
+    int statement; // index of the main code statement declaring a global function
+    int reassigned;
+} InlineCandidate;
+
+typedef struct {
+    Optimizer* optimizer;
+    InlineCandidate candidates[MAX_INLINE_CANDIDATES];
+    int candidatesCount;
+    int statement; // index of the main code statement being optimized
+    FunctionNode* function; // function containing the calls
+    NodeList* temporaries; // declarations to insert before the current statement
+    int temporariesCount; // locals added to the current function
+} Inliner;
+
+typedef struct {
+    FunctionNode* function;
+    ObjString* name; // of the global function, whose calls would be recursive
+    int size;
+    int forbidden;
+} InlineInspection;
+
+static void addCandidate(Inliner* inliner, Variable* variable, ObjString* name, FunctionNode* function) {
+    if (inliner->candidatesCount >= MAX_INLINE_CANDIDATES)
+        return;
+    InlineCandidate* candidate = &inliner->candidates[inliner->candidatesCount++];
+    candidate->variable = variable;
+    candidate->name = name;
+    candidate->function = function;
+    candidate->statement = inliner->statement;
+    candidate->reassigned = 0;
+}
+
+// global functions are only candidates when declared once and never assigned
+static void findReassignedFunctions(Node** slot, void* data) {
+    Inliner* inliner = (Inliner*) data;
+    Node* node = *slot;
+    if (node->type == NODE_GLOBAL_SET || (node->type == NODE_LET && node->as.variable.variable == NULL)) {
+        for (int i = 0; i < inliner->candidatesCount; i++) {
+            InlineCandidate* candidate = &inliner->candidates[i];
+            int declaration = node->type == NODE_LET && node->as.variable.value != NULL
+                && node->as.variable.value->type == NODE_FUNCTION
+                && node->as.variable.value->as.function == candidate->function;
+            if (candidate->variable == NULL && candidate->name == node->as.variable.name && !declaration)
+                candidate->reassigned = 1;
+        }
+    }
+    visitChildren(node, findReassignedFunctions, data);
+}
+
+static InlineCandidate* calledCandidate(Inliner* inliner, Node* callee) {
+    for (int i = 0; i < inliner->candidatesCount; i++) {
+        InlineCandidate* candidate = &inliner->candidates[i];
+        if (callee->type == NODE_VARIABLE_GET && candidate->variable == callee->as.variable.variable)
+            return candidate;
+        // a global function is only known once its declaration has run
+        if (callee->type == NODE_GLOBAL_GET && candidate->variable == NULL && candidate->name == callee->as.variable.name
+                && !candidate->reassigned && inliner->statement > candidate->statement)
+            return candidate;
+    }
+    return NULL;
+}
+
+static void inspectInlined(Node** slot, void* data) {
+    InlineInspection* inspection = (InlineInspection*) data;
+    Node* node = *slot;
+    inspection->size++;
+    switch (node->type) {
+        case NODE_FUNCTION:
+            inspection->forbidden = 1;
+            return;
+        case NODE_VARIABLE_GET:
+        case NODE_VARIABLE_SET:
+            if (node->as.variable.variable->function != inspection->function)
+                inspection->forbidden = 1;
+            break;
+        case NODE_GLOBAL_GET:
+            if (node->as.variable.name == inspection->name)
+                inspection->forbidden = 1;
+            break;
+        default:
+            break;
+    }
+    visitChildren(node, inspectInlined, data);
+}
+
+static int isInlinable(InlineCandidate* candidate) {
+    FunctionNode* function = candidate->function;
+    InlineInspection inspection;
+    inspection.function = function;
+    inspection.name = candidate->variable == NULL ? candidate->name : NULL;
+    inspection.size = 0;
+    inspection.forbidden = 0;
+    for (int i = 0; i < function->body.count; i++) {
+        Node* statement = function->body.nodes[i];
+        int last = i == function->body.count - 1;
+        if (statement->type != NODE_LET && statement->type != NODE_EXPRESSION_STAT
+            && !(statement->type == NODE_RET && last && statement->as.list.count <= 1))
+            return 0;
+        inspectInlined(&function->body.nodes[i], &inspection);
+        if (inspection.forbidden || inspection.size > INLINE_BUDGET)
+            return 0;
+    }
+    return 1;
+}
+
+static Variable* declareTemporary(Inliner* inliner, int line) {
+    Optimizer* optimizer = inliner->optimizer;
+    Variable* temporary = newTemporary(optimizer, inliner->function, line);
+    nodeListAdd(optimizer->arena, inliner->temporaries, newVariableNode(optimizer, NODE_LET, temporary, NULL, line));
+    inliner->temporariesCount++;
+    return temporary;
+}
+
+// arguments which are constants or never assigned locals replace the parameters, as long as they are never assigned
+static int substitutable(Variable* parameter, Node* argument) {
+    if (parameter->writes > 0)
+        return 0;
+    return node_is_constant(argument)
+        || (argument->type == NODE_VARIABLE_GET && argument->as.variable.variable->writes == 0);
+}
+
+static void inlineCall(Inliner* inliner, Node** slot) {
+    Optimizer* optimizer = inliner->optimizer;
+    Arena* arena = optimizer->arena;
+    Node* call = *slot;
+    // a destructuring let expects the callee itself to return its values
+    if (call->as.call.unpacked > 0)
+        return;
+    InlineCandidate* candidate = calledCandidate(inliner, call->as.call.callee);
+    if (candidate == NULL)
+        return;
+    FunctionNode* function = candidate->function;
+    NodeList* arguments = &call->as.call.arguments;
+    if (function == inliner->function || function->isGenerator || function->arity != arguments->count
+        || !isInlinable(candidate))
+        return;
+    int locals = function->arity;
+    for (int i = 0; i < function->body.count; i++) {
+        if (function->body.nodes[i]->type == NODE_LET)
+            locals++;
+    }
+    if (inliner->temporariesCount + locals > MAX_INLINE_LOCALS)
+        return;
+
+    Binding bindings[MAX_INLINE_LOCALS];
+    Bindings bound;
+    bound.bindings = bindings;
+    bound.count = 0;
+    Node* inlined = newNode(arena, NODE_COMMA, call->line);
+    for (int i = 0; i < function->arity; i++) {
+        Binding* binding = &bindings[bound.count++];
+        binding->from = function->parameters[i];
+        binding->to = NULL;
+        binding->value = NULL;
+        if (substitutable(function->parameters[i], arguments->nodes[i])) {
+            binding->value = arguments->nodes[i];
+        } else {
+            binding->to = declareTemporary(inliner, call->line);
+            nodeListAdd(arena, &inlined->as.list,
+                newVariableNode(optimizer, NODE_VARIABLE_SET, binding->to, arguments->nodes[i], call->line));
+        }
+    }
+    Node* result = NULL;
+    for (int i = 0; i < function->body.count; i++) {
+        Node* statement = function->body.nodes[i];
+        if (statement->type == NODE_LET) {
+            // locals start from their initializer, or nihl, at every call
+            Binding* binding = &bindings[bound.count++];
+            binding->from = statement->as.variable.variable;
+            binding->to = declareTemporary(inliner, statement->line);
+            binding->value = NULL;
+            Node* value = statement->as.variable.value != NULL
+                ? copyExpression(arena, statement->as.variable.value, &bound)
+                : newConstantNode(arena, to_vnihl(), statement->line);
+            nodeListAdd(arena, &inlined->as.list, newVariableNode(optimizer, NODE_VARIABLE_SET, binding->to, value, statement->line));
+        } else if (statement->type == NODE_EXPRESSION_STAT) {
+            nodeListAdd(arena, &inlined->as.list, copyExpression(arena, statement->as.expression, &bound));
+        } else if (statement->as.list.count > 0) {
+            result = copyExpression(arena, statement->as.list.nodes[0], &bound);
+        }
+    }
+    if (result == NULL)
+        result = newConstantNode(arena, to_vnihl(), call->line);
+    nodeListAdd(arena, &inlined->as.list, result);
+    *slot = inlined->as.list.count == 1 ? result : inlined;
+    optimizer->changed = 1;
+}
+
+static void inlineList(Inliner* inliner, NodeList* list);
+
+// calls are replaced after their arguments: inlined bodies are not searched again
+static void inlineExpression(Node** slot, void* data) {
+    Inliner* inliner = (Inliner*) data;
+    Node* node = *slot;
+    if (node->type == NODE_FUNCTION) {
+        FunctionNode* enclosing = inliner->function;
+        int enclosingCount = inliner->temporariesCount;
+        inliner->function = node->as.function;
+        inliner->temporariesCount = 0;
+        inlineList(inliner, &node->as.function->body);
+        inliner->function = enclosing;
+        inliner->temporariesCount = enclosingCount;
+        return;
+    }
+    visitChildren(node, inlineExpression, data);
+    if (node->type == NODE_CALL)
+        inlineCall(inliner, slot);
+}
+
+static void inlineStatement(Inliner* inliner, Node* node) {
+    switch (node->type) {
+        case NODE_LET:
+            if (node->as.variable.value == NULL)
+                break;
+            inlineExpression(&node->as.variable.value, inliner);
+            Variable* variable = node->as.variable.variable;
+            if (variable != NULL && variable->writes == 0 && node->as.variable.value->type == NODE_FUNCTION)
+                addCandidate(inliner, variable, NULL, node->as.variable.value->as.function);
+            break;
+        case NODE_BLOCK:
+            inlineList(inliner, &node->as.list);
+            break;
+        case NODE_IF:
+        case NODE_WHILE:
+            inlineExpression(&node->as.branch.condition, inliner);
+            inlineStatement(inliner, node->as.branch.then);
+            if (node->as.branch.otherwise != NULL)
+                inlineStatement(inliner, node->as.branch.otherwise);
+            break;
+        case NODE_FOR_RANGE:
+        case NODE_FOR_EACH:
+            inlineExpression(&node->as.loop.start, inliner);
+            if (node->as.loop.end != NULL)
+                inlineExpression(&node->as.loop.end, inliner);
+            if (node->as.loop.step != NULL)
+                inlineExpression(&node->as.loop.step, inliner);
+            inlineStatement(inliner, node->as.loop.body);
+            break;
+        case NODE_MATCH:
+            inlineExpression(&node->as.match.subject, inliner);
+            for (int i = 0; i < node->as.match.arms.count; i++) {
+                inlineStatement(inliner, node->as.match.arms.nodes[i]->as.arm.body);
+            }
+            if (node->as.match.otherwise != NULL)
+                inlineStatement(inliner, node->as.match.otherwise);
+            break;
+        case NODE_UNPACK:
+            inlineExpression(&node->as.unpack.call, inliner);
+            break;
+        case NODE_EXPRESSION_STAT:
+        case NODE_PRINT:
+        case NODE_YIELD:
+            inlineExpression(&node->as.expression, inliner);
+            break;
+        case NODE_RET:
+            for (int i = 0; i < node->as.list.count; i++) {
+                inlineExpression(&node->as.list.nodes[i], inliner);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void inlineList(Inliner* inliner, NodeList* list) {
+    NodeList* enclosing = inliner->temporaries;
+    NodeList statements;
+    initNodeList(&statements);
+    for (int i = 0; i < list->count; i++) {
+        NodeList temporaries;
+        initNodeList(&temporaries);
+        inliner->temporaries = &temporaries;
+        inlineStatement(inliner, list->nodes[i]);
+        for (int j = 0; j < temporaries.count; j++) {
+            nodeListAdd(inliner->optimizer->arena, &statements, temporaries.nodes[j]);
+        }
+        nodeListAdd(inliner->optimizer->arena, &statements, list->nodes[i]);
+    }
+    if (statements.count > list->count)
+        *list = statements;
+    inliner->temporaries = enclosing;
+}
+
+static void inlineAst(Optimizer* optimizer, Ast* ast) {
+    Inliner inliner;
+    inliner.optimizer = optimizer;
+    inliner.candidatesCount = 0;
+    inliner.function = ast->main;
+    inliner.temporariesCount = 0;
+    for (int i = 0; i < ast->main->body.count; i++) {
+        Node* statement = ast->main->body.nodes[i];
+        inliner.statement = i;
+        if (statement->type == NODE_LET && statement->as.variable.variable == NULL
+                && statement->as.variable.value != NULL && statement->as.variable.value->type == NODE_FUNCTION)
+            addCandidate(&inliner, NULL, statement->as.variable.name, statement->as.variable.value->as.function);
+    }
+    visitList(&ast->main->body, findReassignedFunctions, &inliner);
+
+    NodeList* body = &ast->main->body;
+    NodeList statements;
+    initNodeList(&statements);
+    for (int i = 0; i < body->count; i++) {
+        NodeList temporaries;
+        initNodeList(&temporaries);
+        inliner.statement = i;
+        inliner.temporaries = &temporaries;
+        inlineStatement(&inliner, body->nodes[i]);
+        for (int j = 0; j < temporaries.count; j++) {
+            nodeListAdd(optimizer->arena, &statements, temporaries.nodes[j]);
+        }
+        nodeListAdd(optimizer->arena, &statements, body->nodes[i]);
+    }
+    *body = statements;
+}
+
+// scalar replacement: a local initialized with an array or dict literal, never assigned nor captured, which is
+// only indexed by constant keys never failing (reading a key a dict misses gives nihl, writing it would add
+// it) never escapes the function. Each element becomes a local of its own and the literal is never built
+
+#define MAX_SCALAR_ELEMENTS 16
+#define MAX_SCALAR_LOCALS 128 // locals added to a single function
+
+typedef struct {
+    Optimizer* optimizer;
+    int localsCount; // locals added to the current function
+} Scalars;
+
+typedef struct {
+    Optimizer* optimizer;
+    Variable* variable;
+    Node* literal;
+    Variable* elements[MAX_SCALAR_ELEMENTS];
+    int uses;
+} Aggregate;
+
+static void scalarList(Scalars* scalars, NodeList* list, FunctionNode* function);
+
+// the literal an initializer evaluates to, after the expressions of the commas holding it
+static Node* initializedLiteral(Node* value) {
+    while (value->type == NODE_COMMA)
+        value = value->as.list.nodes[value->as.list.count - 1];
+    return value;
+}
+
+static int isReplaceableLiteral(Node* literal) {
+    if (literal->type != NODE_ARRAY && literal->type != NODE_DICT)
+        return 0;
+    NodeList* list = &literal->as.list;
+    if (literal->type == NODE_ARRAY)
+        return list->count <= MAX_SCALAR_ELEMENTS;
+    if (list->count / 2 > MAX_SCALAR_ELEMENTS)
+        return 0;
+    // distinct constant string keys, so that the dict holds exactly one element for each of them
+    for (int i = 0; i < list->count; i += 2) {
+        Node* key = list->nodes[i];
+        if (!node_is_constant(key) || !is_string(key->as.constant))
+            return 0;
+        for (int j = 0; j < i; j += 2) {
+            if (valuesEqual(list->nodes[j]->as.constant, key->as.constant))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+// position of the element of literal indexed by key, -1 when it has none
+static int elementIndex(Node* literal, Value key) {
+    NodeList* list = &literal->as.list;
+    if (literal->type == NODE_ARRAY) {
+        if (!valueInteger(key))
+            return -1;
+        double index = as_cnumber(key);
+        return index >= 0 && index < list->count ? (int) index : -1;
+    }
+    for (int i = 0; i < list->count; i += 2) {
+        if (valuesEqual(list->nodes[i]->as.constant, key))
+            return i / 2;
+    }
+    return -1;
+}
+
+static int isAggregateIndexing(Aggregate* aggregate, Node* node) {
+    if (node->type != NODE_INDEXING_GET && node->type != NODE_INDEXING_SET)
+        return 0;
+    Node* object = node->as.indexing.object;
+    return object->type == NODE_VARIABLE_GET && object->as.variable.variable == aggregate->variable;
+}
+
+static int isReplaceableIndexing(Aggregate* aggregate, Node* node) {
+    Node* key = node->as.indexing.key;
+    if (!node_is_constant(key))
+        return 0;
+    if (elementIndex(aggregate->literal, key->as.constant) >= 0)
+        return 1;
+    return aggregate->literal->type == NODE_DICT && node->type == NODE_INDEXING_GET && is_string(key->as.constant);
+}
+
+static void countAggregateUses(Node** slot, void* data) {
+    Aggregate* aggregate = (Aggregate*) data;
+    Node* node = *slot;
+    if (isAggregateIndexing(aggregate, node) && isReplaceableIndexing(aggregate, node))
+        aggregate->uses++;
+    visitChildren(node, countAggregateUses, data);
+}
+
+static void replaceAggregateUses(Node** slot, void* data) {
+    Aggregate* aggregate = (Aggregate*) data;
+    visitChildren(*slot, replaceAggregateUses, data);
+    Node* node = *slot;
+    if (!isAggregateIndexing(aggregate, node))
+        return;
+    int index = elementIndex(aggregate->literal, node->as.indexing.key->as.constant);
+    if (index < 0) {
+        *slot = newConstantNode(aggregate->optimizer->arena, to_vnihl(), node->line);
+        return;
+    }
+    NodeType type = node->type == NODE_INDEXING_GET ? NODE_VARIABLE_GET : NODE_VARIABLE_SET;
+    *slot = newVariableNode(aggregate->optimizer, type, aggregate->elements[index], node->as.indexing.value, node->line);
+}
+
+// returns whether let was replaced by the statements declaring the elements, added to statements
+static int replaceAggregate(Scalars* scalars, Node* let, FunctionNode* function, NodeList* statements) {
+    Optimizer* optimizer = scalars->optimizer;
+    Variable* variable = let->as.variable.variable;
+    if (variable == NULL || variable->writes > 0 || variable->isCaptured || let->as.variable.value == NULL)
+        return 0;
+    Aggregate aggregate;
+    aggregate.optimizer = optimizer;
+    aggregate.variable = variable;
+    aggregate.literal = initializedLiteral(let->as.variable.value);
+    aggregate.uses = 0;
+    if (!isReplaceableLiteral(aggregate.literal))
+        return 0;
+    visitList(&function->body, countAggregateUses, &aggregate);
+    NodeList* elements = &aggregate.literal->as.list;
+    int count = aggregate.literal->type == NODE_ARRAY ? elements->count : elements->count / 2;
+    if (aggregate.uses != variable->reads || scalars->localsCount + count > MAX_SCALAR_LOCALS)
+        return 0;
+    scalars->localsCount += count;
+
+    for (Node* value = let->as.variable.value; value->type == NODE_COMMA; value = value->as.list.nodes[value->as.list.count - 1]) {
+        for (int i = 0; i < value->as.list.count - 1; i++) {
+            Node* statement = newNode(optimizer->arena, NODE_EXPRESSION_STAT, let->line);
+            statement->as.expression = value->as.list.nodes[i];
+            nodeListAdd(optimizer->arena, statements, statement);
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        Node* element = aggregate.literal->type == NODE_ARRAY ? elements->nodes[i] : elements->nodes[i * 2 + 1];
+        aggregate.elements[i] = newTemporary(optimizer, function, element->line);
+        nodeListAdd(optimizer->arena, statements, newVariableNode(optimizer, NODE_LET, aggregate.elements[i], element, let->line));
+    }
+    visitList(&function->body, replaceAggregateUses, &aggregate);
+    optimizer->changed = 1;
+    return 1;
+}
+
+static void scalarFunction(Scalars* scalars, FunctionNode* function) {
+    int enclosingCount = scalars->localsCount;
+    scalars->localsCount = 0;
+    scalarList(scalars, &function->body, function);
+    scalars->localsCount = enclosingCount;
+}
+
+static void scalarFunctions(Node** slot, void* data) {
+    Node* node = *slot;
+    if (node->type == NODE_FUNCTION)
+        scalarFunction((Scalars*) data, node->as.function);
+    else
+        visitChildren(node, scalarFunctions, data);
+}
+
+static void scalarStatement(Scalars* scalars, Node* node, FunctionNode* function) {
+    switch (node->type) {
+        case NODE_BLOCK:
+            scalarList(scalars, &node->as.list, function);
+            break;
+        case NODE_IF:
+        case NODE_WHILE:
+            scalarFunctions(&node->as.branch.condition, scalars);
+            scalarStatement(scalars, node->as.branch.then, function);
+            if (node->as.branch.otherwise != NULL)
+                scalarStatement(scalars, node->as.branch.otherwise, function);
+            break;
+        case NODE_FOR_RANGE:
+        case NODE_FOR_EACH:
+            scalarFunctions(&node->as.loop.start, scalars);
+            if (node->as.loop.end != NULL)
+                scalarFunctions(&node->as.loop.end, scalars);
+            if (node->as.loop.step != NULL)
+                scalarFunctions(&node->as.loop.step, scalars);
+            scalarStatement(scalars, node->as.loop.body, function);
+            break;
+        case NODE_MATCH:
+            scalarFunctions(&node->as.match.subject, scalars);
+            for (int i = 0; i < node->as.match.arms.count; i++) {
+                scalarStatement(scalars, node->as.match.arms.nodes[i]->as.arm.body, function);
+            }
+            if (node->as.match.otherwise != NULL)
+                scalarStatement(scalars, node->as.match.otherwise, function);
+            break;
+        default:
+            visitChildren(node, scalarFunctions, scalars);
+            break;
+    }
+}
+
+static void scalarList(Scalars* scalars, NodeList* list, FunctionNode* function) {
+    NodeList statements;
+    initNodeList(&statements);
+    int replaced = 0;
+    for (int i = 0; i < list->count; i++) {
+        Node* statement = list->nodes[i];
+        scalarStatement(scalars, statement, function);
+        if (statement->type == NODE_LET && replaceAggregate(scalars, statement, function, &statements))
+            replaced = 1;
+        else
+            nodeListAdd(scalars->optimizer->arena, &statements, statement);
+    }
+    if (replaced)
+        *list = statements;
+}
+
+static void scalarAst(Optimizer* optimizer, Ast* ast) {
+    Scalars scalars;
+    scalars.optimizer = optimizer;
+    scalars.localsCount = 0;
+    scalarList(&scalars, &ast->main->body, ast->main);
+}
+
+// type inference: for each local of a function, whether it surely holds a number at a point of the code.
+// Arithmetic operations and comparisons whose operands are proven numbers are marked, so that the code
+// generator can emit opcodes skipping the type checks. Locals captured and assigned are never tracked: a
+// call could change them. Unreachable code holds every fact, so that merging with it changes nothing
+
+typedef struct {
+    Arena* arena;
+    FunctionNode* function;
+    int count; // tracked locals
+    char* state;
+    char* breaks; // merged states of the breaks of the innermost loop, NULL outside of loops
+    char* continues;
+} Inference;
+
+static void inferFunction(Arena* arena, FunctionNode* function);
+
+static void indexLocal(Inference* inference, Variable* variable) {
+    variable->index = variable->isCaptured && variable->writes > 0 ? -1 : inference->count++;
+}
+
+static void indexLocals(Node** slot, void* data) {
+    Node* node = *slot;
+    if (node->type == NODE_FUNCTION)
+        return;
+    if (node->type == NODE_LET && node->as.variable.variable != NULL)
+        indexLocal((Inference*) data, node->as.variable.variable);
+    if (node->type == NODE_FOR_RANGE || node->type == NODE_FOR_EACH) {
+        indexLocal((Inference*) data, node->as.loop.variable);
+        if (node->as.loop.key != NULL)
+            indexLocal((Inference*) data, node->as.loop.key);
+    }
+    visitChildren(node, indexLocals, data);
+}
+
+static char* newState(Inference* inference) {
+    // every fact holds: the state of unreachable code
+    char* state = arenaAllocate(inference->arena, inference->count + 1);
+    memset(state, 1, inference->count + 1);
+    return state;
+}
+
+static char* copyState(Inference* inference, char* state) {
+    char* copy = newState(inference);
+    memcpy(copy, state, inference->count);
+    return copy;
+}
+
+static void mergeState(Inference* inference, char* to, char* from) {
+    for (int i = 0; i < inference->count; i++) {
+        to[i] = to[i] && from[i];
+    }
+}
+
+static int trackedIndex(Inference* inference, Variable* variable) {
+    return variable->function == inference->function ? variable->index : -1;
+}
+
+// an operation checking the types of its operands only goes on with numbers: locals just read by it hold one
+static void proveNumber(Inference* inference, Node* operand) {
+    if (operand->type != NODE_VARIABLE_GET)
+        return;
+    int index = trackedIndex(inference, operand->as.variable.variable);
+    if (index >= 0)
+        inference->state[index] = 1;
+}
+
+static int inferExpression(Inference* inference, Node* node);
+
+static int inferExpressions(Inference* inference, NodeList* list) {
+    int numeric = 1;
+    for (int i = 0; i < list->count; i++) {
+        numeric = inferExpression(inference, list->nodes[i]) && numeric;
+    }
+    return numeric;
+}
+
+static int isArithmetic(TokenType operator) {
+    switch (operator) {
+        case TOK_PLUS:
+        case TOK_MINUS:
+        case TOK_STAR:
+        case TOK_SLASH:
+        case TOK_PERCENTAGE:
+        case TOK_CIRCUMFLEX:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int isComparison(TokenType operator) {
+    switch (operator) {
+        case TOK_LESS:
+        case TOK_LESS_EQUAL:
+        case TOK_GREATER:
+        case TOK_GREATER_EQUAL:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// walks node in evaluation order, returns whether its value is surely a number. Arithmetic operations
+// always produce numbers: they fail otherwise
+static int inferExpression(Inference* inference, Node* node) {
+    switch (node->type) {
+        case NODE_CONSTANT:
+            return is_number(node->as.constant);
+        case NODE_GLOBAL_SET:
+            return inferExpression(inference, node->as.variable.value);
+        case NODE_VARIABLE_GET:
+            {
+                int index = trackedIndex(inference, node->as.variable.variable);
+                return index >= 0 && inference->state[index];
+            }
+        case NODE_VARIABLE_SET:
+            {
+                int numeric = inferExpression(inference, node->as.variable.value);
+                int index = trackedIndex(inference, node->as.variable.variable);
+                if (index >= 0)
+                    inference->state[index] = numeric;
+                return numeric;
+            }
+        case NODE_INDEXING_GET:
+        case NODE_INDEXING_SET:
+            inferExpression(inference, node->as.indexing.object);
+            inferExpression(inference, node->as.indexing.key);
+            if (node->as.indexing.value != NULL)
+                inferExpression(inference, node->as.indexing.value);
+            return 0;
+        case NODE_CALL:
+            inferExpression(inference, node->as.call.callee);
+            inferExpressions(inference, &node->as.call.arguments);
+            return 0;
+        case NODE_UNARY:
+            {
+                int numeric = inferExpression(inference, node->as.operation.left);
+                int negation = node->as.operation.operator == TOK_MINUS;
+                node->as.operation.numeric = negation && numeric;
+                if (negation)
+                    proveNumber(inference, node->as.operation.left);
+                return negation;
+            }
+        case NODE_BINARY:
+            {
+                TokenType operator = node->as.operation.operator;
+                int left = inferExpression(inference, node->as.operation.left);
+                int right = inferExpression(inference, node->as.operation.right);
+                int checked = isArithmetic(operator) || isComparison(operator);
+                node->as.operation.numeric = checked && left && right;
+                if (checked) {
+                    // the right operand may have assigned the left one after it was read
+                    Node* rightOperand = node->as.operation.right;
+                    if (node_is_constant(rightOperand) || rightOperand->type == NODE_VARIABLE_GET)
+                        proveNumber(inference, node->as.operation.left);
+                    proveNumber(inference, rightOperand);
+                }
+                return isArithmetic(operator);
+            }
+        case NODE_AND:
+        case NODE_OR:
+            {
+                // every operand but the last one may be the value of the expression
+                NodeList* operands = &node->as.list;
+                char* exits = newState(inference);
+                int numeric = 1;
+                for (int i = 0; i < operands->count; i++) {
+                    numeric = inferExpression(inference, operands->nodes[i]) && numeric;
+                    if (i < operands->count - 1)
+                        mergeState(inference, exits, inference->state);
+                }
+                mergeState(inference, inference->state, exits);
+                return numeric;
+            }
+        case NODE_TERNARY:
+            {
+                inferExpression(inference, node->as.branch.condition);
+                char* otherwise = copyState(inference, inference->state);
+                int numeric = inferExpression(inference, node->as.branch.then);
+                char* then = inference->state;
+                inference->state = otherwise;
+                numeric = inferExpression(inference, node->as.branch.otherwise) && numeric;
+                mergeState(inference, inference->state, then);
+                return numeric;
+            }
+        case NODE_COMMA:
+            {
+                int numeric = 0;
+                for (int i = 0; i < node->as.list.count; i++) {
+                    numeric = inferExpression(inference, node->as.list.nodes[i]);
+                }
+                return numeric;
+            }
+        case NODE_ARRAY:
+        case NODE_DICT:
+            inferExpressions(inference, &node->as.list);
+            return 0;
+        case NODE_FUNCTION:
+            inferFunction(inference->arena, node->as.function);
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+static void inferStatement(Inference* inference, Node* node);
+
+static void inferList(Inference* inference, NodeList* list) {
+    for (int i = 0; i < list->count; i++) {
+        inferStatement(inference, list->nodes[i]);
+    }
+}
+
+static int sameState(Inference* inference, char* a, char* b) {
+    return memcmp(a, b, inference->count) == 0;
+}
+
+// the body is walked again until the state at the start of an iteration stops changing: facts are only
+// ever lost, so this ends. Marks left by the last walk are the ones holding at every iteration.
+// A while loop checks its condition before every iteration, a for loop sets its variables: range ones
+// always to a number
+static void inferLoop(Inference* inference, Node* loop) {
+    char* enclosingBreaks = inference->breaks;
+    char* enclosingContinues = inference->continues;
+    char* entry = copyState(inference, inference->state);
+    char* exit;
+    for (;;) {
+        inference->state = copyState(inference, entry);
+        Node* body;
+        if (loop->type == NODE_WHILE) {
+            inferExpression(inference, loop->as.branch.condition);
+            body = loop->as.branch.then;
+        } else {
+            int index = trackedIndex(inference, loop->as.loop.variable);
+            if (index >= 0)
+                inference->state[index] = loop->type == NODE_FOR_RANGE;
+            index = loop->as.loop.key != NULL ? trackedIndex(inference, loop->as.loop.key) : -1;
+            if (index >= 0)
+                inference->state[index] = 0;
+            body = loop->as.loop.body;
+        }
+        exit = copyState(inference, inference->state);
+        inference->breaks = newState(inference);
+        inference->continues = newState(inference);
+        inferStatement(inference, body);
+        mergeState(inference, inference->state, inference->continues);
+        mergeState(inference, inference->state, entry);
+        if (sameState(inference, inference->state, entry))
+            break;
+        entry = inference->state;
+    }
+    mergeState(inference, exit, inference->breaks);
+    inference->state = exit;
+    inference->breaks = enclosingBreaks;
+    inference->continues = enclosingContinues;
+}
+
+static void inferStatement(Inference* inference, Node* node) {
+    switch (node->type) {
+        case NODE_LET:
+            {
+                int numeric = node->as.variable.value != NULL && inferExpression(inference, node->as.variable.value);
+                Variable* variable = node->as.variable.variable;
+                if (variable != NULL && variable->index >= 0)
+                    inference->state[variable->index] = numeric;
+                break;
+            }
+        case NODE_BLOCK:
+            inferList(inference, &node->as.list);
+            break;
+        case NODE_IF:
+            {
+                inferExpression(inference, node->as.branch.condition);
+                char* otherwise = copyState(inference, inference->state);
+                inferStatement(inference, node->as.branch.then);
+                char* then = inference->state;
+                inference->state = otherwise;
+                if (node->as.branch.otherwise != NULL)
+                    inferStatement(inference, node->as.branch.otherwise);
+                mergeState(inference, inference->state, then);
+                break;
+            }
+        case NODE_MATCH:
+            {
+                // every arm starts from the state after the subject, a match without else may run none
+                inferExpression(inference, node->as.match.subject);
+                char* entry = inference->state;
+                char* merged = newState(inference);
+                for (int i = 0; i < node->as.match.arms.count; i++) {
+                    inference->state = copyState(inference, entry);
+                    inferStatement(inference, node->as.match.arms.nodes[i]->as.arm.body);
+                    mergeState(inference, merged, inference->state);
+                }
+                inference->state = copyState(inference, entry);
+                if (node->as.match.otherwise != NULL)
+                    inferStatement(inference, node->as.match.otherwise);
+                mergeState(inference, merged, inference->state);
+                inference->state = merged;
+                break;
+            }
+        case NODE_WHILE:
+            inferLoop(inference, node);
+            break;
+        case NODE_FOR_RANGE:
+        case NODE_FOR_EACH:
+            inferExpression(inference, node->as.loop.start);
+            if (node->as.loop.end != NULL)
+                inferExpression(inference, node->as.loop.end);
+            if (node->as.loop.step != NULL)
+                inferExpression(inference, node->as.loop.step);
+            inferLoop(inference, node);
+            break;
+        case NODE_EXPRESSION_STAT:
+        case NODE_PRINT:
+        case NODE_YIELD:
+            inferExpression(inference, node->as.expression);
+            break;
+        case NODE_UNPACK:
+            {
+                inferExpression(inference, node->as.unpack.call);
+                NodeList* targets = &node->as.unpack.targets;
+                for (int i = 0; i < targets->count; i++) {
+                    Variable* variable = targets->nodes[i]->as.variable.variable;
+                    if (variable != NULL && variable->index >= 0)
+                        inference->state[variable->index] = 0;
+                }
+                break;
+            }
+        case NODE_RET:
+            inferExpressions(inference, &node->as.list);
+            memset(inference->state, 1, inference->count);
+            break;
+        case NODE_BREAK:
+        case NODE_CONTINUE:
+            {
+                char* target = node->type == NODE_BREAK ? inference->breaks : inference->continues;
+                if (target != NULL)
+                    mergeState(inference, target, inference->state);
+                memset(inference->state, 1, inference->count);
+                break;
+            }
+        default:
+            break;
+    }
+}
+
+static void inferFunction(Arena* arena, FunctionNode* function) {
+    Inference inference;
+    inference.arena = arena;
+    inference.function = function;
+    inference.count = 0;
+    inference.breaks = NULL;
+    inference.continues = NULL;
+    for (int i = 0; i < function->arity; i++) {
+        indexLocal(&inference, function->parameters[i]);
+    }
+    visitList(&function->body, indexLocals, &inference);
+    inference.state = newState(&inference);
+    // parameters and locals hold anything before their declaration
+    memset(inference.state, 0, inference.count);
+    inferList(&inference, &function->body);
+}
+
+static void basicPasses(Optimizer* optimizer, Ast* ast) {
+    for (int round = 0; round < MAX_ROUNDS; round++) {
+        optimizer->changed = 0;
+        countList(&ast->main->body, ast->main);
+        optimizeList(optimizer, &ast->main->body);
+        if (!optimizer->changed)
+            break;
+    }
+}
+
+void optimizeAst(Ast* ast, Collector* collector, int level) {
+    Optimizer optimizer;
+    optimizer.arena = &ast->arena;
+    optimizer.collector = collector;
+    if (level >= OPTIMIZATION_BASIC)
+        basicPasses(&optimizer, ast);
+    if (level >= OPTIMIZATION_FULL) {
+        countList(&ast->main->body, ast->main);
+        inlineAst(&optimizer, ast);
+        basicPasses(&optimizer, ast);
+        countList(&ast->main->body, ast->main);
+        scalarAst(&optimizer, ast);
+        basicPasses(&optimizer, ast);
+        countList(&ast->main->body, ast->main);
+        eliminateList(&optimizer, &ast->main->body, ast->main);
+        eliminateFunctionsIn(&optimizer, &ast->main->body);
+        // locals holding a common subexpression are copies that can be propagated
+        basicPasses(&optimizer, ast);
+        countList(&ast->main->body, ast->main);
+        hoistAst(&optimizer, ast);
+        basicPasses(&optimizer, ast);
+    }
+    // captures may have changed: the code generator relies on them to close upvalues
+    countList(&ast->main->body, ast->main);
+    if (level >= OPTIMIZATION_FULL)
+        inferFunction(&ast->arena, ast->main);
+}
@@ -0,0 +1,14 @@
+#ifndef optimizer_h
+#define optimizer_h
+
+#include "../memory.h"
+#include "ast.h"
+
+#define OPTIMIZATION_NONE 0
+#define OPTIMIZATION_BASIC 1 // folding, dead code elimination, copy propagation and unused locals removal
+#define OPTIMIZATION_FULL 2 // adds inlining, scalar replacement, common subexpression elimination, loop invariant code motion and type inference
+
+void optimizeAst(Ast* ast, Collector* collector, int level);
+int foldConstant(Collector* collector, Node* node, Value* result);
+
+#endif
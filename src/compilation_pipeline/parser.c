@@ -0,0 +1,932 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "parser.h"
+#include "optimizer.h"
+#include "../datastructs/value.h"
+#include "../debug/debug_switches.h"
+
+#define MAX_BRANCHES 200
+#define MAX_MATCH_ARMS 1024
+
+#define standard_binary_expression(name, next, condition) \
+    static Node* name(Parser* parser, int canAssign) { \
+        Node* left = next(parser, canAssign); \
+        while (condition) { \
+            Node* node = newNode(parser->arena, NODE_BINARY, parser->current.line); \
+            node->as.operation.operator = currentTokenType(parser); \
+            advance(parser); \
+            node->as.operation.left = left; \
+            node->as.operation.right = next(parser, 0); \
+            left = node; \
+        } \
+        return left; \
+    }
+
+static Node* expression(Parser* parser);
+static Node* nonCommaExpression(Parser* parser);
+static Node* statement(Parser* parser);
+
+static void error(Parser* parser, Token tok, char* message) {
+    if (parser->panic)
+        return;
+    fprintf(stderr, "error ");
+    if (tok.type == TOK_EOF) {
+        fprintf(stderr, "[at end]: ");
+    } else {
+        fprintf(stderr, "[at %d]: ", tok.line);
+    }
+    if (tok.type != TOK_ERROR) {
+        fprintf(stderr, "at '%.*s', ", tok.length, tok.start);
+        fprintf(stderr, "%s\n", message);
+    } else {
+        fprintf(stderr, "%.*s\n", tok.length, tok.start);
+    }
+    parser->hadError = 1;
+    parser->panic = 1;
+}
+
+static void errorAtCurrent(Parser* parser, char* message) {
+    error(parser, parser->current, message);
+}
+
+static TokenType currentTokenType(Parser* parser) {
+    return parser->current.type;
+}
+
+static void advance(Parser* parser) {
+    parser->previous = parser->current;
+    for (;;) {
+        parser->current = nextToken(&parser->lexer);
+#ifdef TRACE_TOKENS
+        printf("\n...\n");
+        printToken(parser->current);
+        printf("...\n");
+#endif
+        if (parser->current.type != TOK_ERROR)
+            break;
+        errorAtCurrent(parser, "");
+    }
+}
+
+static int check(Parser* parser, TokenType type) {
+    return parser->current.type == type;
+}
+
+static int eat(Parser* parser, TokenType type) {
+    if (check(parser, type)) {
+        advance(parser);
+        return 1;
+    }
+    return 0;
+}
+
+static void eatError(Parser* parser, TokenType type, char* msg) {
+    if (!eat(parser, type)) {
+        errorAtCurrent(parser, msg);
+        advance(parser);
+    }
+}
+
+static int identifiersEqual(Token id1, Token id2) {
+    return id1.length == id2.length &&
+        memcmp(id1.start, id2.start, id1.length) == 0;
+}
+
+static ParseLocal* findLocal(ParseScope* scope, Token identifier) {
+    for (int i = scope->localsCount - 1; i >= 0; i--) {
+        ParseLocal* local = &scope->locals[i];
+        if (identifiersEqual(identifier, local->variable->name))
+            return local;
+    }
+    return NULL;
+}
+
+// variable bound to identifier, NULL for globals
+static Variable* resolveVariable(Parser* parser, Token identifier, int* uninitialized) {
+    ParseScope* scope = parser->scope;
+    ParseLocal* local;
+    *uninitialized = 0;
+    if (scope->depth > 0 && (local = findLocal(scope, identifier)) != NULL) { // locals realm
+        *uninitialized = local->depth < 0;
+        return local->variable;
+    }
+    for (ParseScope* enclosing = scope->enclosing; enclosing != NULL; enclosing = enclosing->enclosing) {
+        if ((local = findLocal(enclosing, identifier)) != NULL) {
+            local->variable->isCaptured = 1;
+            return local->variable;
+        }
+    }
+    return NULL;
+}
+
+// consts are folded into their uses, the innermost declaration of identifier deciding whether it is one
+static Node* resolveConstant(Parser* parser, Token identifier) {
+    ParseScope* scope = parser->scope;
+    ParseLocal* local;
+    if (scope->depth > 0 && (local = findLocal(scope, identifier)) != NULL)
+        return local->constant;
+    for (ParseScope* enclosing = scope->enclosing; enclosing != NULL; enclosing = enclosing->enclosing) {
+        if ((local = findLocal(enclosing, identifier)) != NULL)
+            return local->constant;
+    }
+    Value name = to_vobj(copyInternedString(parser->collector, identifier.start, identifier.length));
+    Value value;
+    if (!mapGet(&parser->constants, name, &value))
+        return NULL;
+    return newConstantNode(parser->arena, value, identifier.line);
+}
+
+static int isGlobalConstant(Parser* parser, Token identifier) {
+    Value name = to_vobj(copyInternedString(parser->collector, identifier.start, identifier.length));
+    Value value;
+    return mapGet(&parser->constants, name, &value);
+}
+
+// a const cannot take the name of a global the code before it declares or assigns
+static void recordGlobal(Parser* parser, ObjString* name, int use) {
+    Value previous;
+    if (mapGet(&parser->globals, to_vobj(name), &previous) && as_cnumber(previous) >= use)
+        return;
+    mapPut(parser->collector, &parser->globals, to_vobj(name), to_vnumber(use));
+}
+
+static int alreadyDeclaredLocal(ParseScope* scope, Token identifier) {
+    for (int i = scope->localsCount - 1; i >= 0; i--) {
+        // locals of a let being parsed are not defined yet, but already belong to this scope
+        if (scope->locals[i].depth != -1 && scope->locals[i].depth < scope->depth)
+            return 0;
+        if (identifiersEqual(scope->locals[i].variable->name, identifier))
+            return 1;
+    }
+    return 0;
+}
+
+static Variable* declareLocal(Parser* parser, Token identifier) {
+    ParseScope* scope = parser->scope;
+    Variable* variable = newVariable(parser->arena, identifier, scope->function);
+    if (alreadyDeclaredLocal(scope, identifier)) {
+        errorAtCurrent(parser, "variable with this name already declared in this scope");
+        return variable;
+    }
+    if (scope->localsCount >= MAX_LOCALS) {
+        errorAtCurrent(parser, "too many locals declared in scope");
+        return variable;
+    }
+    ParseLocal* local = &scope->locals[scope->localsCount];
+    local->variable = variable;
+    local->depth = -1;
+    local->constant = NULL;
+    scope->localsCount++;
+    return variable;
+}
+
+static void defineLocal(Parser* parser, Variable* variable) {
+    ParseScope* scope = parser->scope;
+    for (int i = scope->localsCount - 1; i >= 0; i--) {
+        if (scope->locals[i].variable == variable) {
+            scope->locals[i].depth = scope->depth;
+            return;
+        }
+    }
+}
+
+static void defineConstant(Parser* parser, Variable* variable, Node* value) {
+    ParseScope* scope = parser->scope;
+    for (int i = scope->localsCount - 1; i >= 0; i--) {
+        if (scope->locals[i].variable == variable) {
+            scope->locals[i].depth = scope->depth;
+            scope->locals[i].constant = value;
+            return;
+        }
+    }
+}
+
+static void startScope(Parser* parser) {
+    parser->scope->depth++;
+}
+
+static void endScope(Parser* parser) {
+    ParseScope* scope = parser->scope;
+    while (scope->localsCount > 0 && scope->locals[scope->localsCount - 1].depth == scope->depth) {
+        scope->localsCount--;
+    }
+    scope->depth--;
+}
+
+static void pushScope(Parser* parser, ParseScope* scope, FunctionNode* function) {
+    scope->enclosing = parser->scope;
+    scope->function = function;
+    scope->depth = 0;
+    scope->localsCount = 0;
+    scope->loopDepth = 0;
+    parser->scope = scope;
+}
+
+static void popScope(Parser* parser) {
+    parser->scope = parser->scope->enclosing;
+}
+
+static Node* numberExpression(Parser* parser) {
+    double val = strtod(parser->current.start, NULL);
+    Node* node = newConstantNode(parser->arena, to_vnumber(val), parser->current.line);
+    advance(parser);
+    return node;
+}
+
+static Node* stringExpression(Parser* parser) {
+    ObjString* string = copyInternedString(parser->collector, parser->current.start + 1, parser->current.length - 2);
+    Node* node = newConstantNode(parser->arena, to_vobj(string), parser->current.line);
+    advance(parser);
+    return node;
+}
+
+static Node* identifierExpression(Parser* parser, int canAssign) {
+    Token identifier = parser->current;
+    advance(parser);
+    Node* constant = resolveConstant(parser, identifier);
+    if (constant != NULL) {
+        if (canAssign && check(parser, TOK_EQUAL))
+            errorAtCurrent(parser, "cannot assign to a constant");
+        return newConstantNode(parser->arena, constant->as.constant, identifier.line);
+    }
+    int uninitialized;
+    Variable* variable = resolveVariable(parser, identifier, &uninitialized);
+    Node* node;
+    if (canAssign && eat(parser, TOK_EQUAL)) {
+        node = newNode(parser->arena, variable != NULL ? NODE_VARIABLE_SET : NODE_GLOBAL_SET, identifier.line);
+        node->as.variable.value = expression(parser);
+        if (variable != NULL)
+            variable->writes++;
+    } else {
+        if (uninitialized)
+            errorAtCurrent(parser, "cannot read local variable in its own initializer");
+        node = newNode(parser->arena, variable != NULL ? NODE_VARIABLE_GET : NODE_GLOBAL_GET, identifier.line);
+        if (variable != NULL)
+            variable->reads++;
+    }
+    node->as.variable.variable = variable;
+    if (variable == NULL) {
+        node->as.variable.name = copyInternedString(parser->collector, identifier.start, identifier.length);
+        recordGlobal(parser, node->as.variable.name, node->type == NODE_GLOBAL_SET ? GLOBAL_ASSIGNED : GLOBAL_READ);
+    }
+    return node;
+}
+
+static Node* basicExpression(Parser* parser, int canAssign) {
+    Node* node = NULL;
+    switch (currentTokenType(parser)) {
+        case TOK_STRING:
+            return stringExpression(parser);
+        case TOK_NUMBER:
+            return numberExpression(parser);
+        case TOK_TRUE:
+            node = newConstantNode(parser->arena, to_vbool(1), parser->current.line);
+            advance(parser);
+            return node;
+        case TOK_FALSE:
+            node = newConstantNode(parser->arena, to_vbool(0), parser->current.line);
+            advance(parser);
+            return node;
+        case TOK_NIHL:
+            node = newConstantNode(parser->arena, to_vnihl(), parser->current.line);
+            advance(parser);
+            return node;
+        case TOK_IDENTIFIER:
+            return identifierExpression(parser, canAssign);
+        default:
+            errorAtCurrent(parser, "unexpected token");
+            return newConstantNode(parser->arena, to_vnihl(), parser->current.line);
+    }
+}
+
+static Node* groupingExpression(Parser* parser) {
+    advance(parser); // skip (
+    Node* node = expression(parser);
+    eatError(parser, TOK_RIGHT_ROUND_BRACKET, "missing ')' after grouping expression");
+    return node;
+}
+
+static Node* arrayExpression(Parser* parser) {
+    Node* node = newNode(parser->arena, NODE_ARRAY, parser->current.line);
+    advance(parser);
+    if (eat(parser, TOK_RIGHT_SQUARE_BRACKET))
+        return node;
+    do {
+        nodeListAdd(parser->arena, &node->as.list, nonCommaExpression(parser));
+    } while (eat(parser, TOK_COMMA));
+    eatError(parser, TOK_RIGHT_SQUARE_BRACKET, "expected \"]\" after array literal");
+    return node;
+}
+
+static Node* dictionaryExpression(Parser* parser) {
+    Node* node = newNode(parser->arena, NODE_DICT, parser->current.line);
+    advance(parser);
+    if (eat(parser, TOK_RIGHT_CURLY_BRACKET))
+        return node;
+    do {
+        nodeListAdd(parser->arena, &node->as.list, nonCommaExpression(parser));
+        eatError(parser, TOK_ARROW, "expected \"=>\" after dictionary key");
+        nodeListAdd(parser->arena, &node->as.list, nonCommaExpression(parser));
+    } while (eat(parser, TOK_COMMA));
+    eatError(parser, TOK_RIGHT_CURLY_BRACKET, "expected \"}\" after dictionary literal");
+    return node;
+}
+
+static Node* primaryExpression(Parser* parser, int canAssign) {
+    switch (currentTokenType(parser)) {
+        case TOK_LEFT_ROUND_BRACKET:
+            return groupingExpression(parser);
+        case TOK_LEFT_SQUARE_BRACKET:
+            return arrayExpression(parser);
+        case TOK_LEFT_CURLY_BRACKET:
+            return dictionaryExpression(parser);
+        default:
+            return basicExpression(parser, canAssign);
+    }
+}
+
+static void argList(Parser* parser, NodeList* arguments) {
+    if (!check(parser, TOK_RIGHT_ROUND_BRACKET)) {
+        do {
+            nodeListAdd(parser->arena, arguments, nonCommaExpression(parser));
+        } while (eat(parser, TOK_COMMA));
+    }
+    eatError(parser, TOK_RIGHT_ROUND_BRACKET, "expect \")\" after function arguments");
+    if (arguments->count >= UINT8_MAX) {
+        errorAtCurrent(parser, "function arguments limit exceeded");
+    }
+}
+
+static Node* callExpression(Parser* parser, int canAssign) {
+    Node* node = primaryExpression(parser, canAssign);
+    while (check(parser, TOK_LEFT_ROUND_BRACKET) || check(parser, TOK_LEFT_SQUARE_BRACKET)) {
+        int line = parser->current.line;
+        advance(parser);
+        if (parser->previous.type == TOK_LEFT_ROUND_BRACKET) {
+            Node* call = newNode(parser->arena, NODE_CALL, line);
+            call->as.call.callee = node;
+            argList(parser, &call->as.call.arguments);
+            node = call;
+        } else {
+            Node* indexing = newNode(parser->arena, NODE_INDEXING_GET, line);
+            indexing->as.indexing.object = node;
+            indexing->as.indexing.key = expression(parser);
+            eatError(parser, TOK_RIGHT_SQUARE_BRACKET, "expected \"]\" after indexing expression");
+            if (canAssign && eat(parser, TOK_EQUAL)) {
+                indexing->type = NODE_INDEXING_SET;
+                indexing->as.indexing.value = expression(parser);
+            }
+            node = indexing;
+        }
+    }
+    return node;
+}
+
+static Node* unaryExpression(Parser* parser, int canAssign) {
+    if (check(parser, TOK_MINUS) || check(parser, TOK_PLUS) || check(parser, TOK_EXCLAMATION_MARK)) {
+        TokenType operator = currentTokenType(parser);
+        int line = parser->current.line;
+        advance(parser);
+        Node* operand = unaryExpression(parser, canAssign);
+        if (operator == TOK_PLUS) // no-op
+            return operand;
+        Node* node = newNode(parser->arena, NODE_UNARY, line);
+        node->as.operation.operator = operator;
+        node->as.operation.left = operand;
+        return node;
+    }
+    return callExpression(parser, canAssign);
+}
+
+static Node* powExpression(Parser* parser, int canAssign) {
+    Node* left = unaryExpression(parser, canAssign);
+    if (check(parser, TOK_CIRCUMFLEX)) {
+        Node* node = newNode(parser->arena, NODE_BINARY, parser->current.line);
+        node->as.operation.operator = currentTokenType(parser);
+        advance(parser);
+        node->as.operation.left = left;
+        node->as.operation.right = powExpression(parser, 0);
+        return node;
+    }
+    return left;
+}
+
+standard_binary_expression(multExpression, powExpression,
+        check(parser, TOK_STAR) || check(parser, TOK_SLASH) || check(parser, TOK_PERCENTAGE))
+
+standard_binary_expression(addExpression, multExpression,
+        check(parser, TOK_PLUS) || check(parser, TOK_MINUS) || check(parser, TOK_PLUS_PLUS))
+
+standard_binary_expression(comparisonExpression, addExpression,
+        check(parser, TOK_LESS) || check(parser, TOK_LESS_EQUAL)
+        || check (parser, TOK_GREATER) || check(parser, TOK_GREATER_EQUAL))
+
+standard_binary_expression(equalExpression, comparisonExpression,
+        check(parser, TOK_EQUAL_EQUAL) || check(parser, TOK_NOT_EQUAL))
+
+static int checkBranchesBoundary(Parser* parser, int branches, char* message) {
+    if (branches >= MAX_BRANCHES) {
+        errorAtCurrent(parser, message);
+        return 0;
+    }
+    return 1;
+}
+
+static Node* andExpression(Parser* parser, int canAssign) {
+    Node* left = equalExpression(parser, canAssign);
+    if (!check(parser, TOK_AND))
+        return left;
+    Node* node = newNode(parser->arena, NODE_AND, parser->current.line);
+    nodeListAdd(parser->arena, &node->as.list, left);
+    while (eat(parser, TOK_AND)) {
+        if (!checkBranchesBoundary(parser, node->as.list.count, "short circuit expression too long"))
+            break;
+        nodeListAdd(parser->arena, &node->as.list, equalExpression(parser, 0));
+    }
+    return node;
+}
+
+static Node* orExpression(Parser* parser, Node* left) {
+    Node* node = newNode(parser->arena, NODE_OR, parser->current.line);
+    nodeListAdd(parser->arena, &node->as.list, left);
+    while (eat(parser, TOK_OR)) {
+        if (!checkBranchesBoundary(parser, node->as.list.count, "short circuit expression too long"))
+            break;
+        nodeListAdd(parser->arena, &node->as.list, andExpression(parser, 0));
+    }
+    return node;
+}
+
+static Node* logicalSumExpression(Parser* parser, int canAssign) {
+    Node* left = andExpression(parser, canAssign);
+    while (check(parser, TOK_OR) || check(parser, TOK_XOR)) {
+        if (check(parser, TOK_XOR)) {
+            Node* node = newNode(parser->arena, NODE_BINARY, parser->current.line);
+            node->as.operation.operator = TOK_XOR;
+            advance(parser);
+            node->as.operation.left = left;
+            node->as.operation.right = andExpression(parser, 0);
+            left = node;
+        } else {
+            left = orExpression(parser, left);
+        }
+    }
+    return left;
+}
+
+static Node* ternaryExpression(Parser* parser, int canAssign) {
+    Node* condition = logicalSumExpression(parser, canAssign);
+    if (!check(parser, TOK_QUESTION_MARK))
+        return condition;
+    Node* node = newNode(parser->arena, NODE_TERNARY, parser->current.line);
+    advance(parser);
+    node->as.branch.condition = condition;
+    node->as.branch.then = expression(parser);
+    eatError(parser, TOK_COLON, "expected \":\" inside ternary expression");
+    node->as.branch.otherwise = expression(parser);
+    return node;
+}
+
+static Node* nonCommaExpression(Parser* parser) {
+    return ternaryExpression(parser, 1);
+}
+
+static Node* commaExpression(Parser* parser) {
+    Node* first = nonCommaExpression(parser);
+    if (!check(parser, TOK_COMMA))
+        return first;
+    Node* node = newNode(parser->arena, NODE_COMMA, parser->current.line);
+    nodeListAdd(parser->arena, &node->as.list, first);
+    while (eat(parser, TOK_COMMA)) {
+        nodeListAdd(parser->arena, &node->as.list, nonCommaExpression(parser));
+    }
+    return node;
+}
+
+static Node* expression(Parser* parser) {
+    return commaExpression(parser);
+}
+
+static void block(Parser* parser, NodeList* statements) {
+    while (currentTokenType(parser) != TOK_EOF && currentTokenType(parser) != TOK_DEDENT) {
+        nodeListAdd(parser->arena, statements, statement(parser));
+    }
+    eatError(parser, TOK_DEDENT, "missing dedent to close block");
+}
+
+static Node* blockStat(Parser* parser) {
+    Node* node = newNode(parser->arena, NODE_BLOCK, parser->current.line);
+    advance(parser);
+    startScope(parser);
+    block(parser, &node->as.list);
+    endScope(parser);
+    return node;
+}
+
+static Node* expressionStat(Parser* parser) {
+    Node* node = newNode(parser->arena, NODE_EXPRESSION_STAT, parser->current.line);
+    node->as.expression = expression(parser);
+    eatError(parser, TOK_NEW_LINE, "expected new line at end of statement");
+    return node;
+}
+
+static Node* printStat(Parser* parser) {
+    Node* node = newNode(parser->arena, NODE_PRINT, parser->current.line);
+    advance(parser); // skip 'print'
+    node->as.expression = expression(parser);
+    eatError(parser, TOK_NEW_LINE, "expected new line at end of statement");
+    return node;
+}
+
+static Node* letTarget(Parser* parser, char* message) {
+    eatError(parser, TOK_IDENTIFIER, message);
+    Token identifier = parser->previous;
+    Node* node = newNode(parser->arena, NODE_LET, identifier.line);
+    if (parser->scope->depth > 0) {
+        node->as.variable.variable = declareLocal(parser, identifier);
+    } else {
+        if (isGlobalConstant(parser, identifier))
+            errorAtCurrent(parser, "constant with this name already declared");
+        node->as.variable.name = copyInternedString(parser->collector, identifier.start, identifier.length);
+        recordGlobal(parser, node->as.variable.name, GLOBAL_DECLARED);
+    }
+    return node;
+}
+
+// let a, b = f(): the call leaves one value for each variable, which the variables take in order
+static Node* unpackStat(Parser* parser, Node* first) {
+    Node* node = newNode(parser->arena, NODE_UNPACK, first->line);
+    NodeList* targets = &node->as.unpack.targets;
+    nodeListAdd(parser->arena, targets, first);
+    while (eat(parser, TOK_COMMA)) {
+        if (targets->count >= UINT8_MAX) {
+            errorAtCurrent(parser, "too many variables in let");
+            break;
+        }
+        nodeListAdd(parser->arena, targets, letTarget(parser, "expected identifier after \",\""));
+    }
+    eatError(parser, TOK_EQUAL, "expected \"=\" after the variables of let");
+    Token start = parser->current;
+    Node* call = expression(parser);
+    if (call->type != NODE_CALL)
+        error(parser, start, "let with several variables must be initialized by a function call");
+    else
+        call->as.call.unpacked = targets->count;
+    node->as.unpack.call = call;
+    if (parser->scope->depth > 0) {
+        for (int i = 0; i < targets->count; i++) {
+            defineLocal(parser, targets->nodes[i]->as.variable.variable);
+        }
+    }
+    eatError(parser, TOK_NEW_LINE, "expected new line at end of statement");
+    return node;
+}
+
+static Node* letStat(Parser* parser) {
+    advance(parser); // skip 'let'
+    Node* node = letTarget(parser, "expected identifier after \"let\"");
+    if (check(parser, TOK_COMMA))
+        return unpackStat(parser, node);
+    if (eat(parser, TOK_EQUAL)) {
+        node->as.variable.value = expression(parser);
+    }
+    if (parser->scope->depth > 0) {
+        defineLocal(parser, node->as.variable.variable);
+    }
+    eatError(parser, TOK_NEW_LINE, "expected new line at end of statement");
+    return node;
+}
+
+// local consts leave no trace in the tree: an empty block takes their place. Global ones are also declared
+// as globals, for the functions compiled before them that read them
+static Node* constStat(Parser* parser) {
+    Node* node = newNode(parser->arena, NODE_BLOCK, parser->current.line);
+    advance(parser); // skip 'const'
+    eatError(parser, TOK_IDENTIFIER, "expected identifier after \"const\"");
+    Token identifier = parser->previous;
+    Variable* variable = NULL;
+    ObjString* name = NULL;
+    if (parser->scope->depth > 0) {
+        variable = declareLocal(parser, identifier);
+    } else {
+        name = copyInternedString(parser->collector, identifier.start, identifier.length);
+        Value use = to_vnumber(GLOBAL_READ);
+        mapGet(&parser->globals, to_vobj(name), &use);
+        if (isGlobalConstant(parser, identifier))
+            errorAtCurrent(parser, "constant with this name already declared");
+        else if (as_cnumber(use) == GLOBAL_DECLARED)
+            error(parser, identifier, "global variable with this name already declared");
+        else if (as_cnumber(use) == GLOBAL_ASSIGNED)
+            error(parser, identifier, "cannot assign to a constant");
+    }
+    eatError(parser, TOK_EQUAL, "expected \"=\" after constant name");
+    Node* initializer = expression(parser);
+    Value value = to_vnihl();
+    if (!foldConstant(parser->collector, initializer, &value))
+        error(parser, identifier, "constant initializer must only use literals and other constants");
+    if (variable != NULL) {
+        defineConstant(parser, variable, newConstantNode(parser->arena, value, identifier.line));
+    } else {
+        mapPut(parser->collector, &parser->constants, to_vobj(name), value);
+        node->type = NODE_LET;
+        node->as.variable.name = name;
+        node->as.variable.value = newConstantNode(parser->arena, value, identifier.line);
+    }
+    eatError(parser, TOK_NEW_LINE, "expected new line at end of statement");
+    return node;
+}
+
+static Node* functionDeclaration(Parser* parser, Token name) {
+    ParseScope scope;
+    ObjString* strname = copyInternedString(parser->collector, name.start, name.length);
+    FunctionNode* function = newFunctionNode(parser->arena, strname, parser->scope->function, name.line);
+    Node* node = newNode(parser->arena, NODE_FUNCTION, name.line);
+    node->as.function = function;
+    pushScope(parser, &scope, function);
+    startScope(parser);
+    eatError(parser, TOK_LEFT_ROUND_BRACKET, "expected \"(\" before function parameters");
+    if (!check(parser, TOK_RIGHT_ROUND_BRACKET)) {
+        do {
+            if (function->arity + 1 >= UINT8_MAX)
+                errorAtCurrent(parser, "maximum number of function parameters exceeded");
+            eatError(parser, TOK_IDENTIFIER, "expected identifier inside function's \"()\"");
+            Variable* parameter = declareLocal(parser, parser->previous);
+            defineLocal(parser, parameter);
+            addParameter(parser->arena, function, parameter);
+        } while (eat(parser, TOK_COMMA));
+    }
+    eatError(parser, TOK_RIGHT_ROUND_BRACKET, "expected \")\" after function parameters");
+    eatError(parser, TOK_NEW_LINE, "expected new line after function parameters");
+    if (!check(parser, TOK_INDENT))
+        errorAtCurrent(parser, "expected indent after function parameters");
+    advance(parser);
+    block(parser, &function->body);
+    popScope(parser);
+    return node;
+}
+
+static Node* funcStat(Parser* parser) {
+    advance(parser); // skip 'func'
+    eatError(parser, TOK_IDENTIFIER, "expected function name after \"func\"");
+    Token identifier = parser->previous;
+    Node* node = newNode(parser->arena, NODE_LET, identifier.line);
+
+    if (parser->scope->depth > 0) {
+        node->as.variable.variable = declareLocal(parser, identifier);
+        defineLocal(parser, node->as.variable.variable);
+    } else {
+        if (isGlobalConstant(parser, identifier))
+            errorAtCurrent(parser, "constant with this name already declared");
+        node->as.variable.name = copyInternedString(parser->collector, identifier.start, identifier.length);
+        recordGlobal(parser, node->as.variable.name, GLOBAL_DECLARED);
+    }
+    node->as.variable.value = functionDeclaration(parser, identifier);
+    return node;
+}
+
+static Node* conditionalBranch(Parser* parser, char* newLineMessage, char* indentMessage) {
+    Node* node = newNode(parser->arena, NODE_IF, parser->current.line);
+    node->as.branch.condition = expression(parser);
+    eatError(parser, TOK_NEW_LINE, newLineMessage);
+    if (!check(parser, TOK_INDENT))
+        errorAtCurrent(parser, indentMessage);
+    node->as.branch.then = blockStat(parser);
+    return node;
+}
+
+static Node* ifStat(Parser* parser) {
+    advance(parser); // skip if
+    Node* node = conditionalBranch(parser, "expected new line after if condition", "expect indent after if");
+    Node* last = node;
+    int branches = 1;
+
+    while (eat(parser, TOK_ELIF)) {
+        if (!checkBranchesBoundary(parser, branches++, "too many elifs"))
+            return node;
+        last->as.branch.otherwise = conditionalBranch(parser, "expected new line after elif condition", "expect indent after elif");
+        last = last->as.branch.otherwise;
+    }
+
+    if (eat(parser, TOK_ELSE)) {
+        eatError(parser, TOK_NEW_LINE, "expected new line after else");
+        if (!check(parser, TOK_INDENT))
+            errorAtCurrent(parser, "expect indent after else");
+        last->as.branch.otherwise = blockStat(parser);
+    }
+    return node;
+}
+
+static Node* whileStat(Parser* parser) {
+    Node* node = newNode(parser->arena, NODE_WHILE, parser->current.line);
+    parser->scope->loopDepth++;
+    advance(parser); // skip while
+    node->as.branch.condition = expression(parser);
+    eatError(parser, TOK_NEW_LINE, "expected new line after while condition");
+    if (!check(parser, TOK_INDENT))
+        errorAtCurrent(parser, "expect indent after while");
+    node->as.branch.then = blockStat(parser);
+    parser->scope->loopDepth--;
+    return node;
+}
+
+// contextual keywords are identifiers everywhere else
+static int checkWord(Parser* parser, char* word) {
+    int length = (int) strlen(word);
+    return check(parser, TOK_IDENTIFIER) && parser->current.length == length
+        && memcmp(parser->current.start, word, length) == 0;
+}
+
+// the loop variables are declared in a scope of their own, after the header: its expressions cannot read them.
+// A header without ".." iterates over a container, optionally binding the key of each element too
+static Node* forStat(Parser* parser) {
+    Node* node = newNode(parser->arena, NODE_FOR_RANGE, parser->current.line);
+    advance(parser); // skip for
+    eatError(parser, TOK_IDENTIFIER, "expected identifier after \"for\"");
+    Token identifier = parser->previous;
+    Token key = identifier;
+    int hasKey = eat(parser, TOK_COMMA);
+    if (hasKey) {
+        key = identifier;
+        eatError(parser, TOK_IDENTIFIER, "expected identifier after \",\"");
+        identifier = parser->previous;
+    }
+    if (!checkWord(parser, "in"))
+        errorAtCurrent(parser, "expected \"in\" after loop variable");
+    advance(parser);
+    node->as.loop.start = nonCommaExpression(parser);
+    if (hasKey || !check(parser, TOK_DOT_DOT)) {
+        node->type = NODE_FOR_EACH;
+    } else {
+        advance(parser); // skip ..
+        node->as.loop.end = nonCommaExpression(parser);
+        if (checkWord(parser, "step")) {
+            advance(parser);
+            node->as.loop.step = nonCommaExpression(parser);
+        }
+    }
+    eatError(parser, TOK_NEW_LINE, "expected new line after for header");
+    if (!check(parser, TOK_INDENT))
+        errorAtCurrent(parser, "expect indent after for");
+    startScope(parser);
+    if (hasKey) {
+        node->as.loop.key = declareLocal(parser, key);
+        defineLocal(parser, node->as.loop.key);
+    }
+    node->as.loop.variable = declareLocal(parser, identifier);
+    defineLocal(parser, node->as.loop.variable);
+    parser->scope->loopDepth++;
+    node->as.loop.body = blockStat(parser);
+    parser->scope->loopDepth--;
+    endScope(parser);
+    return node;
+}
+
+static Node* loopSkipStat(Parser* parser, NodeType type, char* outsideMessage, char* newLineMessage) {
+    Node* node = newNode(parser->arena, type, parser->current.line);
+    if (parser->scope->loopDepth <= 0) {
+        errorAtCurrent(parser, outsideMessage);
+        advance(parser);
+        return node;
+    }
+    advance(parser); // skip break or continue
+    eatError(parser, TOK_NEW_LINE, newLineMessage);
+    return node;
+}
+
+static Node* retStat(Parser* parser) {
+    Node* node = newNode(parser->arena, NODE_RET, parser->current.line);
+    advance(parser);
+    if (!check(parser, TOK_NEW_LINE) && !check(parser, TOK_EOF)) {
+        do {
+            nodeListAdd(parser->arena, &node->as.list, nonCommaExpression(parser));
+        } while (eat(parser, TOK_COMMA));
+        if (node->as.list.count > UINT8_MAX)
+            errorAtCurrent(parser, "too many values in ret");
+    }
+    if (!check(parser, TOK_NEW_LINE) && !check(parser, TOK_EOF))
+        errorAtCurrent(parser, "unexpected token after ret statement");
+    else
+        advance(parser);
+    return node;
+}
+
+static Node* caseArm(Parser* parser, HashMap* seen) {
+    Node* node = newNode(parser->arena, NODE_CASE, parser->current.line);
+    advance(parser); // skip case
+    do {
+        Token start = parser->current;
+        Node* value = nonCommaExpression(parser);
+        Value constant = to_vnihl();
+        if (!foldConstant(parser->collector, value, &constant)) {
+            error(parser, start, "case values must only use literals and constants");
+        } else if (mapPut(parser->collector, seen, constant, to_vnihl())) {
+            error(parser, start, "duplicate case value");
+        }
+        nodeListAdd(parser->arena, &node->as.arm.values, newConstantNode(parser->arena, constant, value->line));
+    } while (eat(parser, TOK_COMMA));
+    eatError(parser, TOK_NEW_LINE, "expected new line after case values");
+    if (!check(parser, TOK_INDENT))
+        errorAtCurrent(parser, "expect indent after case");
+    node->as.arm.body = blockStat(parser);
+    return node;
+}
+
+// cases are contextual keywords, only recognized at the start of the arms of a match
+static Node* matchStat(Parser* parser) {
+    Node* node = newNode(parser->arena, NODE_MATCH, parser->current.line);
+    advance(parser); // skip match
+    node->as.match.subject = expression(parser);
+    eatError(parser, TOK_NEW_LINE, "expected new line after match subject");
+    eatError(parser, TOK_INDENT, "expect indent after match");
+    HashMap seen;
+    initMap(&seen);
+    while (checkWord(parser, "case")) {
+        if (node->as.match.arms.count >= MAX_MATCH_ARMS) {
+            errorAtCurrent(parser, "too many cases in match");
+            break;
+        }
+        nodeListAdd(parser->arena, &node->as.match.arms, caseArm(parser, &seen));
+    }
+    freeMap(parser->collector, &seen);
+    if (node->as.match.arms.count == 0)
+        errorAtCurrent(parser, "expected \"case\" after match");
+    if (eat(parser, TOK_ELSE)) {
+        eatError(parser, TOK_NEW_LINE, "expected new line after else");
+        if (!check(parser, TOK_INDENT))
+            errorAtCurrent(parser, "expect indent after else");
+        node->as.match.otherwise = blockStat(parser);
+    }
+    eatError(parser, TOK_DEDENT, "expected \"case\" or \"else\" in match");
+    return node;
+}
+
+// any function yielding is a generator
+static Node* yieldStat(Parser* parser) {
+    Node* node = newNode(parser->arena, NODE_YIELD, parser->current.line);
+    if (parser->scope->enclosing == NULL)
+        errorAtCurrent(parser, "cannot yield outside of a function");
+    parser->scope->function->isGenerator = 1;
+    advance(parser); // skip yield
+    node->as.expression = expression(parser);
+    eatError(parser, TOK_NEW_LINE, "expected new line at end of statement");
+    return node;
+}
+
+static Node* statement(Parser* parser) {
+    switch (currentTokenType(parser)) {
+        case TOK_LET:
+            return letStat(parser);
+        case TOK_CONST:
+            return constStat(parser);
+        case TOK_PRINT:
+            return printStat(parser);
+        case TOK_YIELD:
+            return yieldStat(parser);
+        case TOK_MATCH:
+            return matchStat(parser);
+        case TOK_INDENT:
+            return blockStat(parser);
+        case TOK_IF:
+            return ifStat(parser);
+        case TOK_WHILE:
+            return whileStat(parser);
+        case TOK_FOR:
+            return forStat(parser);
+        case TOK_FUNC:
+            return funcStat(parser);
+        case TOK_RET:
+            return retStat(parser);
+        case TOK_BREAK:
+            return loopSkipStat(parser, NODE_BREAK, "cannot use \"break\" outside of a loop", "expected new line after \"break\"");
+        case TOK_CONTINUE:
+            return loopSkipStat(parser, NODE_CONTINUE, "cannot use \"continue\" outside of a loop", "expected new line after \"continue\"");
+        default:
+            return expressionStat(parser);
+    }
+}
+
+int parse(Parser* parser, Collector* collector, char* source, Ast* ast) {
+    parser->hadError = 0;
+    parser->panic = 0;
+    parser->collector = collector;
+    parser->arena = &ast->arena;
+    parser->scope = NULL;
+    initMap(&parser->constants);
+    initMap(&parser->globals);
+    initLexer(&parser->lexer, source);
+    ast->main = newFunctionNode(parser->arena, NULL, NULL, 1);
+    ParseScope scope;
+    pushScope(parser, &scope, ast->main);
+
+    advance(parser);
+    while (!check(parser, TOK_EOF)) {
+        nodeListAdd(parser->arena, &ast->main->body, statement(parser));
+    }
+    popScope(parser);
+    freeLexer(&parser->lexer);
+    freeMap(collector, &parser->constants);
+    freeMap(collector, &parser->globals);
+    return !parser->hadError;
+}
@@ -0,0 +1,48 @@
+#ifndef parser_h
+#define parser_h
+
+#include "../memory.h"
+#include "lexer.h"
+#include "ast.h"
+#include "../datastructs/hash_map.h"
+
+#define MAX_LOCALS 700
+
+typedef struct {
+    Variable* variable;
+    int depth; // -1 while its initializer is parsed
+    Node* constant; // value of a const, NULL for variables
+} ParseLocal;
+
+// names visible while parsing a function: identifiers are bound to their variable as soon as they are read
+struct sParseScope {
+    struct sParseScope* enclosing;
+    FunctionNode* function;
+    int depth;
+    ParseLocal locals[MAX_LOCALS];
+    int localsCount;
+    int loopDepth;
+};
+
+typedef struct sParseScope ParseScope;
+
+#define GLOBAL_READ 0
+#define GLOBAL_ASSIGNED 1
+#define GLOBAL_DECLARED 2
+
+typedef struct {
+    Lexer lexer;
+    Token current;
+    Token previous;
+    Collector* collector;
+    Arena* arena;
+    int hadError;
+    int panic;
+    ParseScope* scope;
+    HashMap constants; // consts declared by the main code: name => value
+    HashMap globals; // globals used so far: name => GLOBAL_READ, GLOBAL_ASSIGNED or GLOBAL_DECLARED
+} Parser;
+
+int parse(Parser* parser, Collector* collector, char* source, Ast* ast);
+
+#endif
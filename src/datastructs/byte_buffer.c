@@ -0,0 +1,36 @@
+#include <string.h>
+
+#include "byte_buffer.h"
+#include "../memory.h"
+
+void initByteBuffer(ByteBuffer* buffer) {
+    buffer->bytes = NULL;
+    buffer->count = 0;
+    buffer->capacity = 0;
+}
+
+void freeByteBuffer(ByteBuffer* buffer) {
+    free_array(NULL, char, buffer->bytes, buffer->capacity);
+    initByteBuffer(buffer);
+}
+
+void reserveByteBuffer(ByteBuffer* buffer, int additional) {
+    if (buffer->count + additional <= buffer->capacity)
+        return;
+    int newcap = buffer->capacity;
+    while (newcap < buffer->count + additional) {
+        newcap = compute_capacity(newcap);
+    }
+    buffer->bytes = grow_array(NULL, char, buffer->bytes, buffer->capacity, newcap);
+    buffer->capacity = newcap;
+}
+
+void writeBytes(ByteBuffer* buffer, const char* bytes, int length) {
+    reserveByteBuffer(buffer, length);
+    memcpy(buffer->bytes + buffer->count, bytes, length);
+    buffer->count += length;
+}
+
+void writeCString(ByteBuffer* buffer, const char* string) {
+    writeBytes(buffer, string, strlen(string));
+}
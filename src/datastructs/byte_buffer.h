@@ -0,0 +1,18 @@
+#ifndef byte_buffer_h
+#define byte_buffer_h
+
+// growable byte buffer used to build text; it lives outside the collector,
+// so writing to it never triggers a collection
+typedef struct {
+    char* bytes;
+    int count;
+    int capacity;
+} ByteBuffer;
+
+void initByteBuffer(ByteBuffer* buffer);
+void freeByteBuffer(ByteBuffer* buffer);
+void reserveByteBuffer(ByteBuffer* buffer, int additional);
+void writeBytes(ByteBuffer* buffer, const char* bytes, int length);
+void writeCString(ByteBuffer* buffer, const char* string);
+
+#endif
@@ -1,6 +1,10 @@
+#include <math.h>
+
 #include "bytecode.h"
+#include "hash_map.h"
 #include "../util.h"
 #include "../memory.h"
+#include "shape.h"
 
 void initBytecode(struct sBytecode* bytecode) {
     bytecode->count = 0;
@@ -8,6 +12,9 @@ void initBytecode(struct sBytecode* bytecode) {
     bytecode->code = NULL;
     initValueArray(&bytecode->constants); 
     initLineArray(&bytecode->lines);
+    bytecode->caches = NULL;
+    bytecode->cacheCount = 0;
+    bytecode->cacheCapacity = 0;
 }
 
 int writeBytecode(Collector* collector, struct sBytecode* bytecode, uint8_t byte, int line) {
@@ -25,6 +32,7 @@ void freeBytecode(Collector* collector, struct sBytecode* bytecode) {
     free_array(collector, uint8_t, bytecode->code, bytecode->capacity);
     freeValueArray(collector, &bytecode->constants);
     freeLineArray(collector, &bytecode->lines);
+    free_array(collector, InlineCache, bytecode->caches, bytecode->cacheCapacity);
     initBytecode(bytecode);
 }
 
@@ -41,14 +49,57 @@ int writeVariableSizeOp(Collector* collector, struct sBytecode* bytecode, OpCode
     return bytecode->count - 1;
 }
 
-int writeAddressableInstruction(Collector* collector, struct sBytecode* bytecode, OpCode oplong, OpCode opshort, Value val, int line) {
+// only values whose identity cannot be observed may share an entry: -0 equals 0 but does not behave like it
+static int shareableConstant(Value val) {
+    if (is_number(val))
+        return !(as_cnumber(val) == 0 && signbit(as_cnumber(val)));
+    return !is_obj(val) || is_string(val);
+}
+
+// address of val inside the constant pool, reusing an equal constant found in indices (when not NULL)
+int addConstant(Collector* collector, struct sBytecode* bytecode, HashMap* indices, Value val) {
+    Value address;
+    int shareable = indices != NULL && shareableConstant(val);
+    if (shareable && mapGet(indices, val, &address))
+        return (int) as_cnumber(address);
+    int index = writeValueArray(collector, &bytecode->constants, val);
+    if (shareable)
+        mapPut(collector, indices, val, to_vnumber(index));
+    return index;
+}
+
+int writeAddressableInstruction(Collector* collector, struct sBytecode* bytecode, HashMap* indices, OpCode oplong, OpCode opshort, Value val, int line) {
     pushSafe(collector, val);
-    uint16_t address = (uint16_t) writeValueArray(collector, &bytecode->constants, val);
+    uint16_t address = (uint16_t) addConstant(collector, bytecode, indices, val);
     int result = writeVariableSizeOp(collector, bytecode, oplong, opshort, address, line);
     popSafe(collector);
     return result;
 }
 
+int addInlineCache(Collector* collector, struct sBytecode* bytecode) {
+    if (bytecode->cacheCount + 1 > bytecode->cacheCapacity) {
+        int newcap = compute_capacity(bytecode->cacheCapacity);
+        bytecode->caches = grow_array(collector, InlineCache, bytecode->caches, bytecode->cacheCapacity, newcap);
+        bytecode->cacheCapacity = newcap;
+    }
+    InlineCache* cache = &bytecode->caches[bytecode->cacheCount];
+    cache->shape = NULL;
+    cache->slot = -1;
+    cache->transition = NULL;
+    return bytecode->cacheCount++;
+}
+
+// drops every byte from count onwards (used to rewrite just emitted instructions)
+void truncateBytecode(struct sBytecode* bytecode, int count) {
+    truncateLineArray(&bytecode->lines, bytecode->count - count);
+    bytecode->count = count;
+}
+
 void markBytecode(Collector* collector, struct sBytecode* bytecode) {
     markValueArray(collector, &bytecode->constants);
+    // cached shapes are kept alive so that their address cannot be reused by another shape
+    for (int i = 0; i < bytecode->cacheCount; i++) {
+        markShape(collector, bytecode->caches[i].shape);
+        markShape(collector, bytecode->caches[i].transition);
+    }
 }
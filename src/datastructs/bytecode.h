@@ -6,7 +6,7 @@
 #include "line_array.h"
 
 typedef enum {
-    OP_RET,
+    OP_RET, // moves the values it returns, counted by its argument, where the called function was
     OP_CONST,
     OP_CONST_LONG,
     OP_NEGATE,
@@ -43,10 +43,14 @@ typedef enum {
     OP_JUMP_IF_TRUE,
     OP_JUMP,
     OP_JUMP_BACK,
+    OP_JUMP_TABLE, // pops the subject of a match with dense integer cases, jumping through a table of offsets
+    OP_JUMP_HASH, // pops the subject of a match, jumping to the offset a constant dict maps it to
     OP_XOR,
-    OP_CALL,
+    OP_CALL, // arguments: the count of arguments and of the values the caller takes back
     OP_INDEXING_GET,
     OP_INDEXING_SET,
+    OP_INDEXING_GET_STR,
+    OP_INDEXING_SET_STR,
     OP_CLOSURE,
     OP_CLOSURE_LONG,
     OP_UPVALUE_GET,
@@ -58,21 +62,47 @@ typedef enum {
     OP_ARRAY_LONG,
     OP_DICT,
     OP_DICT_LONG,
+    // operands proven to be numbers at compile time: no type checks
+    OP_ADD_NUM,
+    OP_SUB_NUM,
+    OP_MUL_NUM,
+    OP_LESS_NUM,
+    OP_LESS_EQUAL_NUM,
+    OP_GREATER_NUM,
+    OP_GREATER_EQUAL_NUM,
+    OP_LOCAL_INCREMENT, // adds a constant to a local holding a number and pushes the result
+    OP_FOR_PREP, // checks the counter, bound and step of a range loop, skips it when empty
+    OP_FOR_RANGE, // steps a range loop, jumping back to its body while the counter is in range
+    OP_ITER_PREP, // checks the container of a for each loop, jumps to its OP_ITER_NEXT
+    OP_ITER_NEXT, // moves the key and value of the next element to the loop variables, jumping back to the body
+    OP_YIELD, // suspends the running generator, handing its value to the for each loop resuming it
 } OpCode;
 
+typedef struct {
+    Shape* shape;
+    int slot;
+    Shape* transition; // not NULL when caching the addition of a key to shape
+} InlineCache;
+
 struct sBytecode {
     int count;
     int capacity;
     uint8_t* code;
     ValueArray constants;
     LineArray lines;
+    InlineCache* caches;
+    int cacheCount;
+    int cacheCapacity;
 };
 
 void initBytecode(struct sBytecode* bytecode);
 int writeBytecode(Collector* collector, struct sBytecode* bytecode, uint8_t byte, int line);
 void freeBytecode(Collector* collector, struct sBytecode* bytecode);
 int writeVariableSizeOp(Collector* collector, struct sBytecode* bytecode, OpCode oplong, OpCode opshort, uint16_t argument, int line);
-int writeAddressableInstruction(Collector* collector, struct sBytecode* bytecode, OpCode oplong, OpCode opshort, Value val, int line);
+int addConstant(Collector* collector, struct sBytecode* bytecode, HashMap* indices, Value val);
+int writeAddressableInstruction(Collector* collector, struct sBytecode* bytecode, HashMap* indices, OpCode oplong, OpCode opshort, Value val, int line);
+int addInlineCache(Collector* collector, struct sBytecode* bytecode);
+void truncateBytecode(struct sBytecode* bytecode, int count);
 void markBytecode(Collector* collector, struct sBytecode* bytecode);
 
 #endif
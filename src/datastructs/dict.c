@@ -0,0 +1,161 @@
+#include "dict.h"
+#include "shape.h"
+#include "../memory.h"
+
+// index of key inside a DICT_ARRAY dictionary's values, or -1 if key is not a valid slot
+static int denseIndex(Value key, int limit) {
+    if (!is_number(key))
+        return -1;
+    double n = as_cnumber(key);
+    if (!(n >= 0 && n <= limit) || n != (double) (int) n)
+        return -1;
+    return (int) n;
+}
+
+static Value slotKey(ObjDict* dict, int slot) {
+    return dict->kind == DICT_ARRAY ? to_vnumber(slot) : to_vobj(dict->shape->keys[slot]);
+}
+
+static void convertToMap(Collector* collector, ObjDict* dict) {
+    HashMap* map = allocate_pointer(collector, HashMap, sizeof(HashMap));
+    initMap(map);
+    // values (and shape keys) stay reachable through dict until the switch below
+    for (int i = 0; i < dict->values->count; i++) {
+        mapPut(collector, map, slotKey(dict, i), dict->values->values[i]);
+    }
+    freeValueArray(collector, dict->values);
+    free_pointer(collector, dict->values, sizeof(ValueArray));
+    dict->values = NULL;
+    dict->shape = NULL;
+    dict->map = map;
+    dict->kind = DICT_MAP;
+}
+
+// a dictionary that hashes its keys from the start, for lookups that must not scan
+ObjDict* newHashedDict(Collector* collector) {
+    ObjDict* dict = newDict(collector);
+    pushSafeObj(collector, dict);
+    convertToMap(collector, dict);
+    popSafe(collector);
+    return dict;
+}
+
+static int putKey(Collector* collector, ObjDict* dict, Value key, Value value) {
+    if (dict->kind == DICT_ARRAY) {
+        ValueArray* values = dict->values;
+        int index = denseIndex(key, values->count);
+        if (index >= 0 && index < values->count) {
+            values->values[index] = value;
+            return 1;
+        }
+        if (index == values->count) {
+            writeValueArray(collector, values, value);
+            return 0;
+        }
+        if (values->count == 0 && is_string(key)) {
+            dict->kind = DICT_SHAPED;
+            dict->shape = collector->rootShape;
+        } else {
+            // key would leave a hole (or is not a number): fall back to hashing
+            convertToMap(collector, dict);
+        }
+    }
+    if (dict->kind == DICT_SHAPED) {
+        if (is_string(key)) {
+            int slot = shapeSlot(dict->shape, as_string(key));
+            if (slot >= 0) {
+                dict->values->values[slot] = value;
+                return 1;
+            }
+            if (dict->shape->slotCount < SHAPE_MAX_SLOTS) {
+                writeValueArray(collector, dict->values, value);
+                dict->shape = shapeTransition(collector, dict->shape, as_string(key));
+                return 0;
+            }
+        }
+        convertToMap(collector, dict);
+    }
+    return mapPut(collector, dict->map, key, value);
+}
+
+int dictPut(Collector* collector, ObjDict* dict, Value key, Value value) {
+    // keys are stored interned: shapes compare them by pointer. The interned copy may be referenced by
+    // nothing else, so it stays safe until the dict holds it
+    if (is_string(key))
+        key = to_vobj(internString(collector, as_string(key)));
+    pushSafe(collector, key);
+    int existed = putKey(collector, dict, key, value);
+    popSafe(collector);
+    return existed;
+}
+
+int dictGet(ObjDict* dict, Value key, Value* result) {
+    switch (dict->kind) {
+        case DICT_ARRAY:
+            {
+                int index = denseIndex(key, dict->values->count - 1);
+                if (index < 0)
+                    return 0;
+                *result = dict->values->values[index];
+                return 1;
+            }
+        case DICT_SHAPED:
+            {
+                if (!is_string(key))
+                    return 0;
+                ObjString* string = as_string(key);
+                int slot = string->interned ? shapeSlot(dict->shape, string) : shapeSlotByContent(dict->shape, string);
+                if (slot < 0)
+                    return 0;
+                *result = dict->values->values[slot];
+                return 1;
+            }
+        default:
+            return mapGet(dict->map, key, result);
+    }
+}
+
+int dictCount(ObjDict* dict) {
+    return dict->kind == DICT_MAP ? dict->map->count : dict->values->count;
+}
+
+// iterates over live entries in insertion order: cursor must start at 0
+int dictNext(ObjDict* dict, int* cursor, Value* key, Value* value) {
+    if (dict->kind != DICT_MAP) {
+        if (*cursor >= dict->values->count)
+            return 0;
+        *key = slotKey(dict, *cursor);
+        *value = dict->values->values[*cursor];
+        (*cursor)++;
+        return 1;
+    }
+    HashMap* map = dict->map;
+    while (*cursor < map->entriesCount) {
+        Entry* entry = &map->entries[(*cursor)++];
+        if (entry_is_deleted(entry))
+            continue;
+        *key = entry->key;
+        *value = entry->value;
+        return 1;
+    }
+    return 0;
+}
+
+void markDict(Collector* collector, ObjDict* dict) {
+    if (dict->kind == DICT_MAP) {
+        markMap(collector, dict->map);
+    } else {
+        markValueArray(collector, dict->values);
+        markShape(collector, dict->shape);
+    }
+}
+
+void freeDict(Collector* collector, ObjDict* dict) {
+    if (dict->kind != DICT_MAP) {
+        freeValueArray(collector, dict->values);
+        free_pointer(collector, dict->values, sizeof(ValueArray));
+    } else {
+        freeMap(collector, dict->map);
+        free_pointer(collector, dict->map, sizeof(HashMap));
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef dict_h
+#define dict_h
+
+#include "value.h"
+#include "hash_map.h"
+#include "../commontypes.h"
+
+ObjDict* newHashedDict(Collector* collector);
+int dictPut(Collector* collector, ObjDict* dict, Value key, Value value);
+int dictGet(ObjDict* dict, Value key, Value* result);
+int dictCount(ObjDict* dict);
+int dictNext(ObjDict* dict, int* cursor, Value* key, Value* value);
+void markDict(Collector* collector, ObjDict* dict);
+void freeDict(Collector* collector, ObjDict* dict);
+
+#endif
@@ -6,177 +6,173 @@
 #include "../util.h"
 #include "../debug/debug_switches.h"
 
-#define LOAD_FACTOR 0.65 
+#define LOAD_FACTOR 0.65
+#define MIN_CAPACITY 8
+#define INDEX_EMPTY (-1)
+#define INDEX_DUMMY (-2)
 #define get_index(hash, capacity) ((hash) & ((capacity) - 1))
+#define usable_entries(capacity) ((int) ((capacity) * LOAD_FACTOR))
+
+static inline size_t indexWidth(int capacity) {
+    if (capacity <= INT8_MAX + 1)
+        return sizeof(int8_t);
+    if (capacity <= INT16_MAX + 1)
+        return sizeof(int16_t);
+    return sizeof(int32_t);
+}
 
-static void freeEntries(Collector* collector, Entry** entries, int capacity) {
-    for (int i = 0; i < capacity; i++) {
-        Entry* entry = entries[i];
-        while (entry != NULL) {
-            Entry* toFree = entry;
-            entry = entry->next;
-            free_pointer(collector, toFree, sizeof(Entry));
-        }
+static inline int readIndex(void* indices, int capacity, int slot) {
+    switch (indexWidth(capacity)) {
+        case sizeof(int8_t): return ((int8_t*) indices)[slot];
+        case sizeof(int16_t): return ((int16_t*) indices)[slot];
+        default: return ((int32_t*) indices)[slot];
     }
-    free_array(collector, Entry*, entries, capacity);
 }
 
-static Entry* findEntry(Entry** entries, int capacity, Value key) {
-    if (entries == NULL)
-        return NULL;
-    uint32_t hash = get_value_hash(key);
-    Entry* head = entries[get_index(hash, capacity)];
-    while (head != NULL) {
-        if (valuesEqual(key, head->key)) {
-            return head;
-        }
-        head = head->next;
+static inline void writeIndex(void* indices, int capacity, int slot, int index) {
+    switch (indexWidth(capacity)) {
+        case sizeof(int8_t): ((int8_t*) indices)[slot] = (int8_t) index; break;
+        case sizeof(int16_t): ((int16_t*) indices)[slot] = (int16_t) index; break;
+        default: ((int32_t*) indices)[slot] = (int32_t) index; break;
     }
-    return NULL;
 }
 
-static int entriesPut(Collector* collector, Entry** entries, int capacity, Value key, Value value) {
-    Entry* head = findEntry(entries, capacity, key);
-    if (head == NULL) {
-        uint32_t hash = get_value_hash(key);
-        int index = get_index(hash, capacity);
-        Entry* newhead = allocate_pointer(collector, Entry, sizeof(Entry));
-        newhead->key = key;
-        newhead->value = value;
-        newhead->next = entries[index];
-        entries[index] = newhead;
-        return 0;
-    } else {
-        head->value = value;
-        return 1;
+// returns the position of key inside entries (or -1 if absent);
+// slot is set to the index cell holding it, or to the first cell usable for insertion
+static int findEntry(struct sHashMap* map, Value key, uint32_t hash, int* slot) {
+    int firstDummy = -1;
+    int current = get_index(hash, map->capacity);
+    for (;;) {
+        int index = readIndex(map->indices, map->capacity, current);
+        if (index == INDEX_EMPTY) {
+            *slot = firstDummy >= 0 ? firstDummy : current;
+            return -1;
+        }
+        if (index == INDEX_DUMMY) {
+            if (firstDummy < 0)
+                firstDummy = current;
+        } else {
+            Entry* entry = &map->entries[index];
+            if (entry->hash == hash && valuesEqual(key, entry->key)) {
+                *slot = current;
+                return index;
+            }
+        }
+        current = get_index(current + 1, map->capacity);
     }
 }
 
-static void growMap(Collector* collector, struct sHashMap* map) {
-    int newcap = compute_capacity(map->capacity);
-    Entry** newentries = allocate_block(collector, Entry*, newcap);
+static void deleteEntry(struct sHashMap* map, int slot, int index) {
+    Entry* entry = &map->entries[index];
+    writeIndex(map->indices, map->capacity, slot, INDEX_DUMMY);
+    entry->deleted = 1;
+    entry->key = to_vnihl();
+    entry->value = to_vnihl();
+    map->count--;
+}
+
+static void resizeMap(Collector* collector, struct sHashMap* map) {
+    int newcap = MIN_CAPACITY;
+    while (usable_entries(newcap) < map->count + 1) {
+        newcap = compute_capacity(newcap);
+    }
+    int newEntriesCapacity = usable_entries(newcap);
+    // allocate everything before touching the map: a collection may run meanwhile
+    Entry* newentries = allocate_block(collector, Entry, newEntriesCapacity);
+    void* newindices = reallocate(collector, NULL, 0, indexWidth(newcap) * newcap);
     for (int i = 0; i < newcap; i++) {
-        newentries[i] = NULL;
+        writeIndex(newindices, newcap, i, INDEX_EMPTY);
     }
-    for (int i = 0; i < map->capacity; i++) {
-        Entry* head = map->entries[i];
-        while (head != NULL) {
-            entriesPut(collector, newentries, newcap, head->key, head->value);
-            head = head->next;
+    int newcount = 0;
+    for (int i = 0; i < map->entriesCount; i++) {
+        Entry* entry = &map->entries[i];
+        if (entry_is_deleted(entry))
+            continue;
+        int slot = get_index(entry->hash, newcap);
+        while (readIndex(newindices, newcap, slot) != INDEX_EMPTY) {
+            slot = get_index(slot + 1, newcap);
         }
+        writeIndex(newindices, newcap, slot, newcount);
+        newentries[newcount++] = *entry;
     }
-    freeEntries(collector, map->entries, map->capacity);
+    free_block(collector, Entry, map->entries, map->entriesCapacity);
+    reallocate(collector, map->indices, indexWidth(map->capacity) * map->capacity, 0);
     map->entries = newentries;
+    map->entriesCount = newcount;
+    map->entriesCapacity = newEntriesCapacity;
+    map->indices = newindices;
     map->capacity = newcap;
 }
 
 void initMap(struct sHashMap* map) {
     map->entries = NULL;
+    map->entriesCount = 0;
+    map->entriesCapacity = 0;
+    map->indices = NULL;
     map->count = 0;
     map->capacity = 0;
 }
 
 int mapPut(Collector* collector, struct sHashMap* map, Value key, Value value) {
-    if (map->count + 1 > map->capacity * LOAD_FACTOR) {
-        growMap(collector, map);
+    uint32_t hash = get_value_hash(key);
+    int slot;
+    if (map->count > 0) {
+        int index = findEntry(map, key, hash, &slot);
+        if (index >= 0) {
+            map->entries[index].value = value;
+            return 1;
+        }
+    }
+    if (map->entriesCount + 1 > map->entriesCapacity) {
+        resizeMap(collector, map);
     }
-    int result = entriesPut(collector, map->entries, map->capacity, key, value);
-    if (!result)
-        map->count++;
-    return result;
+    findEntry(map, key, hash, &slot);
+    Entry* entry = &map->entries[map->entriesCount];
+    entry->key = key;
+    entry->value = value;
+    entry->hash = hash;
+    entry->deleted = 0;
+    writeIndex(map->indices, map->capacity, slot, map->entriesCount);
+    map->entriesCount++;
+    map->count++;
+    return 0;
 }
 
 int mapGet(struct sHashMap* map, Value key, Value* result) {
-    Entry* entry = findEntry(map->entries, map->capacity, key);
-    if (entry == NULL) {
+    if (map->count == 0)
+        return 0;
+    int slot;
+    int index = findEntry(map, key, get_value_hash(key), &slot);
+    if (index < 0) {
         return 0;
     }
-    *result = entry->value;
+    *result = map->entries[index].value;
     return 1;
 }
 
 int mapRemove(Collector* collector, struct sHashMap* map, Value key) {
     if (map->count == 0)
         return 0;
-    uint32_t hash = get_value_hash(key);
-    int index = get_index(hash, map->capacity);
-    Entry* dummy = (Entry*) malloc(sizeof(Entry));
-    Entry* previous = dummy;
-    Entry* current = map->entries[index];
-    previous->next = current;
-
-    while (current != NULL) {
-        if (valuesEqual(current->key, key)) {
-            previous->next = current->next;
-            map->entries[index] = dummy->next;
-            free(dummy);
-            free_pointer(collector, current, sizeof(Entry));
-            return 1;
-        }
-        previous = current;
-        current = current->next;
-    }
-
-    free(dummy);
-    return 0;
+    int slot;
+    int index = findEntry(map, key, get_value_hash(key), &slot);
+    if (index < 0)
+        return 0;
+    deleteEntry(map, slot, index);
+    return 1;
 }
 
 void freeMap(Collector* collector, struct sHashMap* map) {
-    freeEntries(collector, map->entries, map->capacity);
+    free_block(collector, Entry, map->entries, map->entriesCapacity);
+    reallocate(collector, map->indices, indexWidth(map->capacity) * map->capacity, 0);
     initMap(map);
 }
 
-ObjString* containsStringDeepEqual(struct sHashMap* map, char* chars, int length) {
-    if (map->count == 0)
-        return NULL;
-    uint32_t hash = hash_string(chars, length);
-    int index = get_index(hash, map->capacity);
-    Entry* head = map->entries[index];
-    while (head != NULL) {
-        Value key = head->key;
-        if (!is_string(key)) 
-            continue;
-        ObjString* objString = as_string(head->key);
-        if (objString->length == length && memcmp(chars, objString->chars, length) == 0)
-            return objString;
-        head = head->next;
-    }
-    return NULL;
-}
-
 void markMap(Collector* collector, struct sHashMap* map) {
-    for (int i = 0; i < map->capacity; i++) {
-        Entry* entry = map->entries[i];
-        if (entry != NULL) {
-            // mark inner linked list
-            while (entry != NULL) {
-                // mark each entry in linked list
-                markValue(collector, entry->key);
-                markValue(collector, entry->value);
-                entry = entry->next;
-            }
-        }
-    }
-}
-
-void removeUnmarkedKeys(Collector* collector, struct sHashMap* map) {
-    Entry* dummy = (Entry*) malloc(sizeof(Entry));
-    for (int i = 0; i < map->capacity; i++) {
-        dummy->next = map->entries[i];
-        Entry* previous = dummy;
-        Entry* current = map->entries[i];
-        while (current != NULL) {
-            if (is_obj(current->key) && !as_obj(current->key)->marked) {
-                previous->next = current->next;
-                free_pointer(collector, current, sizeof(Entry));
-                current = previous->next;
-            } else { 
-                previous = previous->next;
-                if (current != NULL)
-                    current = current->next;
-            }
-        }
-        map->entries[i] = dummy->next;
+    for (int i = 0; i < map->entriesCount; i++) {
+        Entry* entry = &map->entries[i];
+        if (entry_is_deleted(entry))
+            continue;
+        markValue(collector, entry->key);
+        markValue(collector, entry->value);
     }
-    free(dummy);
 }
@@ -7,24 +7,31 @@
 struct sEntry {
     Value key;
     Value value;
-    struct sEntry* next;
+    uint32_t hash;
+    int deleted;
 };
 
 typedef struct sEntry Entry;
 
+// compact layout: entries are stored densely in insertion order,
+// indices is a sparse open addressing table pointing into entries
+// (its cells are 1, 2 or 4 bytes wide depending on capacity)
 struct sHashMap {
-    Entry** entries;
-    int capacity;
-    int count;
+    Entry* entries;
+    int entriesCount; // used entry slots, deleted ones included
+    int entriesCapacity;
+    void* indices;
+    int capacity; // number of index slots (power of two)
+    int count; // live entries
 };
 
+#define entry_is_deleted(entry) ((entry)->deleted)
+
 void initMap(struct sHashMap* map);
 int mapPut(Collector* collector, struct sHashMap* map, Value key, Value value);
 int mapGet(struct sHashMap* map, Value key, Value* result);
 int mapRemove(Collector* collector, struct sHashMap* map, Value key);
-ObjString* containsStringDeepEqual(struct sHashMap* map, char* chars, int length);
 void freeMap(Collector* collector, struct sHashMap* map);
 void markMap(Collector* collector, struct sHashMap* map);
-void removeUnmarkedKeys(Collector* collector, struct sHashMap* map);
 
 #endif
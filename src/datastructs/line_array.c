@@ -23,6 +23,17 @@ int writeLineArray(Collector* collector, LineArray* linearr, int line) {
     return linearr->count - 1;
 }
 
+void truncateLineArray(LineArray* linearr, int removed) {
+    while (removed > 0 && linearr->count > 0) {
+        LineData* last = &linearr->lines[linearr->count - 1];
+        int dropped = removed < last->count ? removed : last->count;
+        last->count -= dropped;
+        removed -= dropped;
+        if (last->count == 0)
+            linearr->count--;
+    }
+}
+
 void freeLineArray(Collector* collector, LineArray* linearr) {
     free_array(collector, int, linearr->lines, linearr->capacity);
     initLineArray(linearr);
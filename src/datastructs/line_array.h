@@ -16,6 +16,7 @@ typedef struct {
 
 void initLineArray(LineArray* linearr);
 int writeLineArray(Collector* collector, LineArray* linearr, int line);
+void truncateLineArray(LineArray* linearr, int removed);
 void freeLineArray(Collector* collector, LineArray* linearr);
 int lineArrayGet(LineArray* linearr, int index);
 
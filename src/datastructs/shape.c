@@ -0,0 +1,133 @@
+#include <string.h>
+
+#include "shape.h"
+#include "../memory.h"
+
+static Shape* allocateShape(Collector* collector, int slotCount) {
+    Shape* shape = allocate_pointer(collector, Shape, sizeof(Shape));
+    shape->keys = NULL;
+    shape->slotCount = 0;
+    shape->parent = NULL;
+    shape->transitions = NULL;
+    shape->transitionCount = 0;
+    shape->transitionCapacity = 0;
+    shape->marked = 0;
+    shape->next = NULL;
+    // shape is not linked yet, so a collection triggered here cannot free it
+    shape->keys = allocate_block(collector, ObjString*, slotCount);
+    shape->slotCount = slotCount;
+    return shape;
+}
+
+static void linkShape(Collector* collector, Shape* shape) {
+    shape->next = collector->shapes;
+    collector->shapes = shape;
+}
+
+static void freeShape(Collector* collector, Shape* shape) {
+    free_block(collector, ObjString*, shape->keys, shape->slotCount);
+    free_block(collector, ShapeTransition, shape->transitions, shape->transitionCapacity);
+    free_pointer(collector, shape, sizeof(Shape));
+}
+
+Shape* newRootShape(Collector* collector) {
+    Shape* root = allocateShape(collector, 0);
+    linkShape(collector, root);
+    return root;
+}
+
+int shapeSlot(Shape* shape, ObjString* key) {
+    for (int i = 0; i < shape->slotCount; i++) {
+        if (shape->keys[i] == key)
+            return i;
+    }
+    return -1;
+}
+
+// for keys that are not interned (shape keys always are)
+int shapeSlotByContent(Shape* shape, ObjString* key) {
+    for (int i = 0; i < shape->slotCount; i++) {
+        ObjString* slotKey = shape->keys[i];
+        if (slotKey->length == key->length && string_hash(slotKey) == string_hash(key)
+                && memcmp(slotKey->chars, string_chars(key), key->length) == 0)
+            return i;
+    }
+    return -1;
+}
+
+Shape* shapeTransition(Collector* collector, Shape* shape, ObjString* key) {
+    for (int i = 0; i < shape->transitionCount; i++) {
+        if (shape->transitions[i].key == key)
+            return shape->transitions[i].shape;
+    }
+    // every allocation happens before linking: a collection in between sees neither the child nor the edge
+    Shape* child = allocateShape(collector, shape->slotCount + 1);
+    if (shape->slotCount > 0) // the root shape has no keys block
+        memcpy(child->keys, shape->keys, sizeof(ObjString*) * shape->slotCount);
+    child->keys[shape->slotCount] = key;
+    child->parent = shape;
+    if (shape->transitionCount + 1 > shape->transitionCapacity) {
+        int newcap = compute_capacity(shape->transitionCapacity);
+        shape->transitions = grow_array(collector, ShapeTransition, shape->transitions, 
+                shape->transitionCapacity, newcap);
+        shape->transitionCapacity = newcap;
+    }
+    shape->transitions[shape->transitionCount].key = key;
+    shape->transitions[shape->transitionCount].shape = child;
+    shape->transitionCount++;
+    linkShape(collector, child);
+    return child;
+}
+
+// marks the ancestors too, so that the transitions leading to a live shape survive and dicts built
+// with the same keys later still reach it
+void markShape(Collector* collector, Shape* shape) {
+    while (shape != NULL && !shape->marked) {
+        shape->marked = 1;
+        for (int i = 0; i < shape->slotCount; i++) {
+            markObject(collector, (Obj*) shape->keys[i]);
+        }
+        shape = shape->parent;
+    }
+}
+
+void sweepShapes(Collector* collector) {
+    markShape(collector, collector->rootShape);
+    // drop edges towards dying shapes while both ends are still allocated: a marked shape is either
+    // used directly or an ancestor of a used one
+    for (Shape* shape = collector->shapes; shape != NULL; shape = shape->next) {
+        if (!shape->marked)
+            continue;
+        int kept = 0;
+        for (int i = 0; i < shape->transitionCount; i++) {
+            if (shape->transitions[i].shape->marked)
+                shape->transitions[kept++] = shape->transitions[i];
+        }
+        shape->transitionCount = kept;
+    }
+    Shape* previous = NULL;
+    Shape* shape = collector->shapes;
+    while (shape != NULL) {
+        Shape* next = shape->next;
+        if (!shape->marked) {
+            if (previous == NULL)
+                collector->shapes = next;
+            else
+                previous->next = next;
+            freeShape(collector, shape);
+        } else {
+            shape->marked = 0;
+            previous = shape;
+        }
+        shape = next;
+    }
+}
+
+void freeShapes(Collector* collector) {
+    while (collector->shapes != NULL) {
+        Shape* next = collector->shapes->next;
+        freeShape(NULL, collector->shapes);
+        collector->shapes = next;
+    }
+    collector->rootShape = NULL;
+}
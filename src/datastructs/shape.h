@@ -0,0 +1,34 @@
+#ifndef shape_h
+#define shape_h
+
+#include "value.h"
+#include "../commontypes.h"
+
+#define SHAPE_MAX_SLOTS 32
+
+typedef struct {
+    ObjString* key;
+    struct sShape* shape;
+} ShapeTransition;
+
+// hidden class shared by every string keyed dictionary built by adding the same keys in the same order
+struct sShape {
+    ObjString** keys; // keys[slot]
+    int slotCount;
+    struct sShape* parent; // strong: a live shape keeps the chain back to the root alive
+    ShapeTransition* transitions; // weak: pruned when the target shape dies
+    int transitionCount;
+    int transitionCapacity;
+    int marked;
+    struct sShape* next;
+};
+
+Shape* newRootShape(Collector* collector);
+int shapeSlot(Shape* shape, ObjString* key);
+int shapeSlotByContent(Shape* shape, ObjString* key);
+Shape* shapeTransition(Collector* collector, Shape* shape, ObjString* key);
+void markShape(Collector* collector, Shape* shape);
+void sweepShapes(Collector* collector);
+void freeShapes(Collector* collector);
+
+#endif
@@ -0,0 +1,104 @@
+#include <string.h>
+
+#include "string_set.h"
+#include "../memory.h"
+
+#define STRING_SET_LOAD_FACTOR 0.75
+#define get_index(hash, capacity) ((hash) & ((capacity) - 1))
+#define is_empty(entry) ((entry)->string == NULL && (entry)->hash == 0)
+#define is_tombstone(entry) ((entry)->string == NULL && (entry)->hash == 1)
+
+void initStringSet(StringSet* set) {
+    set->entries = NULL;
+    set->capacity = 0;
+    set->count = 0;
+    set->tombstones = 0;
+}
+
+void freeStringSet(Collector* collector, StringSet* set) {
+    free_block(collector, StringSetEntry, set->entries, set->capacity);
+    initStringSet(set);
+}
+
+ObjString* stringSetFind(StringSet* set, char* chars, int length, uint32_t hash) {
+    if (set->count == 0)
+        return NULL;
+    int index = get_index(hash, set->capacity);
+    for (;;) {
+        StringSetEntry* entry = &set->entries[index];
+        if (is_empty(entry))
+            return NULL;
+        // hashes are compared first, so memcmp only runs on (almost) certain matches
+        if (entry->string != NULL && entry->hash == hash && entry->string->length == length
+                && memcmp(entry->string->chars, chars, length) == 0)
+            return entry->string;
+        index = get_index(index + 1, set->capacity);
+    }
+}
+
+static void insertEntry(StringSetEntry* entries, int capacity, uint32_t hash, ObjString* string) {
+    int index = get_index(hash, capacity);
+    while (entries[index].string != NULL) {
+        index = get_index(index + 1, capacity);
+    }
+    entries[index].hash = hash;
+    entries[index].string = string;
+}
+
+static void resizeStringSet(Collector* collector, StringSet* set) {
+    int newcap = set->capacity;
+    // only grow when live strings need it: rehashing alone clears tombstones
+    if ((set->count + 1) * 2 > set->capacity * STRING_SET_LOAD_FACTOR)
+        newcap = compute_capacity(set->capacity);
+    StringSetEntry* newentries = allocate_block(collector, StringSetEntry, newcap);
+    for (int i = 0; i < newcap; i++) {
+        newentries[i].hash = 0;
+        newentries[i].string = NULL;
+    }
+    // a collection triggered above may have removed strings: read the set only now
+    for (int i = 0; i < set->capacity; i++) {
+        StringSetEntry* entry = &set->entries[i];
+        if (entry->string != NULL)
+            insertEntry(newentries, newcap, entry->hash, entry->string);
+    }
+    free_block(collector, StringSetEntry, set->entries, set->capacity);
+    set->entries = newentries;
+    set->capacity = newcap;
+    set->tombstones = 0;
+}
+
+void stringSetAdd(Collector* collector, StringSet* set, ObjString* string) {
+    if (set->count + set->tombstones + 1 > set->capacity * STRING_SET_LOAD_FACTOR) {
+        resizeStringSet(collector, set);
+    }
+    uint32_t hash = ((Obj*) string)->hash;
+    int index = get_index(hash, set->capacity);
+    while (set->entries[index].string != NULL) {
+        index = get_index(index + 1, set->capacity);
+    }
+    if (is_tombstone(&set->entries[index]))
+        set->tombstones--;
+    set->entries[index].hash = hash;
+    set->entries[index].string = string;
+    set->count++;
+}
+
+void stringSetRemove(StringSet* set, ObjString* string) {
+    if (set->count == 0)
+        return;
+    uint32_t hash = ((Obj*) string)->hash;
+    int index = get_index(hash, set->capacity);
+    for (;;) {
+        StringSetEntry* entry = &set->entries[index];
+        if (is_empty(entry))
+            return;
+        if (entry->string == string) {
+            entry->string = NULL;
+            entry->hash = 1;
+            set->count--;
+            set->tombstones++;
+            return;
+        }
+        index = get_index(index + 1, set->capacity);
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef string_set_h
+#define string_set_h
+
+#include "value.h"
+#include "../commontypes.h"
+
+// an empty cell has string == NULL and hash == 0, a deleted one string == NULL and hash == 1
+typedef struct {
+    uint32_t hash;
+    ObjString* string;
+} StringSetEntry;
+
+// weak set of interned strings: it does not keep its strings alive,
+// the sweep removes each string from it right before freeing it
+typedef struct {
+    StringSetEntry* entries;
+    int capacity;
+    int count;
+    int tombstones;
+} StringSet;
+
+void initStringSet(StringSet* set);
+void freeStringSet(Collector* collector, StringSet* set);
+ObjString* stringSetFind(StringSet* set, char* chars, int length, uint32_t hash);
+void stringSetAdd(Collector* collector, StringSet* set, ObjString* string);
+void stringSetRemove(StringSet* set, ObjString* string);
+
+#endif
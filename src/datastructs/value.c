@@ -2,6 +2,7 @@
 #include "../memory.h"
 #include "../util.h"
 #include "bytecode.h"
+#include "dict.h"
 #include "../debug/debug_switches.h"
 
 #ifdef TRACE_GC
@@ -15,6 +16,8 @@ static inline char* string_type(ObjType type) {
             type_case(OBJ_ARRAY)
             type_case(OBJ_DICT)
             type_case(OBJ_ERROR)
+            type_case(OBJ_BUFFER)
+            type_case(OBJ_GENERATOR)
     }
 #undef type_case
 }
@@ -45,10 +48,8 @@ Obj* allocateObj(Collector* collector, ObjType type, size_t size) {
 }
 
 ObjString* copyString(Collector* collector, char* chars, int length) {
-    ObjString* str;
-    if ((str = containsStringDeepEqual(&collector->interned, chars, length)) != NULL) {
-        return str;
-    }
+    if (length == 1)
+        return single_char_string(collector, chars[0]);
     char* copied = allocate_block(collector, char, length + 1);
     memcpy(copied, chars, length);
     copied[length] = '\0';
@@ -60,26 +61,113 @@ ObjString* copyNoLengthString(Collector* collector, char* chars) {
 }
 
 ObjString* takeString(Collector* collector, char* chars, int length) {
-    ObjString* str;
-    if ((str = containsStringDeepEqual(&collector->interned, chars, length)) != NULL) {
-        free_block(collector, char, chars, length);
-        return str;
-    }
     ObjString* string = allocate_obj(collector, ObjString, OBJ_STRING);
     string->chars = chars;
     string->length = length;
-    ((Obj*) string)->hash = hash_string(chars, length);
-    pushSafe(collector, to_vobj(string));
-    mapPut(collector, &collector->interned, to_vobj(string), to_vnihl());
+    string->hashed = 0;
+    string->interned = 0;
+    string->left = NULL;
+    string->right = NULL;
+    string->depth = 0;
+    string->owner = NULL;
+    return string;
+}
+
+// owner must be flat and reachable by the collector, chars must point into it
+ObjString* newStringView(Collector* collector, ObjString* owner, char* chars, int length) {
+    ObjString* view = takeString(collector, chars, length);
+    view->owner = owner;
+    return view;
+}
+
+// left and right must be reachable by the collector
+ObjString* newRope(Collector* collector, ObjString* left, ObjString* right) {
+    ObjString* rope = allocate_obj(collector, ObjString, OBJ_STRING);
+    rope->chars = NULL;
+    rope->length = left->length + right->length;
+    rope->hashed = 0;
+    rope->interned = 0;
+    rope->left = left;
+    rope->right = right;
+    rope->depth = (left->depth > right->depth ? left->depth : right->depth) + 1;
+    rope->owner = NULL;
+    if (rope->depth > ROPE_MAX_DEPTH)
+        flattenString(rope);
+    return rope;
+}
+
+// recursion follows right children only: ropes built by appending lean left
+static void copyRope(ObjString* string, char* dest) {
+    while (string_is_rope(string)) {
+        copyRope(string->right, dest + string->left->length);
+        string = string->left;
+    }
+    memcpy(dest, string->chars, string->length);
+}
+
+// flattening never collects, so callers may read chars without rooting the string;
+// the buffer is not accounted, as freeing in the sweep is not either
+char* flattenString(ObjString* string) {
+    if (!string_is_rope(string))
+        return string->chars;
+    char* chars = allocate_block(NULL, char, string->length + 1);
+    copyRope(string, chars);
+    chars[string->length] = '\0';
+    string->chars = chars;
+    string->left = NULL;
+    string->right = NULL;
+    string->depth = 0;
+    return chars;
+}
+
+// the buffer's bytes become the string's chars, leaving buffer empty
+ObjString* takeByteBuffer(Collector* collector, ByteBuffer* buffer) {
+    reserveByteBuffer(buffer, 1);
+    buffer->bytes[buffer->count] = '\0';
+    ObjString* string = takeString(collector, buffer->bytes, buffer->count);
+    initByteBuffer(buffer);
+    return string;
+}
+
+ObjString* copyInternedString(Collector* collector, char* chars, int length) {
+    uint32_t hash = hash_string(chars, length);
+    ObjString* str;
+    if ((str = stringSetFind(&collector->interned, chars, length, hash)) != NULL) {
+        return str;
+    }
+    str = copyString(collector, chars, length);
+    ((Obj*) str)->hash = hash;
+    str->hashed = 1;
+    return internString(collector, str);
+}
+
+// returns the canonical copy of string, which becomes it if there is none yet
+ObjString* internString(Collector* collector, ObjString* string) {
+    if (string->interned)
+        return string;
+    ObjString* str;
+    if ((str = stringSetFind(&collector->interned, string_chars(string), string->length, string_hash(string))) != NULL) {
+        return str;
+    }
+    pushSafeObj(collector, string);
+    stringSetAdd(collector, &collector->interned, string);
     popSafe(collector);
+    string->interned = 1;
     return string;
 }
 
+uint32_t hashStringObject(ObjString* string) {
+    ((Obj*) string)->hash = hash_string(string_chars(string), string->length);
+    string->hashed = 1;
+    return ((Obj*) string)->hash;
+}
+
 ObjFunction* newFunction(Collector* collector) {
     ObjFunction* function = allocate_obj(collector, ObjFunction, OBJ_FUNCTION);
     function->name = NULL;
     function->arity = 0;
     function->upvalueCount = 0;
+    function->isGenerator = 0;
     pushSafe(collector, to_vobj(function));
     function->bytecode = allocate_pointer(collector, Bytecode, sizeof(Bytecode));
     popSafe(collector);
@@ -88,7 +176,7 @@ ObjFunction* newFunction(Collector* collector) {
 }
 
 ObjNativeFunction* newNativeFunction(Collector* collector, int arity, char* nameChars, CNativeFunction cfunction) {
-    ObjString* name = copyNoLengthString(collector, nameChars);
+    ObjString* name = copyInternedString(collector, nameChars, strlen(nameChars));
     pushSafeObj(collector, name);
     ObjNativeFunction* native = allocate_obj(collector, ObjNativeFunction, OBJ_NATIVE_FUNCTION);
     popSafe(collector);
@@ -122,17 +210,44 @@ ObjArray* newArray(Collector* collector) {
     initValueArray(values);
     ObjArray* array = allocate_obj(collector, ObjArray, OBJ_ARRAY);
     array->values = values;
+    array->owner = NULL;
     return array;
 }
 
 ObjDict* newDict(Collector* collector) {
-    HashMap* map = allocate_pointer(collector, HashMap, sizeof(HashMap));
-    initMap(map);
+    ValueArray* values = allocate_pointer(collector, ValueArray, sizeof(ValueArray));
+    initValueArray(values);
     ObjDict* dict = allocate_obj(collector, ObjDict, OBJ_DICT);
-    dict->map = map;
+    dict->kind = DICT_ARRAY;
+    dict->values = values;
+    dict->shape = NULL;
+    dict->map = NULL;
     return dict;
 }
 
+ObjBuffer* newBuffer(Collector* collector) {
+    ObjBuffer* buffer = allocate_obj(collector, ObjBuffer, OBJ_BUFFER);
+    initByteBuffer(&buffer->bytes);
+    return buffer;
+}
+
+ObjGenerator* newGenerator(Collector* collector, ObjClosure* closure) {
+    ObjGenerator* generator = allocate_obj(collector, ObjGenerator, OBJ_GENERATOR);
+    generator->state = GENERATOR_SUSPENDED;
+    generator->closure = closure;
+    generator->pc = closure->function->bytecode->code;
+    generator->slots = NULL;
+    generator->slotsCount = 0;
+    generator->slotsCapacity = 0;
+    generator->upvalues = NULL;
+    generator->upvalueSlots = NULL;
+    generator->upvaluesCount = 0;
+    generator->upvaluesCapacity = 0;
+    generator->receiver = NULL;
+    generator->loopBody = NULL;
+    return generator;
+}
+
 ObjError* newError(Collector* collector, ObjString* message) {
     ObjError* error = allocate_obj(collector, ObjError, OBJ_ERROR);
     error->message = message;
@@ -152,8 +267,10 @@ ObjError* newErrorFromCharArray(Collector* collector, char* message) {
     return newErrorSafe(collector, strmsg);
 }
 
+// the box is kept when a suspended generator reopens the upvalue, so it is allocated once
 void closeUpvalue(ObjUpvalue* upvalue) {
-    upvalue->closed = allocate_pointer(NULL, Value, sizeof(Value));
+    if (upvalue->closed == NULL)
+        upvalue->closed = allocate_pointer(NULL, Value, sizeof(Value));
     *upvalue->closed = *upvalue->value;
     upvalue->value = upvalue->closed;
 }
@@ -168,7 +285,8 @@ void freeObject(Collector* collector, Obj* object) {
         case OBJ_STRING: 
             {                                    
                 ObjString* string = (ObjString*) object;             
-                free_array(collector, char, string->chars, string->length + 1);
+                if (!string_is_rope(string) && string->owner == NULL)
+                    free_array(collector, char, string->chars, string->length + 1);
                 free_pointer(collector, object, sizeof(ObjString));                            
                 break;                                              
             }       
@@ -211,7 +329,8 @@ void freeObject(Collector* collector, Obj* object) {
         case OBJ_ARRAY:
             {
                 ObjArray* array = (ObjArray*) object;
-                freeValueArray(collector, array->values);
+                if (array->owner == NULL)
+                    freeValueArray(collector, array->values);
                 free_pointer(collector, array->values, sizeof(ValueArray));
                 free_pointer(collector, array, sizeof(ObjArray));
                 break;                    
@@ -219,11 +338,27 @@ void freeObject(Collector* collector, Obj* object) {
         case OBJ_DICT:
             {
                 ObjDict* dict = (ObjDict*) object;
-                freeMap(collector, dict->map);
-                free_pointer(collector, dict->map, sizeof(HashMap));
+                freeDict(collector, dict);
                 free_pointer(collector, dict, sizeof(ObjDict));
                 break;                    
             }
+        case OBJ_BUFFER:
+            {
+                ObjBuffer* buffer = (ObjBuffer*) object;
+                freeByteBuffer(&buffer->bytes);
+                free_pointer(collector, buffer, sizeof(ObjBuffer));
+                break;
+            }
+        case OBJ_GENERATOR:
+            {
+                // its upvalues are closed while suspended: they own their values
+                ObjGenerator* generator = (ObjGenerator*) object;
+                free_array(collector, Value, generator->slots, generator->slotsCapacity);
+                free_array(collector, ObjUpvalue*, generator->upvalues, generator->upvaluesCapacity);
+                free_array(collector, int, generator->upvalueSlots, generator->upvaluesCapacity);
+                free_pointer(collector, generator, sizeof(ObjGenerator));
+                break;
+            }
     }
 }
 
@@ -234,6 +369,17 @@ void blackenObject(Collector* collector, Obj* obj) {
     printf("\n");                         
 #endif 
     switch (obj->type) {
+        case OBJ_STRING:
+            {
+                ObjString* string = (ObjString*) obj;
+                if (string_is_rope(string)) {
+                    markObject(collector, (Obj*) string->left);
+                    markObject(collector, (Obj*) string->right);
+                } else if (string->owner != NULL) {
+                    recordView(collector, obj);
+                }
+                break;
+            }
         case OBJ_UPVALUE:
             {
                 ObjUpvalue* uv = (ObjUpvalue*) obj;
@@ -277,17 +423,64 @@ void blackenObject(Collector* collector, Obj* obj) {
                 for (int i = 0; i < array->values->count; i++) {
                     markValue(collector, array->values->values[i]);
                 }
+                if (array->owner != NULL)
+                    recordView(collector, obj);
                 break;
             }
         case OBJ_DICT:
             {   
                 ObjDict* dict = (ObjDict*) obj;
-                markMap(collector, dict->map);
+                markDict(collector, dict);
+                break;
+            }
+        case OBJ_GENERATOR:
+            {
+                ObjGenerator* generator = (ObjGenerator*) obj;
+                markObject(collector, (Obj*) generator->closure);
+                for (int i = 0; i < generator->slotsCount; i++) {
+                    markValue(collector, generator->slots[i]);
+                }
+                for (int i = 0; i < generator->upvaluesCount; i++) {
+                    markObject(collector, (Obj*) generator->upvalues[i]);
+                }
                 break;
             }
     }
 }
 
+// called once marking is done: a view keeps its owner alive only if
+// something else does or the owner is not much larger than the view.
+// runs inside a collection, so the copies bypass the collector
+void settleView(Collector* collector, Obj* view) {
+    if (view->type == OBJ_STRING) {
+        ObjString* string = (ObjString*) view;
+        if (string->owner == NULL || string->owner->obj.marked)
+            return;
+        if (string->owner->length <= VIEW_DETACH_FACTOR * string->length) {
+            markObject(collector, (Obj*) string->owner);
+            return;
+        }
+        char* chars = allocate_block(NULL, char, string->length + 1);
+        memcpy(chars, string->chars, string->length);
+        chars[string->length] = '\0';
+        string->chars = chars;
+        string->owner = NULL;
+    } else {
+        ObjArray* array = (ObjArray*) view;
+        if (array->owner == NULL || array->owner->obj.marked)
+            return;
+        if (array->owner->values->count <= VIEW_DETACH_FACTOR * array->values->count) {
+            markObject(collector, (Obj*) array->owner);
+            return;
+        }
+        Value* values = allocate_block(NULL, Value, array->values->count);
+        memcpy(values, array->values->values, sizeof(Value) * array->values->count);
+        array->values->values = values;
+        array->values->capacity = array->values->count;
+        array->owner = NULL;
+    }
+}
+
 void markObject(Collector* collector, Obj* obj) {
     if (obj == NULL)
         return;
@@ -299,7 +492,9 @@ void markObject(Collector* collector, Obj* obj) {
     if (obj->marked)
         return;
     obj->marked = 1;
-    if (obj->type == OBJ_STRING)
+    if (obj->type == OBJ_BUFFER)
+        return;
+    if (obj->type == OBJ_STRING && !string_is_rope((ObjString*) obj) && ((ObjString*) obj)->owner == NULL)
         return; 
     if (collector->worklistCapacity <= collector->worklistCount + 1) {
         collector->worklistCapacity = compute_capacity(collector->worklistCapacity);
@@ -339,7 +534,7 @@ uint32_t hashValue(Value value) {
         case VALUE_NIHL: return hash_nihl;
         case VALUE_BOOL: return hash_bool(value);
         case VALUE_NUMBER: return hash_number(value);
-        case VALUE_OBJ: return as_obj(value)->hash;
+        case VALUE_OBJ: return get_value_hash(value);
     }
 }
 
@@ -2,6 +2,7 @@
 #define value_h
 
 #include "../commontypes.h"
+#include "byte_buffer.h"
 
 typedef struct sValue Value;
 typedef struct sValueArray ValueArray;
@@ -15,6 +16,8 @@ typedef enum {
     OBJ_ARRAY,
     OBJ_DICT,
     OBJ_ERROR,
+    OBJ_BUFFER,
+    OBJ_GENERATOR,
 } ObjType;
 
 struct sObj {
@@ -26,21 +29,42 @@ struct sObj {
 
 typedef struct sObj Obj;
 
-typedef struct {
+// runtime strings are neither hashed nor interned until they need to be:
+// obj.hash is only meaningful once hashed is set.
+// a rope is the lazy concatenation left ++ right: its chars stay NULL until it is flattened.
+// a view (owner != NULL) borrows chars from owner: they are not NUL terminated
+typedef struct sObjString {
     Obj obj;
     int length;
     char* chars;
+    int hashed;
+    int interned;
+    struct sObjString* left;
+    struct sObjString* right;
+    int depth; // 0 for flat strings
+    struct sObjString* owner;
 } ObjString;
 
+#define ROPE_MIN_LENGTH 32 // shorter concatenations are copied right away
+#define ROPE_MAX_DEPTH 128 // deeper ropes are flattened on creation
+
+#define string_is_rope(string) ((string)->chars == NULL)
+
+#define VIEW_MIN_LENGTH 16 // shorter slices are copied
+#define VIEW_DETACH_FACTOR 4 // a view copies its content instead of keeping alive an owner this many times larger
+
 typedef struct {
     Obj obj;
     int arity;
     ObjString* name;
     Bytecode* bytecode;
     int upvalueCount;
+    int isGenerator; // calls return a generator instead of running the body
 } ObjFunction;
 
-typedef Value (*CNativeFunction)(VM* vm, Value* args);
+typedef Value (*CNativeFunction)(VM* vm, int argCount, Value* args);
+
+#define NATIVE_VARIADIC (-1) // arity of natives accepting any number of arguments
 
 // todo: replication of name and arity
 
@@ -73,25 +97,76 @@ typedef struct {
     Value* payload;
 } ObjError;
 
-typedef struct {
+// a view (owner != NULL) borrows values from owner's buffer and copies them before being written
+typedef struct sObjArray {
     Obj obj;
     ValueArray* values;
+    struct sObjArray* owner;
 } ObjArray;
 
+typedef enum {
+    DICT_ARRAY, // keys are exactly 0, 1, ..., count - 1: values are stored densely
+    DICT_SHAPED, // keys are strings: shape maps each of them to a slot of values
+    DICT_MAP,
+} DictKind;
+
 typedef struct {
     Obj obj;
-    HashMap* map;
+    DictKind kind;
+    ValueArray* values; // DICT_ARRAY and DICT_SHAPED storage
+    Shape* shape; // DICT_SHAPED layout
+    HashMap* map; // DICT_MAP storage
 } ObjDict;
 
+// mutable byte buffer used by scripts to build strings in linear time
+typedef struct {
+    Obj obj;
+    ByteBuffer bytes;
+} ObjBuffer;
+
+typedef enum {
+    GENERATOR_SUSPENDED,
+    GENERATOR_RUNNING,
+    GENERATOR_DONE,
+} GeneratorState;
+
+// a call to a generator function. While suspended, slots hold its frame (the closure, the locals and the
+// temporaries) and the upvalues over its locals are closed, upvalueSlots telling where to reopen them.
+// While running, receiver is the state of the for each loop pulling from it, resumed at loopBody on yields
+typedef struct {
+    Obj obj;
+    GeneratorState state;
+    ObjClosure* closure;
+    uint8_t* pc;
+    Value* slots;
+    int slotsCount;
+    int slotsCapacity;
+    ObjUpvalue** upvalues;
+    int* upvalueSlots;
+    int upvaluesCount;
+    int upvaluesCapacity;
+    Value* receiver;
+    uint8_t* loopBody;
+} ObjGenerator;
+
 ObjString* copyString(Collector* collector, char* chars, int length);
 ObjString* copyNoLengthString(Collector* collector, char* chars);
 ObjString* takeString(Collector* collector, char* chars, int length);
+ObjString* takeByteBuffer(Collector* collector, ByteBuffer* buffer);
+ObjString* copyInternedString(Collector* collector, char* chars, int length);
+ObjString* internString(Collector* collector, ObjString* string);
+uint32_t hashStringObject(ObjString* string);
+ObjString* newStringView(Collector* collector, ObjString* owner, char* chars, int length);
+ObjString* newRope(Collector* collector, ObjString* left, ObjString* right);
+char* flattenString(ObjString* string);
 ObjFunction* newFunction(Collector* collector);
 ObjNativeFunction* newNativeFunction(Collector* collector, int arity, char* nameChars, CNativeFunction cfunction);
 ObjClosure* newClosure(Collector* collector, ObjFunction* function);
 ObjUpvalue* newUpvalue(Collector* collector, Value* value);
 ObjArray* newArray(Collector* collector);
 ObjDict* newDict(Collector* collector);
+ObjBuffer* newBuffer(Collector* collector);
+ObjGenerator* newGenerator(Collector* collector, ObjClosure* closure);
 ObjError* newError(Collector* collector, ObjString* message);
 ObjError* newErrorSafe(Collector* collector, ObjString* message);
 ObjError* newErrorFromCharArray(Collector* collector, char* message);
@@ -99,6 +174,7 @@ void closeUpvalue(ObjUpvalue* upvalue);
 void freeObject(Collector* collector, Obj* object);
 void markObject(Collector* collector, Obj* obj);
 void blackenObject(Collector* collector, Obj* obj);
+void settleView(Collector* collector, Obj* view);
 
 typedef enum {
     VALUE_NIHL,
@@ -138,6 +214,8 @@ struct sValue {
 #define is_array(value) isObjType(value, OBJ_ARRAY)
 #define is_dict(value) isObjType(value, OBJ_DICT)
 #define is_error(value) isObjType(value, OBJ_ERROR)
+#define is_buffer(value) isObjType(value, OBJ_BUFFER)
+#define is_generator(value) isObjType(value, OBJ_GENERATOR)
 
 #define as_function(value) ((ObjFunction*) as_obj(value))
 #define as_native(value) ((ObjNativeFunction*) as_obj(value))
@@ -146,9 +224,11 @@ struct sValue {
 #define as_upvalue(value) ((ObjUpvalue*) as_obj(value))
 #define as_error(value) ((ObjError*) as_obj(value))
 #define as_string(value) ((ObjString*) as_obj(value))
+#define as_buffer(value) ((ObjBuffer*) as_obj(value))
+#define as_generator(value) ((ObjGenerator*) as_obj(value))
 #define as_array(value) ((ObjArray*) as_obj(value))
 #define as_dict(value) ((ObjDict*) as_obj(value))
-#define as_cstring(value) (as_string(value)->chars)
+#define as_cstring(value) string_chars(as_string(value))
 
 int isObjType(Value value, ObjType type);
 
@@ -164,8 +244,18 @@ struct sValueArray {
 
 uint32_t hashValue(Value val);
 
+static inline char* string_chars(ObjString* string) {
+    return string_is_rope(string) ? flattenString(string) : string->chars;
+}
+
+#define string_hash(string) ((string)->hashed ? ((Obj*) (string))->hash : hashStringObject(string))
+
 static inline uint32_t get_value_hash(Value val) {
-    return is_obj(val) ? as_obj(val)->hash : hashValue(val);
+    if (!is_obj(val))
+        return hashValue(val);
+    if (as_obj(val)->type == OBJ_STRING)
+        return string_hash((ObjString*) as_obj(val));
+    return as_obj(val)->hash;
 }
 
 void initValueArray(ValueArray* valarray);
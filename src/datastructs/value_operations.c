@@ -4,7 +4,10 @@
 #include "../util.h"
 #include "value_operations.h"
 #include "value.h"
+#include "dict.h"
 #include "../memory.h"
+#include "../output.h"
+#include "../number_format.h"
 
 // GC INVARIANT: PARAMETERS PASSED ARE ALREADY ON THE STACK (exceptions are *Safe functions)
 
@@ -23,6 +26,21 @@ int indexGetArray(Collector* collector, ObjArray* array, Value* index, Value* re
     return 1;
 }
 
+// copy on write: gives a view its own buffer (array must be on the stack)
+static void ownArrayValues(Collector* collector, ObjArray* array) {
+    int count = array->values->count;
+    Value* values = allocate_block(collector, Value, count);
+    // a collection triggered above may have detached the view already
+    if (array->owner == NULL) {
+        free_block(collector, Value, values, count);
+        return;
+    }
+    memcpy(values, array->values->values, sizeof(Value) * count);
+    array->values->values = values;
+    array->values->capacity = count;
+    array->owner = NULL;
+}
+
 int indexSetArray(Collector* collector, ObjArray* array, Value* index, Value* value, Value* result) {
     if (!valueInteger(*index)) {
         *result = to_vobj(newErrorFromCharArray(collector, "invalid index for array"));
@@ -34,7 +52,10 @@ int indexSetArray(Collector* collector, ObjArray* array, Value* index, Value* va
         *result = to_vobj(newErrorFromCharArray(collector, "array index out of bounds"));
         return 0;
     }
+    if (array->owner != NULL)
+        ownArrayValues(collector, array);
     array->values->values[cindex] = *value;
+    *result = *value;
     return 1;
 }
 
@@ -48,7 +69,7 @@ int indexGetString(Collector* collector, ObjString* string, Value* index, Value*
         *result = to_vobj(newErrorFromCharArray(collector, "string index out of bounds"));
         return 0;
     }
-    *result = to_vobj(copyString(collector, string->chars + cindex, 1));
+    *result = to_vobj(single_char_string(collector, string_chars(string)[cindex]));
     return 1;
 }
 
@@ -102,9 +123,11 @@ ObjString* concatenateStrings(Collector* collector, ObjString* sa, ObjString* sb
     if (length == 0)
         return copyString(collector, "", 0);
     
+    if (length >= ROPE_MIN_LENGTH)
+        return newRope(collector, sa, sb);
     char* chars = allocate_block(collector, char, length + 1);
-    memcpy(chars, sa->chars, sa->length);
-    memcpy(chars + sa->length, sb->chars, sb->length);
+    memcpy(chars, string_chars(sa), sa->length);
+    memcpy(chars + sa->length, string_chars(sb), sb->length);
     chars[length] = '\0'; 
     ObjString* result = takeString(collector, chars, length);
     return result;
@@ -163,116 +186,111 @@ ObjString* vconcatenateMultipleCharArrays(Collector* collector, char* first, va_
     return result;
 }
 
-static ObjString* strOrSelf(Collector* collector, Obj* container, Value value) {
-    ObjString* result;
+static void writeOrSelf(ByteBuffer* buffer, Obj* container, Value value) {
     if (is_obj(value) && as_obj(value) == container)
-        result = copyNoLengthString(collector, "<self>");
+        writeCString(buffer, "<self>");
     else
-        result = valueToString(collector, value);
-    return result;
+        writeValue(buffer, value);
 }
 
-ObjString* objectToString(Collector* collector, Obj* obj) {
+static void writeObject(ByteBuffer* buffer, Obj* obj) {
     switch (obj->type) {
         case OBJ_STRING:
-            return ((ObjString*) obj);
+            {
+                ObjString* string = (ObjString*) obj;
+                writeBytes(buffer, string_chars(string), string->length);
+                break;
+            }
         case OBJ_NATIVE_FUNCTION:
             {
                 ObjNativeFunction* native = (ObjNativeFunction*) obj;
-                ObjString* result = copyNoLengthString(collector, "<");
-                result = concatenateStringsSafe(collector, result, native->name);
-                result = concatenateStringAndCharArraySafe(collector, result, " native function>"); 
-                return result;
+                writeCString(buffer, "<");
+                writeObject(buffer, (Obj*) native->name);
+                writeCString(buffer, " native function>");
+                break;
             }
         case OBJ_FUNCTION:
             {
                 ObjFunction* function = (ObjFunction*) obj;
                 if (function->name == NULL) {
-                    return copyNoLengthString(collector, "<init>");
+                    writeCString(buffer, "<init>");
                 } else {
-                    ObjString* result = copyNoLengthString(collector, "<");
-                    result = concatenateStringsSafe(collector, result, function->name);
-                    result = concatenateStringAndCharArraySafe(collector, result, " function>"); 
-                    return result;
+                    writeCString(buffer, "<");
+                    writeObject(buffer, (Obj*) function->name);
+                    writeCString(buffer, " function>");
                 }
+                break;
             }
         case OBJ_CLOSURE:
             {
                 ObjClosure* closure = (ObjClosure*) obj;
-                return objectToString(collector, (Obj*) closure->function);
+                writeObject(buffer, (Obj*) closure->function);
+                break;
             }
         case OBJ_UPVALUE:
             {
                 ObjUpvalue* upvalue = (ObjUpvalue*) obj;
-                ObjString* result = copyNoLengthString(collector, "upvalue ");
-                pushSafeObj(collector, result);
-                result = concatenateStringsSafe(collector, result, 
-                        valueToString(collector, *upvalue->value));
-                popSafe(collector);
-                return result;
+                writeCString(buffer, "upvalue ");
+                writeValue(buffer, *upvalue->value);
+                break;
             }
         case OBJ_ERROR:
             {
                 ObjError* error = (ObjError*) obj;
-                ObjString* result = error->message;
+                writeObject(buffer, (Obj*) error->message);
                 if (error->payload != NULL) {
-                    result = concatenateStringAndCharArraySafe(collector, result, " (");
-                    pushSafeObj(collector, result);
-                    result = concatenateStringsSafe(collector, result,
-                            valueToString(collector, *error->payload));
-                    popSafe(collector);
-                    result = concatenateStringAndCharArray(collector, result, ")");
+                    writeCString(buffer, " (");
+                    writeValue(buffer, *error->payload);
+                    writeCString(buffer, ")");
                 }
-                return result;
+                break;
             }
         case OBJ_ARRAY:
             {
                 ObjArray* array = (ObjArray*) obj;
-                ObjString* result = copyNoLengthString(collector, "[");
-                for (int i = 0; i < array->values->count - 1; i++) {
-                    Value val = array->values->values[i];
-                    pushSafeObj(collector, result);
-                    result = concatenateStringsSafe(collector, result, strOrSelf(collector, obj, val));
-                    popSafe(collector);
-                    result = concatenateStringAndCharArraySafe(collector, result, ",");
+                writeCString(buffer, "[");
+                for (int i = 0; i < array->values->count; i++) {
+                    if (i > 0)
+                        writeCString(buffer, ",");
+                    writeOrSelf(buffer, obj, array->values->values[i]);
                 }
-                if (array->values->count > 0) {
-                    int index = array->values->count - 1;
-                    Value val = array->values->values[index];
-                    pushSafeObj(collector, result);
-                    result = concatenateStringsSafe(collector, result, strOrSelf(collector, obj, val));
-                    popSafe(collector);
-                }
-                result = concatenateStringAndCharArraySafe(collector, result, "]");
-                return result;
+                writeCString(buffer, "]");
+                break;
             }
         case OBJ_DICT:
             {
                 ObjDict* dict = (ObjDict*) obj;
-                ObjString* result = copyNoLengthString(collector, "{");
-                HashMap* map = dict->map;
-                for (int i = 0; i < map->capacity; i++) {
-                    Entry* entry = map->entries[i];
-                    while (entry != NULL) {
-                        pushSafeObj(collector, result);
-                        result = concatenateStringsSafe(collector, result, 
-                                strOrSelf(collector, obj, entry->key));
-                        popSafe(collector);
-                        result = concatenateStringAndCharArraySafe(collector, result, " => ");
-                        pushSafeObj(collector, result);
-                        result = concatenateStringsSafe(collector, result, 
-                                strOrSelf(collector, obj, entry->value));
-                        popSafe(collector);
-                        result = concatenateStringAndCharArraySafe(collector, result, ",");
-                        entry = entry->next;
-                    }
+                writeCString(buffer, "{");
+                int cursor = 0;
+                Value key;
+                Value value;
+                while (dictNext(dict, &cursor, &key, &value)) {
+                    writeOrSelf(buffer, obj, key);
+                    writeCString(buffer, " => ");
+                    writeOrSelf(buffer, obj, value);
+                    writeCString(buffer, ",");
                 }
-                result = concatenateStringAndCharArraySafe(collector, result, "}");
-                return result;
+                writeCString(buffer, "}");
+                break;
+            }
+        case OBJ_BUFFER:
+            writeCString(buffer, "<buffer>");
+            break;
+        case OBJ_GENERATOR:
+            {
+                ObjString* name = ((ObjGenerator*) obj)->closure->function->name;
+                writeCString(buffer, "<");
+                writeObject(buffer, (Obj*) name);
+                writeCString(buffer, " generator>");
+                break;
             }
     }
 }
 
+ObjString* objectToString(Collector* collector, Obj* obj) {
+    return valueToString(collector, to_vobj(obj));
+}
+
 Obj* concatenateObjects(Collector* collector, Obj* a, Obj* b) {
     if (a->type != b->type) {
         return (Obj*) newErrorFromCharArray(collector, "cannot concatenate objects of different types");
@@ -299,7 +317,7 @@ ObjArray* pairList(Collector* collector, Obj* arrayLike) {
                     ObjArray* pair = newArray(collector);
                     pushSafeObj(collector, pair);
                     arrayPush(collector, pair, to_vnumber(i));
-                    arrayPush(collector, pair, to_vobj(copyString(collector, str->chars + i, 1)));
+                    arrayPush(collector, pair, to_vobj(single_char_string(collector, string_chars(str)[i])));
                     arrayPush(collector, result, to_vobj(pair));
                     popSafe(collector);
                 }
@@ -321,18 +339,16 @@ ObjArray* pairList(Collector* collector, Obj* arrayLike) {
         case OBJ_DICT:
             {
                 ObjDict* dict = (ObjDict*) arrayLike;
-                HashMap* map = dict->map;
-                for (int i = 0; i < map->capacity; i++) {
-                    Entry* entry = map->entries[i];
-                    while (entry != NULL) {
-                        ObjArray* pair = newArray(collector);
-                        pushSafeObj(collector, pair);
-                        arrayPush(collector, pair, entry->key);
-                        arrayPush(collector, pair, entry->value);
-                        arrayPush(collector, result, to_vobj(pair));
-                        popSafe(collector);
-                        entry = entry->next;
-                    }
+                int cursor = 0;
+                Value key;
+                Value value;
+                while (dictNext(dict, &cursor, &key, &value)) {
+                    ObjArray* pair = newArray(collector);
+                    pushSafeObj(collector, pair);
+                    arrayPush(collector, pair, key);
+                    arrayPush(collector, pair, value);
+                    arrayPush(collector, result, to_vobj(pair));
+                    popSafe(collector);
                 }
                 break;
             }
@@ -342,16 +358,54 @@ ObjArray* pairList(Collector* collector, Obj* arrayLike) {
 }
 
 void arrayPush(Collector* collector, ObjArray* array, Value value) {
+    if (array->owner != NULL)
+        ownArrayValues(collector, array);
     writeValueArray(collector, array->values, value);
 }
 
+// bounds must satisfy 0 <= start <= end <= length
+ObjString* sliceString(Collector* collector, ObjString* string, int start, int end) {
+    char* chars = string_chars(string);
+    if (end - start == 1)
+        return single_char_string(collector, chars[start]);
+    if (end - start < VIEW_MIN_LENGTH || end - start == string->length)
+        return end - start == string->length ? string : copyString(collector, chars + start, end - start);
+    return newStringView(collector, string->owner != NULL ? string->owner : string, chars + start, end - start);
+}
+
+// bounds must satisfy 0 <= start <= end <= count
+ObjArray* sliceArray(Collector* collector, ObjArray* array, int start, int end) {
+    if (end - start < VIEW_MIN_LENGTH) {
+        ObjArray* copy = newArray(collector);
+        pushSafeObj(collector, copy);
+        for (int i = start; i < end; i++) {
+            arrayPush(collector, copy, array->values->values[i]);
+        }
+        popSafe(collector);
+        return copy;
+    }
+    if (array->owner == NULL) {
+        // the buffer moves to a hidden owner, shared by array and its views,
+        // so that writes to array copy instead of showing through the views
+        ObjArray* owner = newArray(collector);
+        *owner->values = *array->values;
+        array->owner = owner;
+    }
+    ObjArray* view = newArray(collector);
+    view->values->values = array->values->values + start;
+    view->values->count = end - start;
+    view->values->capacity = end - start;
+    view->owner = array->owner;
+    return view;
+}
+
 int indexSetDict(Collector* collector, ObjDict* dict, Value* key, Value* value) {
-    int res = mapPut(collector, dict->map, *key, *value);
+    int res = dictPut(collector, dict, *key, *value);
     return res;
 }
 
 int indexGetDict(ObjDict* dict, Value* key, Value* result) {
-    return mapGet(dict->map, *key, result);
+    return dictGet(dict, *key, result);
 }
 
 int valueIndexable(Value val) {
@@ -378,27 +432,38 @@ Value indexSetValue(Collector* collector, Value arrayLike, Value index, Value va
     return result;
 }
 
-ObjString* valueToString(Collector* collector, Value value) {
+// writes the textual form of value, the one used by print and tostr
+void writeValue(ByteBuffer* buffer, Value value) {
     switch (value.type) {
         case VALUE_BOOL:
-            return copyNoLengthString(collector, as_cbool(value) ? "true" : "false");
+            writeCString(buffer, as_cbool(value) ? "true" : "false");
+            break;
         case VALUE_NUMBER:
             {
-#define MAX_DOUBLE_STR_LEN 80
-                char numstr[MAX_DOUBLE_STR_LEN];
-                sprintf(numstr, "%g", as_cnumber(value));
-                return copyNoLengthString(collector, numstr);
-#undef MAX_DOUBLE_STR_LEN
+                reserveByteBuffer(buffer, NUMBER_FORMAT_MAX);
+                buffer->count += formatNumber(as_cnumber(value), buffer->bytes + buffer->count);
+                break;
             }
         case VALUE_NIHL:
-            return copyNoLengthString(collector, "nihl");
+            writeCString(buffer, "nihl");
+            break;
         case VALUE_OBJ:
-            return objectToString(collector, as_obj(value));
+            writeObject(buffer, as_obj(value));
+            break;
     }
 }
 
+ObjString* valueToString(Collector* collector, Value value) {
+    if (is_string(value))
+        return as_string(value);
+    ByteBuffer buffer;
+    initByteBuffer(&buffer);
+    writeValue(&buffer, value);
+    return takeByteBuffer(collector, &buffer);
+}
+
 void printValue(Collector* collector, Value val) {
-    printf("%s", valueToString(collector, val)->chars); 
+    writeValue(&outputBuffer, val);
 }
 
 int isTruthy(Value val) {
@@ -416,6 +481,15 @@ int valuesIntegers(Value a, Value b) {
     return valueInteger(a) && valueInteger(b);
 }
 
+int stringsEqual(ObjString* a, ObjString* b) {
+    // two distinct interned strings never have the same content
+    if ((a->interned && b->interned) || a->length != b->length)
+        return 0;
+    if (a->hashed && b->hashed && ((Obj*) a)->hash != ((Obj*) b)->hash)
+        return 0;
+    return memcmp(string_chars(a), string_chars(b), a->length) == 0;
+}
+
 int valuesEqual(Value a, Value b) {
     if (a.type != b.type)
         return 0;
@@ -423,7 +497,12 @@ int valuesEqual(Value a, Value b) {
         case VALUE_NIHL: return 1;
         case VALUE_NUMBER: return as_cnumber(a) == as_cnumber(b);
         case VALUE_BOOL: return as_cbool(a) == as_cbool(b);
-        case VALUE_OBJ: return as_obj(a) == as_obj(b);
+        case VALUE_OBJ:
+            if (as_obj(a) == as_obj(b))
+                return 1;
+            if (!is_string(a) || !is_string(b))
+                return 0;
+            return stringsEqual(as_string(a), as_string(b));
     }
 }
 
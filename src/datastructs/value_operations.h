@@ -4,6 +4,7 @@
 #include <stdarg.h>
 
 #include "value.h"
+#include "byte_buffer.h"
 
 void indexGetObject(Collector* collector, Obj* array, Value* index, Value* result);
 void indexSetObject(Collector* collector, Obj* array, Value* index, Value* value, Value* result);
@@ -17,6 +18,8 @@ ObjString* vconcatenateMultipleCharArrays(Collector* collector, char* first, va_
 ObjArray* pairList(Collector* collector, Obj* arrayLike);
 Obj* concatenateObjects(Collector* collector, Obj* a, Obj* b);
 void arrayPush(Collector* collector, ObjArray* array, Value value);
+ObjString* sliceString(Collector* collector, ObjString* string, int start, int end);
+ObjArray* sliceArray(Collector* collector, ObjArray* array, int start, int end);
 int indexSetDict(Collector* collector, ObjDict* dict, Value* key, Value* value);
 int indexGetDict(ObjDict* dict, Value* key, Value* result);
 int indexSetArray(Collector* collector, ObjArray* array, Value* index, Value* value, Value* result);
@@ -26,11 +29,13 @@ int indexGetString(Collector* collector, ObjString* string, Value* index, Value*
 
 Value indexGetValue(Collector* collector, Value arrayLike, Value index);
 Value indexSetValue(Collector* collector, Value arrayLike, Value index, Value value);
+void writeValue(ByteBuffer* buffer, Value value);
 ObjString* valueToString(Collector* collector, Value value);
 void printValue(Collector* collector, Value val);
 int isTruthy(Value val); 
 int valueInteger(Value value);
 int valuesIntegers(Value a, Value b); 
+int stringsEqual(ObjString* a, ObjString* b);
 int valuesEqual(Value a, Value b); 
 int valuesConcatenable(Value a, Value b); 
 int arrayLikeLength(Obj* obj);
@@ -40,6 +40,64 @@ static int printArgumentedLongInstruction(char* instname, Bytecode* bytecode, in
     return offset + 3;
 }
 
+static int printCallInstruction(char* instname, Bytecode* bytecode, int offset) {
+    printf("%s arg:[%d] results:[%d]\n", instname, bytecode->code[offset + 1], bytecode->code[offset + 2]);
+    return offset + 3;
+}
+
+static int printCachedInstruction(char* instname, Bytecode* bytecode, int offset) {
+    uint16_t address = join_bytes(bytecode->code[offset + 1], bytecode->code[offset + 2]);
+    uint16_t cache = join_bytes(bytecode->code[offset + 3], bytecode->code[offset + 4]);
+    Value* val = &bytecode->constants.values[address];
+    printf("%s [%d] '", instname, address);
+    dumpValue(*val);
+    printf("' cache:[%d]\n", cache);
+    return offset + 5;
+}
+
+static int printIncrementInstruction(char* instname, Bytecode* bytecode, int offset) {
+    uint8_t arg = bytecode->code[offset + 1];
+    uint8_t address = bytecode->code[offset + 2];
+    printf("%s arg:[%d] [%d] '", instname, arg, address);
+    dumpValue(bytecode->constants.values[address]);
+    printf("'\n");
+    return offset + 3;
+}
+
+// closing: the instruction ends with whether it closes the loop variable
+static int printLoopInstruction(char* instname, Bytecode* bytecode, int offset, int closing) {
+    uint16_t jump = join_bytes(bytecode->code[offset + 1], bytecode->code[offset + 2]);
+    uint16_t slot = join_bytes(bytecode->code[offset + 3], bytecode->code[offset + 4]);
+    printf("%s jump:[%d] slot:[%d]", instname, jump, slot);
+    if (closing)
+        printf(" closes:[%d]", bytecode->code[offset + 5]);
+    printf("\n");
+    return offset + 5 + closing;
+}
+
+static int printJumpTableInstruction(char* instname, Bytecode* bytecode, int offset) {
+    uint16_t address = join_bytes(bytecode->code[offset + 1], bytecode->code[offset + 2]);
+    uint16_t size = join_bytes(bytecode->code[offset + 3], bytecode->code[offset + 4]);
+    uint16_t otherwise = join_bytes(bytecode->code[offset + 5], bytecode->code[offset + 6]);
+    printf("%s [%d] '", instname, address);
+    dumpValue(bytecode->constants.values[address]);
+    printf("' default:[%d] table:[", otherwise);
+    for (int i = 0; i < size; i++) {
+        printf(i == 0 ? "%d" : " %d", join_bytes(bytecode->code[offset + 7 + 2 * i], bytecode->code[offset + 8 + 2 * i]));
+    }
+    printf("]\n");
+    return offset + 7 + 2 * size;
+}
+
+static int printJumpHashInstruction(char* instname, Bytecode* bytecode, int offset) {
+    uint16_t address = join_bytes(bytecode->code[offset + 1], bytecode->code[offset + 2]);
+    uint16_t otherwise = join_bytes(bytecode->code[offset + 3], bytecode->code[offset + 4]);
+    printf("%s [%d] '", instname, address);
+    dumpValue(bytecode->constants.values[address]);
+    printf("' default:[%d]\n", otherwise);
+    return offset + 5;
+}
+
 void printBytecode(Bytecode* bytecode, char* name) {
     printf("bytecode => %s\n", name);
     for (int i = 0; i < bytecode->count; ) {
@@ -53,6 +111,9 @@ int printInstruction(Bytecode* bytecode, OpCode code, int offset) {
 #define print_addressed_long_instruction(op) case op: return printAddressedLongInstruction(#op, bytecode, offset);
 #define print_argumented_instruction(op) case op: return printArgumentedInstruction(#op, bytecode, offset);
 #define print_argumented_long_instruction(op) case op: return printArgumentedLongInstruction(#op, bytecode, offset);
+#define print_cached_instruction(op) case op: return printCachedInstruction(#op, bytecode, offset);
+#define print_increment_instruction(op) case op: return printIncrementInstruction(#op, bytecode, offset);
+#define print_loop_instruction(op, c) case op: return printLoopInstruction(#op, bytecode, offset, c);
 #define print_closure(op, l) \
     case op: \
              { \
@@ -95,15 +156,19 @@ int printInstruction(Bytecode* bytecode, OpCode code, int offset) {
             print_argumented_long_instruction(OP_JUMP_IF_TRUE)
             print_argumented_long_instruction(OP_JUMP)
             print_argumented_long_instruction(OP_JUMP_BACK)
-            print_argumented_instruction(OP_CALL)
+            case OP_JUMP_TABLE: return printJumpTableInstruction("OP_JUMP_TABLE", bytecode, offset);
+            case OP_JUMP_HASH: return printJumpHashInstruction("OP_JUMP_HASH", bytecode, offset);
+            case OP_CALL: return printCallInstruction("OP_CALL", bytecode, offset);
             print_argumented_instruction(OP_ARRAY)
             print_argumented_long_instruction(OP_ARRAY_LONG)
             print_argumented_instruction(OP_DICT)
             print_argumented_long_instruction(OP_DICT_LONG)
-            print_simple_instruction(OP_RET)
+            print_argumented_instruction(OP_RET)
             print_simple_instruction(OP_CLOSE_UPVALUE)
             print_simple_instruction(OP_INDEXING_GET)
             print_simple_instruction(OP_INDEXING_SET)
+            print_cached_instruction(OP_INDEXING_GET_STR)
+            print_cached_instruction(OP_INDEXING_SET_STR)
             print_simple_instruction(OP_XOR)
             print_simple_instruction(OP_NEGATE)
             print_simple_instruction(OP_ADD)
@@ -124,6 +189,19 @@ int printInstruction(Bytecode* bytecode, OpCode code, int offset) {
             print_simple_instruction(OP_EQUAL)
             print_simple_instruction(OP_CONCAT)
             print_simple_instruction(OP_PRINT)
+            print_simple_instruction(OP_YIELD)
+            print_simple_instruction(OP_ADD_NUM)
+            print_simple_instruction(OP_SUB_NUM)
+            print_simple_instruction(OP_MUL_NUM)
+            print_simple_instruction(OP_LESS_NUM)
+            print_simple_instruction(OP_LESS_EQUAL_NUM)
+            print_simple_instruction(OP_GREATER_NUM)
+            print_simple_instruction(OP_GREATER_EQUAL_NUM)
+            print_increment_instruction(OP_LOCAL_INCREMENT)
+            print_loop_instruction(OP_FOR_PREP, 0)
+            print_loop_instruction(OP_FOR_RANGE, 1)
+            print_loop_instruction(OP_ITER_PREP, 0)
+            print_loop_instruction(OP_ITER_NEXT, 1)
         default:
             printf("Undefined instruction: [opcode = %d]\n", code);
             return offset + 1;
@@ -133,5 +211,8 @@ int printInstruction(Bytecode* bytecode, OpCode code, int offset) {
 #undef print_simple_instruction
 #undef print_argumented_instruction
 #undef print_argumented_long_instruction
+#undef print_cached_instruction
+#undef print_increment_instruction
+#undef print_loop_instruction
 #undef print_closure
 }
@@ -9,22 +9,28 @@ void printEntry(Entry* entry) {
     dumpValue(entry->value);
 }
 
-static void printBucket(Entry* head) {
-    printf("    bucket:\n");
-    while (head != NULL) {
-        printf("    ");
-        printEntry(head);
+void printMap(HashMap* map) {
+    printf("{\n");
+    for (int i = 0; i < map->entriesCount; i++) {
+        Entry* entry = &map->entries[i];
+        if (entry_is_deleted(entry))
+            continue;
+        printf("    [%d] ", i);
+        printEntry(entry);
         printf(";\n");
-        head = head->next;
     }
+    printf("}\n");
 }
 
-void printMap(HashMap* map) {
+void printStringSet(StringSet* set) {
     printf("{\n");
-    for (int i = 0; i < map->capacity; i++) {
-        if (map->entries[i] != NULL) {
-            printBucket(map->entries[i]);
-        }
+    for (int i = 0; i < set->capacity; i++) {
+        StringSetEntry* entry = &set->entries[i];
+        if (entry->string == NULL)
+            continue;
+        printf("    [%d] ", i);
+        dumpValue(to_vobj(entry->string));
+        printf(";\n");
     }
     printf("}\n");
 }
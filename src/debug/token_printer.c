@@ -34,6 +34,7 @@ void printToken(Token tok) {
             TOKEN_PRINT_CASE(TOK_GREATER_EQUAL)
             TOKEN_PRINT_CASE(TOK_LESS)
             TOKEN_PRINT_CASE(TOK_LESS_EQUAL)
+            TOKEN_PRINT_CASE(TOK_DOT_DOT)
             TOKEN_PRINT_CASE(TOK_IDENTIFIER)
             TOKEN_PRINT_CASE(TOK_STRING)
             TOKEN_PRINT_CASE(TOK_NUMBER)
@@ -53,6 +54,10 @@ void printToken(Token tok) {
             TOKEN_PRINT_CASE(TOK_NIHL)
             TOKEN_PRINT_CASE(TOK_BREAK)
             TOKEN_PRINT_CASE(TOK_CONTINUE)
+            TOKEN_PRINT_CASE(TOK_CONST)
+            TOKEN_PRINT_CASE(TOK_FOR)
+            TOKEN_PRINT_CASE(TOK_YIELD)
+            TOKEN_PRINT_CASE(TOK_MATCH)
             TOKEN_PRINT_CASE(TOK_INDENT)
             TOKEN_PRINT_CASE(TOK_DEDENT)
             TOKEN_PRINT_CASE(TOK_NEW_LINE)
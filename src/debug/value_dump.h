@@ -27,7 +27,7 @@ static void dumpValue(Value val) {
 static void dumpObj(Obj* obj) {
     switch (obj->type) {
         case OBJ_STRING:
-            printf("%s", ((ObjString*) obj)->chars);
+            printf("%.*s", ((ObjString*) obj)->length, string_chars((ObjString*) obj));
             break;
         case OBJ_FUNCTION:
             {
@@ -79,6 +79,16 @@ static void dumpObj(Obj* obj) {
                 printf("[dict %p]", (void*) obj);
                 break;
             }
+        case OBJ_BUFFER:
+            {
+                printf("[buffer %p]", (void*) obj);
+                break;
+            }
+        case OBJ_GENERATOR:
+            {
+                printf("[generator %p]", (void*) obj);
+                break;
+            }
     }
 }
 
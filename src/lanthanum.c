@@ -4,6 +4,8 @@
 
 #include "./memory.h"
 #include "vm.h"
+#include "util.h"
+#include "output.h"
 #include "./compilation_pipeline/compiler.h"
 
 static char* readFile(const char* path) {
@@ -34,9 +36,9 @@ static char* readFile(const char* path) {
     return buffer;
 }
 
-static void runFile(const char* fname, VM* vm, Compiler* compiler, Collector* collector) {
+static void runFile(const char* fname, VM* vm, Compiler* compiler, Collector* collector, int optimizationLevel) {
     char* source = readFile(fname);
-    ObjFunction* function = compile(compiler, collector, source);
+    ObjFunction* function = compile(compiler, collector, source, optimizationLevel);
     if (function == NULL) { // compile error
         exit(1);
     }
@@ -46,16 +48,36 @@ static void runFile(const char* fname, VM* vm, Compiler* compiler, Collector* co
     }
 }
 
+// -O0 disables the optimizer, -O1 runs the basic passes and -O2 (the default) all of them
+static int parseOptimizationLevel(const char* flag) {
+    if (strcmp(flag, "-O0") == 0)
+        return OPTIMIZATION_NONE;
+    if (strcmp(flag, "-O1") == 0)
+        return OPTIMIZATION_BASIC;
+    if (strcmp(flag, "-O2") == 0)
+        return OPTIMIZATION_FULL;
+    fprintf(stderr, "error: unknown option \"%s\"\n", flag);
+    exit(1);
+}
+
 int main(int argc, char **argv) {
-    if (argc <= 1) {
+    int optimizationLevel = OPTIMIZATION_FULL;
+    int fileIndex = 1;
+    while (fileIndex < argc && argv[fileIndex][0] == '-') {
+        optimizationLevel = parseOptimizationLevel(argv[fileIndex]);
+        fileIndex++;
+    }
+    if (fileIndex >= argc) {
         fprintf(stderr, "error: missing files names\n");
         exit(1);
     }
+    initHashSeed();
+    atexit(flushOutput);
     Collector collector;
     initCollector(&collector);
     VM vm;
     Compiler compiler;
 
-    runFile(argv[1], &vm, &compiler, &collector);
+    runFile(argv[fileIndex], &vm, &compiler, &collector, optimizationLevel);
     return 0;
 }
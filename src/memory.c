@@ -4,7 +4,15 @@
 #include "memory.h"
 #include "./debug/debug_switches.h"
 
+static void blackenWorklist(struct sCollector* collector) {
+    for (int i = 0; i < collector->worklistCount; i++) {
+        blackenObject(collector, collector->worklist[i]);
+    }
+    collector->worklistCount = 0;
+}
+
 static void collectGarbage(struct sCollector* collector) {
+    collector->collecting = 1;
 #ifdef TRACE_GC
     printf("START GC\n");
     size_t oldAllocatedBytes = collector->allocatedBytes;
@@ -19,6 +27,12 @@ static void collectGarbage(struct sCollector* collector) {
 
     markMap(collector, &collector->vm->globals);
 
+    // mark single byte strings
+
+    for (int i = 0; i < 256; i++) {
+        markObject(collector, (Obj*) collector->singleChars[i]);
+    }
+
     // todo: mark frames (mark main script function)
     
     // mark open upvalues
@@ -29,14 +43,18 @@ static void collectGarbage(struct sCollector* collector) {
 
     // blacken
     
-    for (int i = 0; i < collector->worklistCount; i++) {
-        blackenObject(collector, collector->worklist[i]);
+    blackenWorklist(collector);
+
+    // settle views: marking a kept owner may reach further views
+
+    while (collector->viewsCount > 0) {
+        settleView(collector, collector->views[--collector->viewsCount]);
+        blackenWorklist(collector);
     }
-    collector->worklistCount = 0;
 
-    // remove unmarked interned
+    // drop dead shapes
 
-    removeUnmarkedKeys(collector, &collector->interned);
+    sweepShapes(collector);
 
     // sweep
 
@@ -52,6 +70,9 @@ static void collectGarbage(struct sCollector* collector) {
                 previous->next = object->next;
                 object = object->next;
             }
+            // interned strings die here: dropping them from the weak set costs one probe each
+            if (toFree->type == OBJ_STRING && ((ObjString*) toFree)->interned)
+                stringSetRemove(&collector->interned, (ObjString*) toFree);
             freeObject(NULL, toFree);
         } else {
             object->marked = 0;
@@ -63,6 +84,7 @@ static void collectGarbage(struct sCollector* collector) {
     // update threshold
     
     collector->triggerGCThreshold = collector->allocatedBytes * GC_TRESHOLD_FACTOR;
+    collector->collecting = 0;
 #ifdef TRACE_GC
     printf("freed bytes: %d\n", oldAllocatedBytes - collector->allocatedBytes);
     printf("END GC\n");
@@ -72,7 +94,7 @@ static void collectGarbage(struct sCollector* collector) {
 void* reallocate(Collector* collector, void* pointer, size_t oldsize, size_t newsize) {
     if (collector != NULL) {
         collector->allocatedBytes += newsize - oldsize;
-        if (collector->vm != NULL && oldsize < newsize) {
+        if (collector->vm != NULL && !collector->collecting && oldsize < newsize) {
 #ifndef STRESS_GC
             if (collector->allocatedBytes >= collector->triggerGCThreshold) {
                 collectGarbage(collector);
@@ -96,13 +118,26 @@ void initCollector(Collector* collector) {
     collector->worklist = NULL;
     collector->worklistCount = 0;
     collector->worklistCapacity = 0;
+    collector->views = NULL;
+    collector->viewsCount = 0;
+    collector->viewsCapacity = 0;
+    collector->collecting = 0;
     collector->allocatedBytes = 0;
     collector->triggerGCThreshold = BASE_TRIGGER_GC_THRESHOLD;
-    initMap(&collector->interned);
+    initStringSet(&collector->interned);
+    collector->shapes = NULL;
+    collector->rootShape = newRootShape(collector);
+    for (int i = 0; i < 256; i++) {
+        char* chars = allocate_block(collector, char, 2);
+        chars[0] = (char) i;
+        chars[1] = '\0';
+        collector->singleChars[i] = internString(collector, takeString(collector, chars, 1));
+    }
 }
 
 void freeCollector(Collector* collector) {
-    freeMap(NULL, &collector->interned);
+    freeStringSet(NULL, &collector->interned);
+    freeShapes(collector);
     while (collector->objects != NULL) {
         Obj* next = collector->objects->next;
         freeObject(NULL, collector->objects);
@@ -110,6 +145,16 @@ void freeCollector(Collector* collector) {
     }
     if (collector->worklist != NULL)
         free(collector->worklist);
+    if (collector->views != NULL)
+        free(collector->views);
+}
+
+void recordView(struct sCollector* collector, Obj* view) {
+    if (collector->viewsCapacity <= collector->viewsCount + 1) {
+        collector->viewsCapacity = compute_capacity(collector->viewsCapacity);
+        collector->views = realloc(collector->views, sizeof(Obj*) * collector->viewsCapacity);
+    }
+    collector->views[collector->viewsCount++] = view;
 }
 
 void pushSafe(struct sCollector* collector, Value value) {
@@ -6,23 +6,34 @@
 #include "./commontypes.h"
 #include "./datastructs/value.h"
 #include "./datastructs/hash_map.h"
+#include "./datastructs/shape.h"
+#include "./datastructs/string_set.h"
 #include "vm.h"
 
 #define BASE_TRIGGER_GC_THRESHOLD (1024 * 1024)
 #define GC_TRESHOLD_FACTOR 2
 
 struct sCollector {
-    HashMap interned;
+    StringSet interned;
+    Shape* shapes;
+    Shape* rootShape;
+    ObjString* singleChars[256]; // every one byte string, interned and never collected
     VM* vm;
     Obj* objects;
     size_t allocated;
     Obj** worklist;
     int worklistCount;
     int worklistCapacity;
+    Obj** views; // marked slice views, settled once marking is done
+    int viewsCount;
+    int viewsCapacity;
+    int collecting;
     size_t allocatedBytes;
     size_t triggerGCThreshold;
 };
 
+#define single_char_string(collector, c) ((collector)->singleChars[(uint8_t) (c)])
+
 #define compute_capacity(oldcap) \
     ((oldcap) < 8 ? 8 : (oldcap) * 2)
 
@@ -48,6 +59,7 @@ void* reallocate(struct sCollector* collector, void* pointer, size_t oldsize, si
 void initCollector(struct sCollector* collector); 
 void freeCollector(struct sCollector* collector); 
 #define pushSafeObj(collector, obj) pushSafe(collector, to_vobj(obj))
+void recordView(struct sCollector* collector, Obj* view);
 void pushSafe(struct sCollector* collector, Value value);
 void popSafe(struct sCollector* collector);
 
@@ -1,12 +1,14 @@
 #include <stdlib.h>
 
 #include "natives.h"
+#include "../output.h"
+#include "../number_format.h"
 
-Value nativeToStr(VM* vm, Value* args) {
+Value nativeToStr(VM* vm, int argCount, Value* args) {
     return to_vobj(valueToString(vm->collector, args[0]));
 }
 
-Value nativeTypeOf(VM* vm, Value* args) {
+Value nativeTypeOf(VM* vm, int argCount, Value* args) {
     Value arg = args[0];
     switch (arg.type) {
         case VALUE_NUMBER:
@@ -20,7 +22,7 @@ Value nativeTypeOf(VM* vm, Value* args) {
     }
 }
 
-Value nativeTypeOfObject(VM* vm, Value* args) {
+Value nativeTypeOfObject(VM* vm, int argCount, Value* args) {
     Obj* arg = as_obj(args[0]);
     switch (arg->type) {
         case OBJ_STRING: 
@@ -39,19 +41,28 @@ Value nativeTypeOfObject(VM* vm, Value* args) {
             return to_vobj(copyNoLengthString(vm->collector, "array"));
         case OBJ_DICT:
             return to_vobj(copyNoLengthString(vm->collector, "dictionary"));
+        case OBJ_BUFFER:
+            return to_vobj(copyNoLengthString(vm->collector, "buffer"));
+        case OBJ_GENERATOR:
+            return to_vobj(copyNoLengthString(vm->collector, "generator"));
         default:
             return to_vobj(newErrorFromCharArray(vm->collector, "value is not an object"));
     }
 }
 
-Value nativeSystem(VM* vm, Value* args) {
+Value nativeSystem(VM* vm, int argCount, Value* args) {
     Value arg = args[0];
     if (!is_string(arg))
         return to_vobj(newErrorFromCharArray(vm->collector, "passed non string to system"));
-    return to_vnumber(system(as_cstring(arg)));
+    ObjString* command = as_string(arg);
+    // slice views are not NUL terminated
+    if (command->owner != NULL)
+        command = copyString(vm->collector, command->chars, command->length);
+    flushOutput();
+    return to_vnumber(system(string_chars(command)));
 }
 
-Value nativeLen(VM* vm, Value* args) {
+Value nativeLen(VM* vm, int argCount, Value* args) {
     Value arg = args[0];
     if (!is_string(arg) && !is_array(arg))
         return to_vobj(newErrorFromCharArray(vm->collector, "length computable only for strings and arrays"));
@@ -59,10 +70,120 @@ Value nativeLen(VM* vm, Value* args) {
     return to_vnumber(arrayLikeLength(obj));
 }
 
-Value nativePairList(VM* vm, Value* args) {
+Value nativePairList(VM* vm, int argCount, Value* args) {
     Value arg = args[0];
     if (!valueIndexable(arg))
         return to_vobj(newErrorFromCharArray(vm->collector, "value not indexable"));
     Obj* obj = as_obj(arg);
     return to_vobj(pairList(vm->collector, obj));
 }
+
+// bounds are clamped to the sequence, the result shares its storage when large enough
+Value nativeSlice(VM* vm, int argCount, Value* args) {
+    Value arg = args[0];
+    if (!is_string(arg) && !is_array(arg))
+        return to_vobj(newErrorFromCharArray(vm->collector, "slice computable only for strings and arrays"));
+    if (!valueInteger(args[1]) || !valueInteger(args[2]))
+        return to_vobj(newErrorFromCharArray(vm->collector, "slice bounds must be integers"));
+    int length = arrayLikeLength(as_obj(arg));
+    double start = as_cnumber(args[1]);
+    double end = as_cnumber(args[2]);
+    start = start < 0 ? 0 : start > length ? length : start;
+    end = end < start ? start : end > length ? length : end;
+    if (is_string(arg))
+        return to_vobj(sliceString(vm->collector, as_string(arg), (int) start, (int) end));
+    return to_vobj(sliceArray(vm->collector, as_array(arg), (int) start, (int) end));
+}
+
+Value nativeNewBuffer(VM* vm, int argCount, Value* args) {
+    return to_vobj(newBuffer(vm->collector));
+}
+
+// strings are appended as they are, other values in their printed form
+Value nativeAppend(VM* vm, int argCount, Value* args) {
+    if (!is_buffer(args[0]))
+        return to_vobj(newErrorFromCharArray(vm->collector, "can append only to buffers"));
+    writeValue(&as_buffer(args[0])->bytes, args[1]);
+    return args[0];
+}
+
+Value nativeAppendNumber(VM* vm, int argCount, Value* args) {
+    if (!is_buffer(args[0]))
+        return to_vobj(newErrorFromCharArray(vm->collector, "can append only to buffers"));
+    if (!is_number(args[1]))
+        return to_vobj(newErrorFromCharArray(vm->collector, "appendnum expects a number"));
+    ByteBuffer* bytes = &as_buffer(args[0])->bytes;
+    reserveByteBuffer(bytes, NUMBER_FORMAT_MAX);
+    bytes->count += formatNumber(as_cnumber(args[1]), bytes->bytes + bytes->count);
+    return args[0];
+}
+
+Value nativeBufferLength(VM* vm, int argCount, Value* args) {
+    if (!is_buffer(args[0]))
+        return to_vobj(newErrorFromCharArray(vm->collector, "buflen expects a buffer"));
+    return to_vnumber(as_buffer(args[0])->bytes.count);
+}
+
+// hands the buffer's bytes over to a new string: the buffer is left empty
+Value nativeFreeze(VM* vm, int argCount, Value* args) {
+    if (!is_buffer(args[0]))
+        return to_vobj(newErrorFromCharArray(vm->collector, "freeze expects a buffer"));
+    return to_vobj(takeByteBuffer(vm->collector, &as_buffer(args[0])->bytes));
+}
+
+Value nativeJoin(VM* vm, int argCount, Value* args) {
+    if (!is_array(args[0]) || !is_string(args[1]))
+        return to_vobj(newErrorFromCharArray(vm->collector, "join expects an array and a string separator"));
+    ValueArray* values = as_array(args[0])->values;
+    ObjString* separator = as_string(args[1]);
+    if (values->count == 0)
+        return to_vobj(copyString(vm->collector, "", 0));
+    // strings make up the whole result in the common case: size it once
+    int length = separator->length * (values->count - 1);
+    for (int i = 0; i < values->count; i++) {
+        if (is_string(values->values[i]))
+            length += as_string(values->values[i])->length;
+    }
+    ByteBuffer buffer;
+    initByteBuffer(&buffer);
+    reserveByteBuffer(&buffer, length + 1);
+    char* separatorChars = string_chars(separator);
+    for (int i = 0; i < values->count; i++) {
+        if (i > 0)
+            writeBytes(&buffer, separatorChars, separator->length);
+        writeValue(&buffer, values->values[i]);
+    }
+    return to_vobj(takeByteBuffer(vm->collector, &buffer));
+}
+
+// format(template, ...) replaces each {} in template with the next argument
+Value nativeFormat(VM* vm, int argCount, Value* args) {
+    if (argCount == 0 || !is_string(args[0]))
+        return to_vobj(newErrorFromCharArray(vm->collector, "format expects a template string"));
+    ObjString* template = as_string(args[0]);
+    char* chars = string_chars(template);
+    int length = template->length;
+    for (int i = 1; i < argCount; i++) {
+        if (is_string(args[i]))
+            length += as_string(args[i])->length;
+    }
+    ByteBuffer buffer;
+    initByteBuffer(&buffer);
+    reserveByteBuffer(&buffer, length + 1);
+    int next = 1;
+    int start = 0;
+    for (int i = 0; i + 1 < template->length; i++) {
+        if (chars[i] != '{' || chars[i + 1] != '}')
+            continue;
+        if (next >= argCount) {
+            freeByteBuffer(&buffer);
+            return to_vobj(newErrorFromCharArray(vm->collector, "format has more placeholders than arguments"));
+        }
+        writeBytes(&buffer, chars + start, i - start);
+        writeValue(&buffer, args[next++]);
+        start = i + 2;
+        i++;
+    }
+    writeBytes(&buffer, chars + start, template->length - start);
+    return to_vobj(takeByteBuffer(vm->collector, &buffer));
+}
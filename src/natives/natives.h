@@ -3,12 +3,20 @@
 
 #include "natives_common.h"
 
-Value nativeToStr(VM* vm, Value* args);
-Value nativeTypeOf(VM* vm, Value* args);
-Value nativeTypeOfObject(VM* vm, Value* args);
-Value nativeSystem(VM* vm, Value* args);
-Value nativeLen(VM* vm, Value* args);
-Value nativePairList(VM* vm, Value* args);
+Value nativeToStr(VM* vm, int argCount, Value* args);
+Value nativeTypeOf(VM* vm, int argCount, Value* args);
+Value nativeTypeOfObject(VM* vm, int argCount, Value* args);
+Value nativeSystem(VM* vm, int argCount, Value* args);
+Value nativeLen(VM* vm, int argCount, Value* args);
+Value nativePairList(VM* vm, int argCount, Value* args);
+Value nativeSlice(VM* vm, int argCount, Value* args);
+Value nativeNewBuffer(VM* vm, int argCount, Value* args);
+Value nativeAppend(VM* vm, int argCount, Value* args);
+Value nativeAppendNumber(VM* vm, int argCount, Value* args);
+Value nativeBufferLength(VM* vm, int argCount, Value* args);
+Value nativeFreeze(VM* vm, int argCount, Value* args);
+Value nativeJoin(VM* vm, int argCount, Value* args);
+Value nativeFormat(VM* vm, int argCount, Value* args);
 
 #define natives_h_declare(vm) \
     vmDeclareNative(vm, 1, "tostr", &nativeToStr); \
@@ -17,5 +25,13 @@ Value nativePairList(VM* vm, Value* args);
     vmDeclareNative(vm, 1, "system", &nativeSystem); \
     vmDeclareNative(vm, 1, "len", &nativeLen); \
     vmDeclareNative(vm, 1, "pairList", &nativePairList); \
+    vmDeclareNative(vm, 3, "slice", &nativeSlice); \
+    vmDeclareNative(vm, 0, "newbuffer", &nativeNewBuffer); \
+    vmDeclareNative(vm, 2, "append", &nativeAppend); \
+    vmDeclareNative(vm, 2, "appendnum", &nativeAppendNumber); \
+    vmDeclareNative(vm, 1, "buflen", &nativeBufferLength); \
+    vmDeclareNative(vm, 1, "freeze", &nativeFreeze); \
+    vmDeclareNative(vm, 2, "join", &nativeJoin); \
+    vmDeclareNative(vm, NATIVE_VARIADIC, "format", &nativeFormat); \
 
 #endif
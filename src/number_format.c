@@ -0,0 +1,266 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "number_format.h"
+#include "util.h"
+
+// shortest round-trip formatting of doubles with the Grisu2 algorithm
+// (Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with Integers")
+
+typedef struct {
+    uint64_t f;
+    int e;
+} DiyFp;
+
+#define DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define DP_EXPONENT_MASK 0x7FF0000000000000ULL
+#define DP_HIDDEN_BIT 0x0010000000000000ULL
+#define DP_SIGNIFICAND_SIZE 52
+#define DP_EXPONENT_BIAS (0x3FF + DP_SIGNIFICAND_SIZE)
+#define DP_MIN_EXPONENT (-DP_EXPONENT_BIAS)
+
+// normalized 10^k for k = -348, -340, ..., 340 (generated with exact rational arithmetic)
+static const DiyFp cachedPowers[] = {
+    {0xfa8fd5a0081c0288ULL, -1220}, {0xbaaee17fa23ebf76ULL, -1193}, {0x8b16fb203055ac76ULL, -1166},
+    {0xcf42894a5dce35eaULL, -1140}, {0x9a6bb0aa55653b2dULL, -1113}, {0xe61acf033d1a45dfULL, -1087},
+    {0xab70fe17c79ac6caULL, -1060}, {0xff77b1fcbebcdc4fULL, -1034}, {0xbe5691ef416bd60cULL, -1007},
+    {0x8dd01fad907ffc3cULL, -980}, {0xd3515c2831559a83ULL, -954}, {0x9d71ac8fada6c9b5ULL, -927},
+    {0xea9c227723ee8bcbULL, -901}, {0xaecc49914078536dULL, -874}, {0x823c12795db6ce57ULL, -847},
+    {0xc21094364dfb5637ULL, -821}, {0x9096ea6f3848984fULL, -794}, {0xd77485cb25823ac7ULL, -768},
+    {0xa086cfcd97bf97f4ULL, -741}, {0xef340a98172aace5ULL, -715}, {0xb23867fb2a35b28eULL, -688},
+    {0x84c8d4dfd2c63f3bULL, -661}, {0xc5dd44271ad3cdbaULL, -635}, {0x936b9fcebb25c996ULL, -608},
+    {0xdbac6c247d62a584ULL, -582}, {0xa3ab66580d5fdaf6ULL, -555}, {0xf3e2f893dec3f126ULL, -529},
+    {0xb5b5ada8aaff80b8ULL, -502}, {0x87625f056c7c4a8bULL, -475}, {0xc9bcff6034c13053ULL, -449},
+    {0x964e858c91ba2655ULL, -422}, {0xdff9772470297ebdULL, -396}, {0xa6dfbd9fb8e5b88fULL, -369},
+    {0xf8a95fcf88747d94ULL, -343}, {0xb94470938fa89bcfULL, -316}, {0x8a08f0f8bf0f156bULL, -289},
+    {0xcdb02555653131b6ULL, -263}, {0x993fe2c6d07b7facULL, -236}, {0xe45c10c42a2b3b06ULL, -210},
+    {0xaa242499697392d3ULL, -183}, {0xfd87b5f28300ca0eULL, -157}, {0xbce5086492111aebULL, -130},
+    {0x8cbccc096f5088ccULL, -103}, {0xd1b71758e219652cULL, -77}, {0x9c40000000000000ULL, -50},
+    {0xe8d4a51000000000ULL, -24}, {0xad78ebc5ac620000ULL, 3}, {0x813f3978f8940984ULL, 30},
+    {0xc097ce7bc90715b3ULL, 56}, {0x8f7e32ce7bea5c70ULL, 83}, {0xd5d238a4abe98068ULL, 109},
+    {0x9f4f2726179a2245ULL, 136}, {0xed63a231d4c4fb27ULL, 162}, {0xb0de65388cc8ada8ULL, 189},
+    {0x83c7088e1aab65dbULL, 216}, {0xc45d1df942711d9aULL, 242}, {0x924d692ca61be758ULL, 269},
+    {0xda01ee641a708deaULL, 295}, {0xa26da3999aef774aULL, 322}, {0xf209787bb47d6b85ULL, 348},
+    {0xb454e4a179dd1877ULL, 375}, {0x865b86925b9bc5c2ULL, 402}, {0xc83553c5c8965d3dULL, 428},
+    {0x952ab45cfa97a0b3ULL, 455}, {0xde469fbd99a05fe3ULL, 481}, {0xa59bc234db398c25ULL, 508},
+    {0xf6c69a72a3989f5cULL, 534}, {0xb7dcbf5354e9beceULL, 561}, {0x88fcf317f22241e2ULL, 588},
+    {0xcc20ce9bd35c78a5ULL, 614}, {0x98165af37b2153dfULL, 641}, {0xe2a0b5dc971f303aULL, 667},
+    {0xa8d9d1535ce3b396ULL, 694}, {0xfb9b7cd9a4a7443cULL, 720}, {0xbb764c4ca7a44410ULL, 747},
+    {0x8bab8eefb6409c1aULL, 774}, {0xd01fef10a657842cULL, 800}, {0x9b10a4e5e9913129ULL, 827},
+    {0xe7109bfba19c0c9dULL, 853}, {0xac2820d9623bf429ULL, 880}, {0x80444b5e7aa7cf85ULL, 907},
+    {0xbf21e44003acdd2dULL, 933}, {0x8e679c2f5e44ff8fULL, 960}, {0xd433179d9c8cb841ULL, 986},
+    {0x9e19db92b4e31ba9ULL, 1013}, {0xeb96bf6ebadf77d9ULL, 1039}, {0xaf87023b9bf0ee6bULL, 1066},
+};
+
+static const uint64_t pow10s[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static DiyFp diyFpFromDouble(double value) {
+    uint64_t bits = double_to_bits(value);
+    int biasedExponent = (int) ((bits & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_SIZE);
+    uint64_t significand = bits & DP_SIGNIFICAND_MASK;
+    if (biasedExponent != 0)
+        return (DiyFp) {significand + DP_HIDDEN_BIT, biasedExponent - DP_EXPONENT_BIAS};
+    return (DiyFp) {significand, DP_MIN_EXPONENT + 1};
+}
+
+// product rounded to the upper 64 bits
+static DiyFp diyFpMultiply(DiyFp x, DiyFp y) {
+    uint64_t mask = 0xFFFFFFFFULL;
+    uint64_t a = x.f >> 32, b = x.f & mask, c = y.f >> 32, d = y.f & mask;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & mask) + (bc & mask);
+    tmp += 1ULL << 31;
+    return (DiyFp) {ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64};
+}
+
+static DiyFp diyFpNormalize(DiyFp x) {
+    while (!(x.f & (1ULL << 63))) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+// boundaries m- and m+ of the rounding interval of v, sharing m+'s normalized exponent
+static void normalizedBoundaries(DiyFp v, DiyFp* minus, DiyFp* plus) {
+    DiyFp upper = {(v.f << 1) + 1, v.e - 1};
+    upper = diyFpNormalize(upper);
+    // the interval is asymmetric when v is a power of two
+    DiyFp lower = v.f == DP_HIDDEN_BIT ? (DiyFp) {(v.f << 2) - 1, v.e - 2} : (DiyFp) {(v.f << 1) - 1, v.e - 1};
+    lower.f <<= lower.e - upper.e;
+    lower.e = upper.e;
+    *minus = lower;
+    *plus = upper;
+}
+
+// cached power c = 10^-k such that the exponent of c * 2^e lands in [-60, -32]
+static DiyFp cachedPower(int e, int* k) {
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int ik = (int) dk;
+    if (dk - ik > 0.0)
+        ik++;
+    int index = (ik >> 3) + 1;
+    *k = -(-348 + index * 8);
+    return cachedPowers[index];
+}
+
+// moves the last digit towards w while staying inside the unsafe interval
+static void grisuRound(char* buffer, int length, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t wpw) {
+    while (rest < wpw && delta - rest >= tenKappa
+            && (rest + tenKappa < wpw || wpw - rest > rest + tenKappa - wpw)) {
+        buffer[length - 1]--;
+        rest += tenKappa;
+    }
+}
+
+static int countDecimalDigits(uint32_t n) {
+    int digits = 1;
+    while (digits < 10 && n >= pow10s[digits]) {
+        digits++;
+    }
+    return digits;
+}
+
+static int digitGen(DiyFp w, DiyFp mp, uint64_t delta, char* buffer, int* k) {
+    DiyFp one = {1ULL << -mp.e, mp.e};
+    uint64_t wpw = mp.f - w.f;
+    uint32_t p1 = (uint32_t) (mp.f >> -one.e);
+    uint64_t p2 = mp.f & (one.f - 1);
+    int kappa = countDecimalDigits(p1);
+    int length = 0;
+    while (kappa > 0) {
+        uint32_t divisor = (uint32_t) pow10s[kappa - 1];
+        uint32_t digit = p1 / divisor;
+        p1 %= divisor;
+        if (digit || length)
+            buffer[length++] = (char) ('0' + digit);
+        kappa--;
+        uint64_t rest = ((uint64_t) p1 << -one.e) + p2;
+        if (rest <= delta) {
+            *k += kappa;
+            grisuRound(buffer, length, delta, rest, pow10s[kappa] << -one.e, wpw);
+            return length;
+        }
+    }
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char digit = (char) (p2 >> -one.e);
+        if (digit || length)
+            buffer[length++] = (char) ('0' + digit);
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            *k += kappa;
+            grisuRound(buffer, length, delta, p2, one.f, wpw * pow10s[-kappa]);
+            return length;
+        }
+    }
+}
+
+// writes the shortest digits of a positive finite value: value = digits * 10^k
+static int grisu2(double value, char* buffer, int* k) {
+    DiyFp v = diyFpFromDouble(value);
+    DiyFp minus, plus;
+    normalizedBoundaries(v, &minus, &plus);
+    DiyFp c = cachedPower(plus.e, k);
+    DiyFp w = diyFpMultiply(diyFpNormalize(v), c);
+    DiyFp wp = diyFpMultiply(plus, c);
+    DiyFp wm = diyFpMultiply(minus, c);
+    wm.f++;
+    wp.f--;
+    return digitGen(w, wp, wp.f - wm.f, buffer, k);
+}
+
+static int writeExponent(int exponent, char* buffer) {
+    int length = 0;
+    buffer[length++] = 'e';
+    buffer[length++] = exponent < 0 ? '-' : '+';
+    if (exponent < 0)
+        exponent = -exponent;
+    if (exponent >= 100)
+        buffer[length++] = (char) ('0' + exponent / 100);
+    if (exponent >= 10)
+        buffer[length++] = (char) ('0' + exponent / 10 % 10);
+    buffer[length++] = (char) ('0' + exponent % 10);
+    return length;
+}
+
+// lays out digits * 10^k like javascript does: plain notation for
+// 1e-7 < |value| < 1e21, exponential notation otherwise
+static int prettify(char* buffer, int length, int k) {
+    int point = length + k; // value = 0.digits * 10^point
+    if (k >= 0 && point <= 21) {
+        memset(buffer + length, '0', k);
+        return point;
+    }
+    if (point > 0 && point <= 21) {
+        memmove(buffer + point + 1, buffer + point, length - point);
+        buffer[point] = '.';
+        return length + 1;
+    }
+    if (point > -6 && point <= 0) {
+        int shift = 2 - point;
+        memmove(buffer + shift, buffer, length);
+        buffer[0] = '0';
+        buffer[1] = '.';
+        memset(buffer + 2, '0', -point);
+        return length + shift;
+    }
+    if (length == 1)
+        return 1 + writeExponent(point - 1, buffer + 1);
+    memmove(buffer + 2, buffer + 1, length - 1);
+    buffer[1] = '.';
+    return length + 1 + writeExponent(point - 1, buffer + length + 1);
+}
+
+static int formatInteger(uint64_t n, char* buffer) {
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = (char) ('0' + n % 10);
+        n /= 10;
+    } while (n > 0);
+    for (int i = 0; i < count; i++) {
+        buffer[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+// writes the shortest text that reads back as value, returns its length;
+// buffer must hold NUMBER_FORMAT_MAX bytes, the result is NUL terminated
+int formatNumber(double value, char* buffer) {
+    int length = 0;
+    if (value != value) {
+        memcpy(buffer, "nan", 4);
+        return 3;
+    }
+    if (value < 0) {
+        buffer[length++] = '-';
+        value = -value;
+    }
+    if (value == 1.0 / 0.0) {
+        memcpy(buffer + length, "inf", 4);
+        return length + 3;
+    }
+    if (value == 0) {
+        // -0 prints as 0
+        memcpy(buffer, "0", 2);
+        return 1;
+    }
+    // whole numbers below 2^53 are exact integers: skip the digit generation
+    if (value < 9007199254740992.0 && value == (double) (uint64_t) value) {
+        length += formatInteger((uint64_t) value, buffer + length);
+    } else {
+        int k;
+        int digits = grisu2(value, buffer + length, &k);
+        length += prettify(buffer + length, digits, k);
+    }
+    buffer[length] = '\0';
+    return length;
+}
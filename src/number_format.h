@@ -0,0 +1,9 @@
+#ifndef number_format_h
+#define number_format_h
+
+// enough for sign, 17 digits, point, exponent and terminator
+#define NUMBER_FORMAT_MAX 32
+
+int formatNumber(double value, char* buffer);
+
+#endif
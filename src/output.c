@@ -0,0 +1,12 @@
+#include <stdio.h>
+
+#include "output.h"
+
+ByteBuffer outputBuffer = {NULL, 0, 0};
+
+void flushOutput(void) {
+    if (outputBuffer.count > 0)
+        fwrite(outputBuffer.bytes, sizeof(char), outputBuffer.count, stdout);
+    outputBuffer.count = 0;
+    fflush(stdout);
+}
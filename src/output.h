@@ -0,0 +1,19 @@
+#ifndef output_h
+#define output_h
+
+#include "./datastructs/byte_buffer.h"
+
+// everything the program prints goes through this buffer:
+// it is flushed when full, at exit, before runtime errors and before running commands
+#define OUTPUT_FLUSH_SIZE (64 * 1024)
+
+extern ByteBuffer outputBuffer;
+
+void flushOutput(void);
+
+static inline void outputFlushIfFull(void) {
+    if (outputBuffer.count >= OUTPUT_FLUSH_SIZE)
+        flushOutput();
+}
+
+#endif
@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "util.h"
+
+uint64_t hash_seed = 0;
+
+// a per process seed makes the string hash unpredictable, so that key flooding attacks cannot be precomputed
+void initHashSeed(void) {
+    uint64_t seed = 0;
+    FILE* urandom = fopen("/dev/urandom", "rb");
+    if (urandom != NULL) {
+        if (fread(&seed, sizeof(seed), 1, urandom) != 1)
+            seed = 0;
+        fclose(urandom);
+    }
+    if (seed == 0) {
+        seed = (uint64_t) time(NULL) ^ ((uint64_t) getpid() << 32) ^ (uint64_t) (uintptr_t) &seed;
+    }
+    hash_seed = seed ^ hash_multiply_mix(seed ^ HASH_SECRET0, HASH_SECRET1);
+}
@@ -1,5 +1,5 @@
 #ifndef yaspl_util_h
-#define yaspl_uitl_h
+#define yaspl_util_h
 
 #include <string.h>
 #include <stdio.h>
@@ -26,25 +26,117 @@ static inline uint32_t hash_int(uint32_t a) {
     return a;
 }
 
-static inline uint32_t hash_string(char* key, int length) {
-    uint32_t hash = 2166136261u;
+extern uint64_t hash_seed;
+
+void initHashSeed(void);
+
+// full 64 x 64 -> 128 bit product: a gets the low half, b the high half
+static inline void hash_multiply(uint64_t* a, uint64_t* b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t) *a * *b;
+    *a = (uint64_t) r;
+    *b = (uint64_t) (r >> 64);
+#else
+    uint64_t ha = *a >> 32, la = (uint32_t) *a, hb = *b >> 32, lb = (uint32_t) *b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t carry = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    carry += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+}
 
-    for (int i = 0; i < length; i++) {                     
-        hash ^= key[i];                                      
-        hash *= 16777619;                                    
-    }                                                      
+static inline uint64_t hash_multiply_mix(uint64_t a, uint64_t b) {
+    hash_multiply(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t read_word64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(uint64_t));
+    return v;
+}
+
+static inline uint64_t read_word32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(uint32_t));
+    return v;
+}
 
-    return hash;                                           
-}     
-#define hash_pointer(p) hash_int((uintptr_t) (p))
-#define hash_double(v) hash_int(float_to_bits((float) v))
+#define HASH_SECRET0 0xa0761d6478bd642full
+#define HASH_SECRET1 0xe7037ed1a0b428dbull
+#define HASH_SECRET2 0x8ebc6af09c88c6e3ull
+#define HASH_SECRET3 0x589965cc75374cc3ull
 
-static inline uint32_t float_to_bits(float v) {
-    uint32_t i = 0;
-    memcpy(&i, &v, sizeof(float));
+// seeded word at a time hash (wyhash construction): 8 or 16 bytes per multiply instead of one
+static inline uint32_t hash_string(char* key, int length) {
+    const uint8_t* p = (const uint8_t*) key;
+    size_t len = (size_t) length;
+    uint64_t seed = hash_seed;
+    uint64_t a, b;
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (read_word32(p) << 32) | read_word32(p + ((len >> 3) << 2));
+            b = (read_word32(p + len - 4) << 32) | read_word32(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = (((uint64_t) p[0]) << 16) | (((uint64_t) p[len >> 1]) << 8) | p[len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            // three independent lanes keep the multipliers busy on long strings
+            uint64_t seed1 = seed, seed2 = seed;
+            do {
+                seed = hash_multiply_mix(read_word64(p) ^ HASH_SECRET1, read_word64(p + 8) ^ seed);
+                seed1 = hash_multiply_mix(read_word64(p + 16) ^ HASH_SECRET2, read_word64(p + 24) ^ seed1);
+                seed2 = hash_multiply_mix(read_word64(p + 32) ^ HASH_SECRET3, read_word64(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (i > 16) {
+            seed = hash_multiply_mix(read_word64(p) ^ HASH_SECRET1, read_word64(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = read_word64(p + i - 16);
+        b = read_word64(p + i - 8);
+    }
+    a ^= HASH_SECRET1;
+    b ^= seed;
+    hash_multiply(&a, &b);
+    return (uint32_t) hash_multiply_mix(a ^ HASH_SECRET0 ^ len, b ^ HASH_SECRET1);
+}
+
+static inline uint32_t hash_uint64(uint64_t a) {
+    a ^= a >> 33;
+    a *= 0xff51afd7ed558ccdull;
+    a ^= a >> 33;
+    a *= 0xc4ceb9fe1a85ec53ull;
+    a ^= a >> 33;
+    return (uint32_t) a;
+}
+
+static inline uint64_t double_to_bits(double v) {
+    uint64_t i = 0;
+    memcpy(&i, &v, sizeof(double));
     return i;
 }
 
+static inline uint32_t hash_double(double v) {
+    if (v == 0) // -0 == 0, so they must hash the same
+        v = 0;
+    return hash_uint64(double_to_bits(v));
+}
+
+#define hash_pointer(p) hash_uint64((uintptr_t) (p))
+
 static inline int is_integer(double n) {
     return (int) n == n;
 } 
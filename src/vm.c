@@ -6,10 +6,13 @@
 #include "vm.h"
 #include "memory.h"
 #include "util.h"
+#include "output.h"
 #include "./datastructs/value.h"
 #include "./compilation_pipeline/compiler.h"
 #include "./debug/debug_switches.h"
 #include "./datastructs/value_operations.h"
+#include "./datastructs/shape.h"
+#include "./datastructs/dict.h"
 #include "./natives/natives_export.h"
 
 #define RUNTIME_ERROR 0
@@ -48,6 +51,7 @@ static void runtimeError(struct sVM* vm, char* format, ...) {
     int instruction = vm->frames[vm->fp - 1].pc - vm->frames[vm->fp - 1].closure->function->bytecode->code - 1; 
     int line = lineArrayGet(&vm->frames[vm->fp - 1].closure->function->bytecode->lines, instruction);         
 
+    flushOutput();
     va_list args;                                    
     va_start(args, format);                          
     fprintf(stderr, "runtime error [line %d] in program: ", line);  
@@ -85,7 +89,148 @@ static void closeOnStackUpvalue(struct sVM* vm, Value* value) {
     }
 }
 
-static int callObject(struct sVM* vm, Obj* called, int argCount) {
+// the function and its arguments become the first slots of the generator, nothing runs yet
+static void callGenerator(struct sVM* vm, ObjClosure* closure, int argCount) {
+    Value* frame = vm->sp - argCount - 1;
+    int count = argCount + 1;
+    ObjGenerator* generator = newGenerator(vm->collector, closure);
+    vmPush(vm, to_vobj(generator));
+    generator->slots = grow_array(vm->collector, Value, generator->slots, 0, count);
+    generator->slotsCapacity = count;
+    memcpy(generator->slots, frame, sizeof(Value) * count);
+    generator->slotsCount = count;
+    vm->sp = frame;
+    vmPush(vm, to_vobj(generator));
+}
+
+// copies the frame back on top of the stack, reopening the upvalues over its locals
+static void resumeGenerator(struct sVM* vm, ObjGenerator* generator) {
+    Value* base = vm->sp;
+    memcpy(base, generator->slots, sizeof(Value) * generator->slotsCount);
+    vm->sp += generator->slotsCount;
+    for (int i = 0; i < generator->upvaluesCount; i++) {
+        ObjUpvalue* upvalue = generator->upvalues[i];
+        base[generator->upvalueSlots[i]] = *upvalue->closed;
+        upvalue->value = &base[generator->upvalueSlots[i]];
+        upvalue->next = vm->openUpvalues;
+        vm->openUpvalues = upvalue;
+    }
+    CallFrame* frame = &vm->frames[vm->fp++];
+    frame->closure = generator->closure;
+    frame->pc = generator->pc;
+    frame->localStack = base + 1;
+    frame->generator = generator;
+    generator->slotsCount = 0;
+    generator->upvaluesCount = 0;
+    generator->state = GENERATOR_RUNNING;
+}
+
+// moves the running frame, on top of the stack, into the generator. Its upvalues are closed
+// so that closures keep reading and writing them while it sleeps
+static void suspendGenerator(struct sVM* vm, ObjGenerator* generator) {
+    CallFrame* frame = &vm->frames[vm->fp - 1];
+    Value* base = frame->localStack - 1;
+    int count = (int) (vm->sp - base);
+    int upvalues = 0;
+    for (ObjUpvalue* upvalue = vm->openUpvalues; upvalue != NULL; upvalue = upvalue->next) {
+        if (upvalue->value >= base)
+            upvalues++;
+    }
+    // grown before anything moves: the collector may run
+    if (count > generator->slotsCapacity) {
+        generator->slots = grow_array(vm->collector, Value, generator->slots, generator->slotsCapacity, count);
+        generator->slotsCapacity = count;
+    }
+    if (upvalues > generator->upvaluesCapacity) {
+        generator->upvalues = grow_array(vm->collector, ObjUpvalue*, generator->upvalues, generator->upvaluesCapacity, upvalues);
+        generator->upvalueSlots = grow_array(vm->collector, int, generator->upvalueSlots, generator->upvaluesCapacity, upvalues);
+        generator->upvaluesCapacity = upvalues;
+    }
+    memcpy(generator->slots, base, sizeof(Value) * count);
+    generator->slotsCount = count;
+    ObjUpvalue** link = &vm->openUpvalues;
+    while (*link != NULL) {
+        ObjUpvalue* upvalue = *link;
+        if (upvalue->value < base) {
+            link = &upvalue->next;
+            continue;
+        }
+        *link = upvalue->next;
+        generator->upvalues[generator->upvaluesCount] = upvalue;
+        generator->upvalueSlots[generator->upvaluesCount++] = (int) (upvalue->value - base);
+        closeUpvalue(upvalue);
+    }
+    generator->pc = frame->pc;
+    generator->state = GENERATOR_SUSPENDED;
+    vm->sp = base;
+    vm->fp--;
+}
+
+#define ITER_DONE 0
+#define ITER_NEXT 1
+#define ITER_CHANGED 2
+
+static int iterable(Value value) {
+    return is_array(value) || is_string(value) || is_dict(value) || is_generator(value);
+}
+
+// number of elements of a container, compared at every step to notice the ones added while iterating
+static int iterableSize(Obj* container) {
+    switch (container->type) {
+        case OBJ_ARRAY:
+            return ((ObjArray*) container)->values->count;
+        case OBJ_STRING:
+            return ((ObjString*) container)->length;
+        case OBJ_DICT:
+            return dictCount((ObjDict*) container);
+        default:
+            return 0; // generators yield as long as they want
+    }
+}
+
+// state holds the container, the cursor, the size of the container and the key and value of the current
+// element. Elements are read in place, characters come from the shared one byte strings
+static int iterateNext(struct sVM* vm, Value* state) {
+    Obj* container = as_obj(state[0]);
+    int cursor = (int) as_cnumber(state[1]);
+    if (iterableSize(container) != (int) as_cnumber(state[2]))
+        return ITER_CHANGED;
+    switch (container->type) {
+        case OBJ_ARRAY:
+            {
+                ValueArray* values = ((ObjArray*) container)->values;
+                if (cursor >= values->count)
+                    return ITER_DONE;
+                state[3] = to_vnumber(cursor);
+                state[4] = values->values[cursor];
+                cursor++;
+                break;
+            }
+        case OBJ_STRING:
+            {
+                ObjString* string = (ObjString*) container;
+                if (cursor >= string->length)
+                    return ITER_DONE;
+                state[3] = to_vnumber(cursor);
+                state[4] = to_vobj(single_char_string(vm->collector, string_chars(string)[cursor]));
+                cursor++;
+                break;
+            }
+        default:
+            if (!dictNext((ObjDict*) container, &cursor, &state[3], &state[4]))
+                return ITER_DONE;
+            break;
+    }
+    state[1] = to_vnumber(cursor);
+    return ITER_NEXT;
+}
+
+static void returnCountError(struct sVM* vm, int expected, int count) {
+    runtimeError(vm, "expected %d returned value%s, got %d", expected, expected == 1 ? "" : "s", count);
+}
+
+// natives and generator functions return a single value
+static int callObject(struct sVM* vm, Obj* called, int argCount, int results) {
     switch (called->type) {
         case OBJ_CLOSURE:
             {
@@ -95,6 +240,14 @@ static int callObject(struct sVM* vm, Obj* called, int argCount) {
                     runtimeError(vm, "expected %d arguments, got %d", function->arity, argCount);
                     return 0;
                 }
+                if (function->isGenerator) {
+                    if (results != 1) {
+                        returnCountError(vm, results, 1);
+                        return 0;
+                    }
+                    callGenerator(vm, closure, argCount);
+                    return 1;
+                }
                 if (vm->fp + 1 >= MAX_FRAMES) {             
                     runtimeError(vm, "stack overflow");             
                     return 0;                                
@@ -103,16 +256,22 @@ static int callObject(struct sVM* vm, Obj* called, int argCount) {
                 currentFrame->closure = closure;
                 currentFrame->pc = currentFrame->closure->function->bytecode->code;
                 currentFrame->localStack = vm->sp - argCount;
+                currentFrame->generator = NULL;
+                currentFrame->results = results;
                 return 1;
             }
         case OBJ_NATIVE_FUNCTION:
             {
                 ObjNativeFunction* native = (ObjNativeFunction*) called;
-                if (argCount != native->arity) {
+                if (native->arity != NATIVE_VARIADIC && argCount != native->arity) {
                     runtimeError(vm, "expected %d arguments, got %d", native->arity, argCount);
                     return 0;
                 }
-                Value result = native->cfunction(vm, vm->sp - argCount);
+                if (results != 1) {
+                    returnCountError(vm, results, 1);
+                    return 0;
+                }
+                Value result = native->cfunction(vm, argCount, vm->sp - argCount);
                 vm->sp = vm->sp - argCount - 1; // -1 to pop off native
                 vmPush(vm, result);
                 return 1;
@@ -130,6 +289,7 @@ static int vmRun(struct sVM* vm) {
 #define read_constant_long() (currentFrame->closure->function->bytecode->constants.values[read_long()])
 #define read_long_if(oplong) (caseCode == (oplong) ? read_long() : read_byte())
 #define read_constant_long_if(oplong) (caseCode == (oplong) ? read_constant_long() : read_constant())
+#define read_cache() (&currentFrame->closure->function->bytecode->caches[read_long()])
 #define binary_op(operator, destination) \
     do { \
         if (!valuesNumbers(vmPeek(vm, 0), vmPeek(vm, 1))) { \
@@ -140,6 +300,12 @@ static int vmRun(struct sVM* vm) {
         double a = as_cnumber(vmPop(vm)); \
         vmPush(vm, destination(a operator b)); \
     } while (0)
+#define numeric_op(operator, destination) \
+    do { \
+        double b = as_cnumber(vmPop(vm)); \
+        double a = as_cnumber(vmPop(vm)); \
+        vmPush(vm, destination(a operator b)); \
+    } while (0)
 
 #ifdef TRACE_EXEC
     printf("VM EXECUTION TRACE:\n");
@@ -168,10 +334,16 @@ static int vmRun(struct sVM* vm) {
         switch ((caseCode = read_byte())) {
             case OP_RET: 
                 {
-                    Value retVal = vmPop(vm);
+                    uint8_t count = read_byte();
+                    if (currentFrame->generator == NULL && count != currentFrame->results) {
+                        returnCountError(vm, currentFrame->results, count);
+                        return RUNTIME_ERROR;
+                    }
+                    Value* values = vm->sp - count;
                     vm->fp--;
                     if (vm->fp == 0)
                         return RUNTIME_OK;
+                    vm->sp = values;
                     // close local variables still on the stack
                     while (vm->sp > currentFrame->localStack) { 
                         // todo this can be done more efficiently
@@ -179,13 +351,24 @@ static int vmRun(struct sVM* vm) {
                         vm->sp--;
                     }
                     vmPop(vm); // pop returning function
+                    if (currentFrame->generator != NULL) {
+                        // a finished generator ends the loop pulling from it
+                        currentFrame->generator->state = GENERATOR_DONE;
+                        currentFrame = &vm->frames[vm->fp - 1];
+                        break;
+                    }
                     currentFrame = &vm->frames[vm->fp - 1];
-                    vmPush(vm, retVal);
+                    // the values move down to where the function was
+                    for (int i = 0; i < count; i++) {
+                        vm->sp[i] = values[i];
+                    }
+                    vm->sp += count;
                     break;
                 }
             case OP_CALL:
                 {
                     uint8_t argCount = read_byte();
+                    uint8_t results = read_byte();
                     if (argCount > (vm->sp - vm->stack)) {
                         runtimeError(vm, "too many function arguments");
                         return RUNTIME_ERROR;
@@ -195,7 +378,7 @@ static int vmRun(struct sVM* vm) {
                         runtimeError(vm, "value is not callable");
                         return RUNTIME_ERROR;
                     }
-                    if (!callObject(vm, as_obj(called), argCount)) {
+                    if (!callObject(vm, as_obj(called), argCount, results)) {
                         return RUNTIME_ERROR;
                     }
                     currentFrame = &vm->frames[vm->fp - 1];
@@ -207,7 +390,7 @@ static int vmRun(struct sVM* vm) {
                     Value arrayLike = vmPeek(vm, 1);
                     Value result = indexGetValue(vm->collector, arrayLike, index);
                     if (is_error(result)) {
-                        runtimeError(vm, as_error(result)->message->chars);
+                        runtimeError(vm, string_chars(as_error(result)->message));
                         return RUNTIME_ERROR;
                     }
                     vmPop(vm);
@@ -222,9 +405,83 @@ static int vmRun(struct sVM* vm) {
                     Value arrayLike = vmPeek(vm, 2);
                     Value result = indexSetValue(vm->collector, arrayLike, index, assignValue);
                     if (is_error(result)) {
-                        runtimeError(vm, as_error(result)->message->chars);
+                        runtimeError(vm, string_chars(as_error(result)->message));
+                        return RUNTIME_ERROR;
+                    }
+                    vmPop(vm);
+                    vmPop(vm);
+                    vmPop(vm);
+                    vmPush(vm, result);
+                    break;
+                }
+            case OP_INDEXING_GET_STR:
+                {
+                    Value key = read_constant_long();
+                    InlineCache* cache = read_cache();
+                    Value arrayLike = vmPeek(vm, 0);
+                    if (is_dict(arrayLike)) {
+                        ObjDict* dict = as_dict(arrayLike);
+                        if (dict->kind == DICT_SHAPED && dict->shape == cache->shape) {
+                            vm->sp[-1] = dict->values->values[cache->slot];
+                            break;
+                        }
+                    }
+                    vmPush(vm, key);
+                    Value result = indexGetValue(vm->collector, arrayLike, key);
+                    if (is_error(result)) {
+                        runtimeError(vm, string_chars(as_error(result)->message));
+                        return RUNTIME_ERROR;
+                    }
+                    if (is_dict(arrayLike) && as_dict(arrayLike)->kind == DICT_SHAPED) {
+                        Shape* shape = as_dict(arrayLike)->shape;
+                        int slot = shapeSlot(shape, as_string(key));
+                        if (slot >= 0) {
+                            cache->shape = shape;
+                            cache->slot = slot;
+                            cache->transition = NULL;
+                        }
+                    }
+                    vmPop(vm);
+                    vmPop(vm);
+                    vmPush(vm, result);
+                    break;
+                }
+            case OP_INDEXING_SET_STR:
+                {
+                    Value key = read_constant_long();
+                    InlineCache* cache = read_cache();
+                    Value assignValue = vmPeek(vm, 0);
+                    Value arrayLike = vmPeek(vm, 1);
+                    if (is_dict(arrayLike)) {
+                        ObjDict* dict = as_dict(arrayLike);
+                        if (dict->kind == DICT_SHAPED && dict->shape == cache->shape) {
+                            if (cache->transition == NULL) {
+                                dict->values->values[cache->slot] = assignValue;
+                            } else {
+                                writeValueArray(vm->collector, dict->values, assignValue);
+                                dict->shape = cache->transition;
+                            }
+                            vmPop(vm);
+                            vm->sp[-1] = assignValue;
+                            break;
+                        }
+                    }
+                    Shape* oldShape = is_dict(arrayLike) && as_dict(arrayLike)->kind == DICT_SHAPED ?
+                        as_dict(arrayLike)->shape : NULL;
+                    vmPop(vm);
+                    vmPush(vm, key);
+                    vmPush(vm, assignValue);
+                    Value result = indexSetValue(vm->collector, arrayLike, key, assignValue);
+                    if (is_error(result)) {
+                        runtimeError(vm, string_chars(as_error(result)->message));
                         return RUNTIME_ERROR;
                     }
+                    if (oldShape != NULL && as_dict(arrayLike)->kind == DICT_SHAPED) {
+                        Shape* shape = as_dict(arrayLike)->shape;
+                        cache->shape = oldShape;
+                        cache->slot = shapeSlot(shape, as_string(key));
+                        cache->transition = shape == oldShape ? NULL : shape;
+                    }
                     vmPop(vm);
                     vmPop(vm);
                     vmPop(vm);
@@ -392,6 +649,35 @@ static int vmRun(struct sVM* vm) {
                     currentFrame->pc = oldpc + argument;
                     break;
                 }
+            case OP_JUMP_TABLE:
+                {
+                    uint8_t* oldpc = currentFrame->pc - 1;
+                    double min = as_cnumber(read_constant_long());
+                    uint16_t size = read_long();
+                    uint16_t argument = read_long();
+                    Value subject = vmPop(vm);
+                    if (is_number(subject)) {
+                        double index = as_cnumber(subject) - min;
+                        if (index >= 0 && index < size && index == (double) (int) index) {
+                            currentFrame->pc += 2 * (int) index;
+                            argument = read_long();
+                        }
+                    }
+                    currentFrame->pc = oldpc + argument;
+                    break;
+                }
+            case OP_JUMP_HASH:
+                {
+                    uint8_t* oldpc = currentFrame->pc - 1;
+                    ObjDict* table = as_dict(read_constant_long());
+                    uint16_t argument = read_long();
+                    Value subject = vmPop(vm);
+                    Value offset;
+                    if (dictGet(table, subject, &offset))
+                        argument = (uint16_t) as_cnumber(offset);
+                    currentFrame->pc = oldpc + argument;
+                    break;
+                }
             case OP_JUMP_BACK:
                 {
                     uint8_t* oldpc = currentFrame->pc - 1;
@@ -548,13 +834,160 @@ static int vmRun(struct sVM* vm) {
                     binary_op(>=, to_vbool);
                     break;
                 }
+            case OP_ADD_NUM:
+                {
+                    numeric_op(+, to_vnumber);
+                    break;
+                }
+            case OP_SUB_NUM:
+                {
+                    numeric_op(-, to_vnumber);
+                    break;
+                }
+            case OP_MUL_NUM:
+                {
+                    numeric_op(*, to_vnumber);
+                    break;
+                }
+            case OP_LESS_NUM:
+                {
+                    numeric_op(<, to_vbool);
+                    break;
+                }
+            case OP_LESS_EQUAL_NUM:
+                {
+                    numeric_op(<=, to_vbool);
+                    break;
+                }
+            case OP_GREATER_NUM:
+                {
+                    numeric_op(>, to_vbool);
+                    break;
+                }
+            case OP_GREATER_EQUAL_NUM:
+                {
+                    numeric_op(>=, to_vbool);
+                    break;
+                }
+            case OP_LOCAL_INCREMENT:
+                {
+                    Value* local = &currentFrame->localStack[read_byte()];
+                    double increment = as_cnumber(read_constant());
+                    *local = to_vnumber(as_cnumber(*local) + increment);
+                    vmPush(vm, *local);
+                    break;
+                }
+            case OP_FOR_PREP:
+                {
+                    uint8_t* oldpc = currentFrame->pc - 1;
+                    uint16_t exit = read_long();
+                    Value* state = &currentFrame->localStack[read_long()];
+                    if (!is_number(state[0]) || !is_number(state[1]) || !is_number(state[2])) {
+                        runtimeError(vm, "range bounds and step must be numbers");
+                        return RUNTIME_ERROR;
+                    }
+                    double step = as_cnumber(state[2]);
+                    if (step == 0) {
+                        runtimeError(vm, "range step cannot be 0");
+                        return RUNTIME_ERROR;
+                    }
+                    vmPush(vm, state[0]);
+                    double counter = as_cnumber(state[0]);
+                    double bound = as_cnumber(state[1]);
+                    if (!(step > 0 ? counter < bound : counter > bound))
+                        currentFrame->pc = oldpc + exit;
+                    break;
+                }
+            case OP_FOR_RANGE:
+                {
+                    uint8_t* oldpc = currentFrame->pc - 1;
+                    uint16_t back = read_long();
+                    Value* state = &currentFrame->localStack[read_long()];
+                    if (read_byte())
+                        closeOnStackUpvalue(vm, &state[3]);
+                    double step = as_cnumber(state[2]);
+                    double counter = as_cnumber(state[0]) + step;
+                    double bound = as_cnumber(state[1]);
+                    state[0] = to_vnumber(counter);
+                    if (step > 0 ? counter < bound : counter > bound) {
+                        state[3] = state[0];
+                        currentFrame->pc = oldpc - back;
+                    }
+                    break;
+                }
+            case OP_ITER_PREP:
+                {
+                    uint8_t* oldpc = currentFrame->pc - 1;
+                    uint16_t next = read_long();
+                    Value* state = &currentFrame->localStack[read_long()];
+                    if (!iterable(state[0])) {
+                        runtimeError(vm, "only arrays, strings, dicts and generators can be iterated");
+                        return RUNTIME_ERROR;
+                    }
+                    vmPush(vm, to_vnumber(0));
+                    vmPush(vm, to_vnumber(iterableSize(as_obj(state[0]))));
+                    vmPush(vm, to_vnihl());
+                    vmPush(vm, to_vnihl());
+                    currentFrame->pc = oldpc + next;
+                    break;
+                }
+            case OP_ITER_NEXT:
+                {
+                    uint8_t* oldpc = currentFrame->pc - 1;
+                    uint16_t back = read_long();
+                    Value* state = &currentFrame->localStack[read_long()];
+                    uint8_t captured = read_byte();
+                    if (captured & 1)
+                        closeOnStackUpvalue(vm, &state[4]);
+                    if (captured & 2)
+                        closeOnStackUpvalue(vm, &state[3]);
+                    if (is_generator(state[0])) {
+                        // the loop goes on at its body if the generator yields, after this instruction if it returns
+                        ObjGenerator* generator = as_generator(state[0]);
+                        if (generator->state == GENERATOR_DONE)
+                            break;
+                        if (generator->state == GENERATOR_RUNNING) {
+                            runtimeError(vm, "generator already running");
+                            return RUNTIME_ERROR;
+                        }
+                        if (vm->fp + 1 >= MAX_FRAMES) {
+                            runtimeError(vm, "stack overflow");
+                            return RUNTIME_ERROR;
+                        }
+                        generator->receiver = state;
+                        generator->loopBody = oldpc - back;
+                        resumeGenerator(vm, generator);
+                        currentFrame = &vm->frames[vm->fp - 1];
+                        break;
+                    }
+                    int result = iterateNext(vm, state);
+                    if (result == ITER_CHANGED) {
+                        runtimeError(vm, "container changed size during iteration");
+                        return RUNTIME_ERROR;
+                    }
+                    if (result == ITER_NEXT)
+                        currentFrame->pc = oldpc - back;
+                    break;
+                }
+            case OP_YIELD:
+                {
+                    ObjGenerator* generator = currentFrame->generator;
+                    Value* receiver = generator->receiver;
+                    receiver[3] = receiver[1];
+                    receiver[1] = to_vnumber(as_cnumber(receiver[1]) + 1);
+                    receiver[4] = vmPop(vm);
+                    suspendGenerator(vm, generator);
+                    currentFrame = &vm->frames[vm->fp - 1];
+                    currentFrame->pc = generator->loopBody;
+                    break;
+                }
             case OP_CONCAT:
                 {
                     Value b = vmPeek(vm, 0);
                     Value a = vmPeek(vm, 1);
                     Value result = concatenate(vm->collector, a, b);
                     if (is_error(result)) {
-                        runtimeError(vm, as_error(result)->message->chars);
+                        runtimeError(vm, string_chars(as_error(result)->message));
                         return RUNTIME_ERROR;
                     }
                     vmPop(vm);
@@ -566,7 +999,8 @@ static int vmRun(struct sVM* vm) {
                 {
                     Value val = vmPeek(vm, 0);
                     printValue(vm->collector, val);
-                    printf("\n");
+                    writeBytes(&outputBuffer, "\n", 1);
+                    outputFlushIfFull();
                     vmPop(vm);
                     break;
                 }
@@ -583,6 +1017,7 @@ static int vmRun(struct sVM* vm) {
 #undef read_constant_long
 #undef read_long_if
 #undef read_constant_long_if
+#undef read_cache
 }
 
 int vmExecute(struct sVM* vm, Collector* collector, ObjFunction* function) {
@@ -591,6 +1026,8 @@ int vmExecute(struct sVM* vm, Collector* collector, ObjFunction* function) {
     initialFrame->closure = newClosure(collector, function);
     initialFrame->pc = function->bytecode->code;
     initialFrame->localStack = vm->stack;
+    initialFrame->generator = NULL;
+    initialFrame->results = 1;
     mapPut(NULL, &vm->globals, to_vobj(initialFrame->closure), to_vnihl());
 
     vm->collector = collector;
@@ -606,7 +1043,7 @@ int vmExecute(struct sVM* vm, Collector* collector, ObjFunction* function) {
 void freeVM(struct sVM* vm) {
 #ifdef TRACE_INTERNED
     printf("INTERNED:\n");
-    printMap(&vm->collector->interned);
+    printStringSet(&vm->collector->interned);
     printf("\n");
 #endif
 #ifdef TRACE_GLOBALS
@@ -614,6 +1051,7 @@ void freeVM(struct sVM* vm) {
     printMap(&vm->globals);
     printf("\n");
 #endif
+    flushOutput();
     freeCollector(vm->collector);
     freeMap(NULL, &vm->globals);
 }
@@ -13,6 +13,8 @@ typedef struct {
     ObjClosure* closure;
     uint8_t* pc;
     Value* localStack;
+    ObjGenerator* generator; // NULL unless the frame runs a generator
+    int results; // values its caller takes back, left on the stack where the callee was
 } CallFrame;
 
 struct sVM {
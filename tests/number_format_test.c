@@ -0,0 +1,168 @@
+// checks formatNumber: fixed layouts, exact round trips through strtod and
+// how often the digits are longer than the shortest ones (a known Grisu2 trade-off)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../src/number_format.h"
+
+#define RANDOM_SAMPLES 1000000
+#define MAX_LONGER_RATIO 0.002
+
+typedef struct {
+    double value;
+    char* expected;
+} Case;
+
+static Case layouts[] = {
+    {0.0, "0"},
+    {-0.0, "0"},
+    {1.0, "1"},
+    {-1.5, "-1.5"},
+    {0.1 + 0.2, "0.30000000000000004"},
+    {3628800.0, "3628800"},
+    {9007199254740992.0, "9007199254740992"}, // 2^53, the last integer of the fast path
+    {9007199254740994.0, "9007199254740994"},
+    {999999999999999900000.0, "999999999999999900000"},
+    {1e21, "1e+21"}, // the first value in exponential notation
+    {0.000001, "0.000001"},
+    {1e-7, "1e-7"}, // the first small value in exponential notation
+    {1.234e-6, "0.000001234"},
+    {5e-324, "5e-324"}, // the smallest subnormal
+    {2.2250738585072014e-308, "2.2250738585072014e-308"}, // the smallest normal
+    {1.7976931348623157e308, "1.7976931348623157e+308"}, // the largest double
+    {1.0 / 0.0, "inf"},
+    {-1.0 / 0.0, "-inf"},
+};
+
+// Grisu2 outputs more digits than the shortest for these: pinned so that a change in either
+// direction is noticed. The last two have a shortest form exactly halfway to a neighbour, which
+// strtod rounds back to even but Grisu2 never takes
+static Case longer[] = {
+    {31722300588172752.0, "31722300588172752"}, // 31722300588172750 is enough
+    {-3.9939757219902927e-123, "-3.9939757219902927e-123"}, // -3.993975721990293e-123 is enough
+    {50704968058008896.0, "50704968058008896"}, // 50704968058008900 is enough
+    {135791658398168992.0, "135791658398168990"}, // 135791658398169000 is enough
+};
+
+static uint64_t state = 0x9e3779b97f4a7c15u;
+
+static uint64_t nextRandom(void) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// any finite double, every exponent equally likely
+static double randomDouble(void) {
+    for (;;) {
+        uint64_t bits = nextRandom();
+        double value;
+        memcpy(&value, &bits, sizeof(double));
+        if (value == value && value - value == 0)
+            return value;
+    }
+}
+
+// rounding to more digits never moves away from the value, so the precisions that read back
+// form a suffix of 1..17
+static int shortestDigits(double value) {
+    char buffer[40];
+    int low = 1;
+    int high = 17;
+    while (low < high) {
+        int precision = (low + high) / 2;
+        snprintf(buffer, sizeof(buffer), "%.*e", precision - 1, value);
+        if (strtod(buffer, NULL) == value)
+            high = precision;
+        else
+            low = precision + 1;
+    }
+    return low;
+}
+
+// significant digits of a formatted number
+static int countDigits(char* text) {
+    int first = -1;
+    int last = -1;
+    int count = 0;
+    for (char* c = text; *c != '\0' && *c != 'e'; c++) {
+        if (*c < '0' || *c > '9')
+            continue;
+        if (*c != '0') {
+            if (first < 0)
+                first = count;
+            last = count;
+        }
+        count++;
+    }
+    return first < 0 ? 1 : last - first + 1;
+}
+
+static int checkCases(Case* cases, int count, char* kind) {
+    int failures = 0;
+    char buffer[NUMBER_FORMAT_MAX];
+    for (int i = 0; i < count; i++) {
+        int length = formatNumber(cases[i].value, buffer);
+        if (strcmp(buffer, cases[i].expected) != 0 || length != (int) strlen(buffer)) {
+            printf("%s: %.17g formatted as %s, expected %s\n", kind, cases[i].value, buffer, cases[i].expected);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int main(void) {
+    int failures = checkCases(layouts, sizeof(layouts) / sizeof(Case), "layout");
+    failures += checkCases(longer, sizeof(longer) / sizeof(Case), "longer than shortest");
+    for (int i = 0; i < (int) (sizeof(longer) / sizeof(Case)); i++) {
+        if (countDigits(longer[i].expected) <= shortestDigits(longer[i].value)) {
+            printf("pinned case %s is not longer than the shortest\n", longer[i].expected);
+            failures++;
+        }
+    }
+
+    int longerCount = 0;
+    int muchLongerCount = 0;
+    char buffer[NUMBER_FORMAT_MAX];
+    for (int i = 0; i < RANDOM_SAMPLES; i++) {
+        double value = randomDouble();
+        formatNumber(value, buffer);
+        if (strtod(buffer, NULL) != value) {
+            printf("round trip: %.17g formatted as %s\n", value, buffer);
+            failures++;
+            continue;
+        }
+        int digits = countDigits(buffer);
+        int shortest = shortestDigits(value);
+        if (digits > shortest) {
+#ifdef PRINT_LONGER
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(double));
+            printf("longer by %d: 0x%016llx %s\n", digits - shortest, (unsigned long long) bits, buffer);
+#endif
+            longerCount++;
+            if (digits > shortest + 1)
+                muchLongerCount++;
+        } else if (digits < shortest) {
+            printf("too short: %.17g formatted as %s\n", value, buffer);
+            failures++;
+        }
+    }
+    double ratio = (double) longerCount / RANDOM_SAMPLES;
+    printf("%d random doubles read back exactly, %.3f%% longer than the shortest (%.4f%% by more than one digit)\n",
+            RANDOM_SAMPLES, ratio * 100, (double) muchLongerCount / RANDOM_SAMPLES * 100);
+    if (ratio > MAX_LONGER_RATIO) {
+        printf("more than %.1f%% of the outputs are longer than the shortest\n", MAX_LONGER_RATIO * 100);
+        failures++;
+    }
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("number format tests passed\n");
+    return 0;
+}